@@ -0,0 +1,142 @@
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <cstddef>
+#include <iostream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+#include "Expression.h"
+#include "Lexer.h"
+
+/// Exposes the private parsing phases of Expression to the benchmarks
+struct ParsingPhases {
+  static std::vector<Lexer::Token> tokenize(Expression &expression) {
+    return expression.tokenizeExpression_();
+  }
+  static size_t buildTree(Expression &expression,
+                          const std::vector<Lexer::Token> &tokens) {
+    return expression.lastCalculationStep_(tokens);
+  }
+};
+
+/// Stream buffer discarding everything written to it, so that printing is
+/// measured without the cost of a terminal
+class NullBuffer : public std::streambuf {
+protected:
+  int_type overflow(int_type c) override { return traits_type::not_eof(c); }
+  std::streamsize xsputn(const char *, std::streamsize count) override {
+    return count;
+  }
+};
+
+struct CorpusEntry {
+  std::string name;
+  std::string expression;
+};
+
+/// Expressions of each shape whose latency matters: short one-liners, long
+/// flat chains of operators, deep nesting and many function calls
+std::vector<CorpusEntry> corpus() {
+  std::vector<CorpusEntry> entries{
+      {"short", "1 + 2 x 3"},
+      {"short-functions", "sqrt(16) + 2^10 % 7"},
+  };
+
+  const char *operators[]{" + ", " x ", " - ", " / "};
+  std::string flat{"1.5"};
+  for (size_t i{0}; i < 500; ++i)
+    flat += operators[i % 4] + std::to_string(i % 9 + 1) + ".25";
+  entries.push_back({"long-flat", flat});
+
+  std::string nested{"1"};
+  for (size_t i{0}; i < 200; ++i)
+    nested = "(" + nested + operators[i % 2] + "1.01)";
+  entries.push_back({"deeply-nested", nested});
+
+  const char *functions[]{"sin", "cos", "ln", "sqrt", "tanh", "e^", "log"};
+  std::string calls{"0"};
+  for (size_t i{0}; i < 100; ++i)
+    calls += operators[i % 4] + std::string(functions[i % 7]) + "(" +
+             std::to_string(i % 5 + 1) + ".5)";
+  entries.push_back({"function-heavy", calls});
+
+  std::string composed{"0.5"};
+  for (size_t i{0}; i < 50; ++i)
+    composed = std::string(functions[i % 2]) + "(" + composed + ")";
+  entries.push_back({"function-nested", composed});
+  return entries;
+}
+
+TEST_CASE("Expression: Latency of each phase", "[benchmark]") {
+  for (const CorpusEntry &entry : corpus()) {
+    const std::string &text{entry.expression};
+
+    BENCHMARK_ADVANCED("validate/" + entry.name)
+    (Catch::Benchmark::Chronometer meter) {
+      std::vector<Expression> expressions(static_cast<size_t>(meter.runs()),
+                                          Expression(text));
+      meter.measure([&expressions](int run) {
+        expressions[static_cast<size_t>(run)].validate();
+      });
+    };
+
+    BENCHMARK_ADVANCED("tokenizeExpression_/" + entry.name)
+    (Catch::Benchmark::Chronometer meter) {
+      Expression expression(text);
+      expression.validate();
+      meter.measure([&expression] {
+        return ParsingPhases::tokenize(expression).size();
+      });
+    };
+
+    BENCHMARK_ADVANCED("lastCalculationStep_/" + entry.name)
+    (Catch::Benchmark::Chronometer meter) {
+      Expression expression(text);
+      expression.validate();
+      std::vector<Lexer::Token> tokens{ParsingPhases::tokenize(expression)};
+      meter.measure([&expression, &tokens] {
+        return ParsingPhases::buildTree(expression, tokens);
+      });
+    };
+
+    BENCHMARK_ADVANCED("result/" + entry.name)
+    (Catch::Benchmark::Chronometer meter) {
+      std::vector<Expression> expressions(static_cast<size_t>(meter.runs()),
+                                          Expression(text));
+      meter.measure([&expressions](int run) {
+        return expressions[static_cast<size_t>(run)].result();
+      });
+    };
+
+    BENCHMARK_ADVANCED("printCalculation/" + entry.name)
+    (Catch::Benchmark::Chronometer meter) {
+      Expression expression(text);
+      NullBuffer discard;
+      std::streambuf *console{std::cout.rdbuf(&discard)};
+      meter.measure([&expression] { expression.printCalculation(); });
+      std::cout.rdbuf(console);
+    };
+  }
+}
+
+TEST_CASE("Expression: Recalculating after one variable changes",
+          "[benchmark]") {
+  // A dashboard-style formula of several hundred Nodes over many inputs
+  std::string formula{"v0"};
+  for (size_t i{1}; i < 100; ++i) {
+    std::string name{"v" + std::to_string(i)};
+    formula = "(" + formula + ") + sin(" + name + ")*" + name + " / 3";
+  }
+  Expression expression(formula);
+  for (const std::string &name : expression.variables())
+    expression.set_variable(name, 1.0);
+  expression.result();
+  double value{1.0};
+
+  BENCHMARK("set_variable+result/dashboard") {
+    value += 0.5;
+    expression.set_variable("v50", value);
+    return expression.result();
+  };
+}
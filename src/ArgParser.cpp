@@ -1,8 +1,10 @@
 #include "ArgParser.h"
+#include "OutputBuffer.h"
 
 #include <iostream>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 
 /// Parse options in argv and concatenate remaining args into argStr_
 void ArgParser::parse(int argc, const char *const argv[]) {
@@ -25,29 +27,158 @@ void ArgParser::parse(int argc, const char *const argv[]) {
       verbose = true;
       continue;
     }
+    if (arg == "-b" || arg == "--batch") {
+      batch = true;
+      continue;
+    }
+    if (arg == "--stats") {
+      stats = true;
+      continue;
+    }
+    if (arg == "--fast-math") {
+      fastMath = true;
+      continue;
+    }
     if (arg == "-p" || arg == "--precision") {
+      if (i + 1 < argc && std::string_view(argv[i + 1]) == "shortest") {
+        precision_ = OutputBuffer::shortest;
+        ++i;
+        continue;
+      }
+      if (!readInteger_(argc, argv, i, precision_) || precision_ < 0) {
+        std::cerr << "Error: -p|--precision requires a trailing non-negative "
+                     "integer argument or 'shortest'"
+                  << std::endl;
+        shouldExit_ = true;
+        return;
+      }
+      continue;
+    }
+    if (arg == "-t" || arg == "--threads") {
+      if (!readInteger_(argc, argv, i, threads_) || threads_ < 1) {
+        std::cerr << "Error: -t|--threads requires a trailing positive "
+                     "integer argument"
+                  << std::endl;
+        shouldExit_ = true;
+        return;
+      }
+      continue;
+    }
+    if (arg == "-c" || arg == "--cache") {
+      if (!readInteger_(argc, argv, i, cacheSize_) || cacheSize_ < 0) {
+        std::cerr << "Error: -c|--cache requires a trailing non-negative "
+                     "integer argument"
+                  << std::endl;
+        shouldExit_ = true;
+        return;
+      }
+      continue;
+    }
+    if (arg == "--type") {
+      std::string_view type{i + 1 < argc ? argv[i + 1] : ""};
+      if (type == "float") {
+        scalarType_ = ScalarType::Float;
+      } else if (type == "double") {
+        scalarType_ = ScalarType::Double;
+      } else if (type == "long-double") {
+        scalarType_ = ScalarType::LongDouble;
+      } else {
+        std::cerr << "Error: --type requires a trailing 'float', 'double' or "
+                     "'long-double'"
+                  << std::endl;
+        shouldExit_ = true;
+        return;
+      }
+      ++i;
+      continue;
+    }
+    if (arg == "--range" || arg == "--reduce") {
       if (i + 1 >= argc) {
-        std::cerr
-            << "Error: -p|--precision requires a trailing integer argument"
-            << std::endl;
+        std::cerr << "Error: " << arg << " requires a trailing argument"
+                  << std::endl;
         shouldExit_ = true;
         return;
       }
       try {
-        precision_ = std::stoi(argv[i + 1]);
-      } catch (const std::invalid_argument &e) {
-        std::cerr
-            << "Error: -p|--precision requires a trailing integer argument"
-            << std::endl;
+        if (arg == "--range")
+          range_ = RangeReducer::parseRange(argv[++i]);
+        else
+          reduction_ = RangeReducer::parseReduction(argv[++i]);
+      } catch (const std::runtime_error &e) {
+        std::cerr << "Error: " << e.what() << std::endl;
         shouldExit_ = true;
         return;
       }
-      i++;
+      continue;
+    }
+    if (arg == "-f" || arg == "--file") {
+      if (i + 1 >= argc) {
+        std::cerr << "Error: -f|--file requires a trailing file path"
+                  << std::endl;
+        shouldExit_ = true;
+        return;
+      }
+      filePath_ = argv[++i];
+      continue;
+    }
+    if (arg == "--serve") {
+      if (i + 1 >= argc) {
+        std::cerr << "Error: --serve requires a trailing socket path"
+                  << std::endl;
+        shouldExit_ = true;
+        return;
+      }
+      servePath_ = argv[++i];
       continue;
     }
     argStr_ += arg;
   }
 
+  if (scalarType_ != ScalarType::Double &&
+      (verbose || fastMath || cacheSize_ > 0)) {
+    std::cerr << "Error: -v|--verbose, --fast-math and -c|--cache only "
+                 "calculate with --type double"
+              << std::endl;
+    shouldExit_ = true;
+    return;
+  }
+  if (reduction_ && !range_) {
+    std::cerr << "Error: --reduce requires a --range to reduce over"
+              << std::endl;
+    shouldExit_ = true;
+    return;
+  }
+  if (range_ && (verbose || fastMath || scalarType_ != ScalarType::Double)) {
+    std::cerr << "Error: --range can't be used with -v|--verbose, "
+                 "--fast-math or --type"
+              << std::endl;
+    shouldExit_ = true;
+    return;
+  }
+  int numSources{static_cast<int>(batch) + static_cast<int>(!filePath_.empty()) +
+                 static_cast<int>(!servePath_.empty())};
+  if (numSources > 0 && range_) {
+    std::cerr << "Error: --range reduces the expression arguments and can't "
+                 "be used with -b|--batch, -f|--file or --serve"
+              << std::endl;
+    shouldExit_ = true;
+    return;
+  }
+  if (numSources > 0) {
+    if (numSources > 1) {
+      std::cerr << "Error: -b|--batch, -f|--file and --serve can't be used "
+                   "together"
+                << std::endl;
+      shouldExit_ = true;
+    } else if (!argStr_.empty()) {
+      std::cerr << "Error: -b|--batch, -f|--file and --serve read expressions "
+                   "from stdin, a file or a socket and take no expression "
+                   "arguments"
+                << std::endl;
+      shouldExit_ = true;
+    }
+    return;
+  }
   if (argStr_.empty()) {
     std::cout << "No nonoptional arguments provided.\n";
     displayHelp();
@@ -55,3 +186,17 @@ void ArgParser::parse(int argc, const char *const argv[]) {
   }
   return;
 }
+
+bool ArgParser::readInteger_(int argc, const char *const argv[], int &i,
+                             int &value) {
+  if (i + 1 >= argc)
+    return false;
+  try {
+    value = std::stoi(argv[i + 1]);
+  } catch (const std::logic_error &e) {
+    // Thrown for both non-integers and integers out of range
+    return false;
+  }
+  i++;
+  return true;
+}
@@ -1,6 +1,10 @@
 #pragma once
 
+#include "CompiledExpression.h"
+#include "RangeReducer.h"
+
 #include <iostream>
+#include <optional>
 #include <string>
 
 /******************************************************************************
@@ -10,7 +14,8 @@ class ArgParser {
 public:
   // Constructors
   ArgParser(std::string_view helpStr)
-      : verbose(false), argStr_(), helpStr_(helpStr) {}
+      : verbose(false), batch(false), stats(false), fastMath(false), argStr_(),
+        helpStr_(helpStr) {}
 
   // Public methods
 
@@ -20,14 +25,40 @@ public:
   void displayHelp() { std::cout << helpStr_ << std::endl; }
   /// Concatenated string of non-option arguments
   const std::string &argString() const { return argStr_; }
-  /// Number of digits to display output numbers with
+  /// Number of digits to display output numbers with, or
+  /// OutputBuffer::shortest for the shortest round-trip form
   int precision() const { return precision_; };
+  /// File of expressions to evaluate instead of the arguments, if any
+  const std::string &filePath() const { return filePath_; }
+  /// Socket to serve expressions on instead of evaluating arguments, if any
+  const std::string &servePath() const { return servePath_; }
+  /// Number of threads to evaluate a file of expressions, or served
+  /// requests, with, or 0 if none was given
+  int threads() const { return threads_; }
+  /// Maximum number of results to cache, or 0 to disable caching
+  int cacheSize() const { return cacheSize_; }
+  /// Floating-point type to calculate in
+  ScalarType scalarType() const { return scalarType_; }
+  /// Range of a variable to reduce the expression over, if any
+  const std::optional<RangeReducer::Range> &range() const { return range_; }
+  /// How to reduce the expression's values over range(), summing them
+  /// unless another reduction was given
+  RangeReducer::Reduction reduction() const {
+    return reduction_.value_or(RangeReducer::Reduction::Sum);
+  }
   /// Whether a critical problem was found during parsing
   bool shouldExit() const { return shouldExit_; };
 
   // Public variables
   /// Whether a 'verbose' option flag was input
   bool verbose;
+  /// Whether a 'batch' option flag was input, to read expressions from stdin
+  bool batch;
+  /// Whether a 'stats' option flag was input, to print evaluation statistics
+  bool stats;
+  /// Whether a 'fast-math' option flag was input, to calculate functions only
+  /// as accurately as the precision needs
+  bool fastMath;
 
 private:
   // Constants
@@ -35,9 +66,21 @@ private:
   /// Precision to use when none is supplied via an option
   static constexpr int default_precision_{6};
 
+  // Private methods
+
+  /// Read the integer following option argv[i], moving i past it
+  bool readInteger_(int argc, const char *const argv[], int &i, int &value);
+
   // Private variables
   bool shouldExit_{false};
   std::string argStr_;
   int precision_{default_precision_};
+  std::string filePath_{};
+  std::string servePath_{};
+  int threads_{0};
+  int cacheSize_{0};
+  ScalarType scalarType_{ScalarType::Double};
+  std::optional<RangeReducer::Range> range_{};
+  std::optional<RangeReducer::Reduction> reduction_{};
   std::string helpStr_;
 };
@@ -0,0 +1,258 @@
+// Internal headers
+#include "Calculus.h"
+#include "Expression.h"
+#include "Lexer.h"
+
+// Standard library
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Namespaces
+using namespace std::string_literals;
+
+/// Nodes of the 15-point Kronrod rule on [-1, 1] from the largest down to
+/// the center, those at odd indices and the center being the 7-point Gauss
+/// rule's; both rules are symmetric, so each node stands for +-node
+static constexpr std::array<double, 8> kronrodNodes{
+    0.991455371120812639206854697526329, 0.949107912342758524526189684047851,
+    0.864864423359769072789712788640926, 0.741531185599394439863864773280788,
+    0.586087235467691130294144845693013, 0.405845151377397166906606412076961,
+    0.207784955007898467600689403773245, 0.0};
+/// Weights of the Kronrod rule at each of kronrodNodes
+static constexpr std::array<double, 8> kronrodWeights{
+    0.022935322010529224963732008058970, 0.063092092629978553290700663189204,
+    0.104790010322250183839876322541518, 0.140653259715525918745189590510238,
+    0.169004726639267902826583426598550, 0.190350578064785409913256402421014,
+    0.204432940075298892414161999234649, 0.209482141084727828012999174891714};
+/// Weights of the Gauss rule at kronrodNodes 1, 3, 5 and 7
+static constexpr std::array<double, 4> gaussWeights{
+    0.129484966168869693270611432679082, 0.279705391489276667901467771423780,
+    0.381830050505118944950369775488975, 0.417959183673469387755102040816327};
+
+/// Whether two nonzero values have the same sign
+static bool haveSameSign(double left, double right) {
+  return (left > 0.0) == (right > 0.0);
+}
+
+// ----------------------------------------------------------------------------
+// Public Methods
+// ----------------------------------------------------------------------------
+bool Calculus::isOperation(std::string_view name) {
+  return name == "integrate" || name == "root";
+}
+
+double Calculus::calculate(std::string_view call) {
+  size_t open{call.find('(')};
+  std::string name{call.substr(0, open)};
+  while (!name.empty() && std::isspace(static_cast<unsigned char>(name.back())))
+    name.pop_back();
+  // Arguments are separated by the commas outside of any nested brackets
+  std::vector<std::string> arguments(1);
+  size_t depth{0};
+  for (char c : call.substr(open + 1, call.size() - open - 2)) {
+    if (c == ',' && depth == 0) {
+      arguments.emplace_back();
+      continue;
+    }
+    depth += c == '(' ? 1 : 0;
+    depth -= c == ')' ? 1 : 0;
+    arguments.back() += c;
+  }
+  if (arguments.size() != 4)
+    throw std::runtime_error(
+        "Function "s + name +
+        " takes 4 arguments: an expression, its variable and two bounds.");
+  Lexer lexer(arguments[1]);
+  Lexer::Token variable{lexer.next()};
+  if (variable.type != Lexer::TokenType::Variable ||
+      lexer.next().type != Lexer::TokenType::End)
+    throw std::runtime_error("Argument " + arguments[1] + " of " + name +
+                             " is not a variable.");
+  double lower{Expression(arguments[2]).result()};
+  double upper{Expression(arguments[3]).result()};
+  if (!std::isfinite(lower) || !std::isfinite(upper))
+    throw std::runtime_error("Bounds of "s + name + " must be finite.");
+  CompiledExpression function(arguments[0]);
+  for (const std::string &other : function.variables()) {
+    if (other != variable.text)
+      throw std::runtime_error("Variable "s + other + " has no value.");
+  }
+  if (name == "integrate")
+    return integrate(function, lower, upper);
+  return root(function, lower, upper);
+}
+
+double Calculus::integrate(const CompiledExpression &integrand, double lower,
+                           double upper) {
+  if (upper < lower)
+    return -integrate(integrand, upper, lower);
+  if (upper == lower)
+    return 0.0;
+  // A max-heap of the intervals by error, so the worst is always split next
+  std::vector<Interval> intervals(1, {.lower = lower, .upper = upper});
+  applyRules_(integrand, intervals);
+  double integral{intervals[0].integral};
+  double error{intervals[0].error};
+  double magnitude{intervals[0].magnitude};
+  // Also ends once the values are infinite or NaN, as then is the error
+  while (error > relativeTolerance_ * magnitude) {
+    std::pop_heap(intervals.begin(), intervals.end());
+    Interval worst{intervals.back()};
+    double middle{worst.lower + (worst.upper - worst.lower) / 2};
+    if (intervals.size() == maxIntervals_ || middle <= worst.lower ||
+        middle >= worst.upper)
+      throw std::runtime_error("Integral did not converge; the integrand may "
+                               "be singular or oscillate too quickly.");
+    std::array<Interval, 2> halves{{{.lower = worst.lower, .upper = middle},
+                                    {.lower = middle, .upper = worst.upper}}};
+    applyRules_(integrand, halves);
+    integral += halves[0].integral + halves[1].integral - worst.integral;
+    error += halves[0].error + halves[1].error - worst.error;
+    magnitude += halves[0].magnitude + halves[1].magnitude - worst.magnitude;
+    intervals.back() = halves[0];
+    std::push_heap(intervals.begin(), intervals.end());
+    intervals.push_back(halves[1]);
+    std::push_heap(intervals.begin(), intervals.end());
+  }
+  // The running total has collected a rounding error for every split
+  integral = 0.0;
+  for (const Interval &interval : intervals)
+    integral += interval.integral;
+  return integral;
+}
+
+double Calculus::root(const CompiledExpression &function, double lower,
+                      double upper) {
+  // b is the best estimate of the root, c the other end of an interval
+  // bracketing it, and a the previous estimate
+  double a{lower};
+  double b{upper};
+  double fa{evaluate_(function, a)};
+  double fb{evaluate_(function, b)};
+  if (fa == 0.0)
+    return a;
+  if (fb == 0.0)
+    return b;
+  if (std::isnan(fa) || std::isnan(fb) || haveSameSign(fa, fb))
+    throw std::runtime_error(
+        "Function root needs values of opposite signs at its bounds.");
+  double c{a};
+  double fc{fa};
+  double step{b - a};
+  double previousStep{step};
+  for (size_t i{0}; i < maxIterations_; ++i) {
+    if (haveSameSign(fb, fc)) {
+      c = a;
+      fc = fa;
+      step = previousStep = b - a;
+    }
+    if (std::abs(fc) < std::abs(fb)) {
+      a = b;
+      b = c;
+      c = a;
+      fa = fb;
+      fb = fc;
+      fc = fa;
+    }
+    double tolerance{2 * std::numeric_limits<double>::epsilon() *
+                         std::abs(b) +
+                     std::numeric_limits<double>::min()};
+    double bisection{(c - b) / 2};
+    if (std::abs(bisection) <= tolerance || fb == 0.0)
+      return b;
+    // Interpolate, unless the last steps shrank the bracket too slowly
+    if (std::abs(previousStep) >= tolerance && std::abs(fa) > std::abs(fb)) {
+      double s{fb / fa};
+      double p{};
+      double q{};
+      if (a == c) {
+        // Secant step
+        p = 2 * bisection * s;
+        q = 1 - s;
+      } else {
+        // Inverse quadratic interpolation through a, b and c
+        double r{fb / fc};
+        q = fa / fc;
+        p = s * (2 * bisection * q * (q - r) - (b - a) * (r - 1));
+        q = (q - 1) * (r - 1) * (s - 1);
+      }
+      if (p > 0)
+        q = -q;
+      else
+        p = -p;
+      // Accept the step if it stays well inside the bracket and at least
+      // halves the step before last
+      if (2 * p < std::min(3 * bisection * q - std::abs(tolerance * q),
+                           std::abs(previousStep * q))) {
+        previousStep = step;
+        step = p / q;
+      } else {
+        step = previousStep = bisection;
+      }
+    } else {
+      step = previousStep = bisection;
+    }
+    a = b;
+    fa = fb;
+    b += std::abs(step) > tolerance ? step
+                                    : std::copysign(tolerance, bisection);
+    fb = evaluate_(function, b);
+    if (std::isnan(fb))
+      return fb;
+  }
+  throw std::runtime_error("Function root did not converge.");
+}
+
+// ----------------------------------------------------------------------------
+// Private Methods
+// ----------------------------------------------------------------------------
+void Calculus::applyRules_(const CompiledExpression &integrand,
+                           std::span<Interval> intervals) {
+  std::array<double, 2 * numRulePoints_> points;
+  std::array<double, 2 * numRulePoints_> values;
+  for (size_t i{0}; i < intervals.size(); ++i) {
+    double center{intervals[i].lower / 2 + intervals[i].upper / 2};
+    double halfWidth{intervals[i].upper / 2 - intervals[i].lower / 2};
+    double *intervalPoints{&points[i * numRulePoints_]};
+    // Each node but the center stands for a point on either side of it
+    for (size_t j{0}; j + 1 < kronrodNodes.size(); ++j) {
+      intervalPoints[2 * j] = center - halfWidth * kronrodNodes[j];
+      intervalPoints[2 * j + 1] = center + halfWidth * kronrodNodes[j];
+    }
+    intervalPoints[numRulePoints_ - 1] = center;
+  }
+  size_t size{intervals.size() * numRulePoints_};
+  std::array<std::span<const double>, 1> columns{
+      std::span(points).first(size)};
+  std::span<const std::span<const double>> bound{
+      columns.data(), integrand.variables().size()};
+  integrand.evaluateBatch(bound, std::span(values).first(size));
+  for (size_t i{0}; i < intervals.size(); ++i) {
+    const double *intervalValues{&values[i * numRulePoints_]};
+    double kronrod{0.0};
+    double gauss{0.0};
+    double magnitude{0.0};
+    for (size_t j{0}; j < kronrodNodes.size(); ++j) {
+      double left{intervalValues[2 * j]};
+      double right{j + 1 < kronrodNodes.size() ? intervalValues[2 * j + 1]
+                                               : 0.0};
+      kronrod += kronrodWeights[j] * (left + right);
+      magnitude += kronrodWeights[j] * (std::abs(left) + std::abs(right));
+      if (j % 2 == 1)
+        gauss += gaussWeights[j / 2] * (left + right);
+    }
+    double halfWidth{intervals[i].upper / 2 - intervals[i].lower / 2};
+    intervals[i].integral = kronrod * halfWidth;
+    intervals[i].error = std::abs(kronrod - gauss) * halfWidth;
+    intervals[i].magnitude = magnitude * halfWidth;
+  }
+}
+
+double Calculus::evaluate_(const CompiledExpression &function, double value) {
+  return function.evaluate({&value, function.variables().size()});
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+// Internal headers
+#include "CompiledExpression.h"
+
+// Standard library
+#include <array>
+#include <cstddef>
+#include <span>
+#include <string_view>
+
+/******************************************************************************
+ * Numerical operations taking an expression of a variable as an argument:
+ *   - integrate(<expression>, <variable>, <from>, <to>), the definite integral
+ *     of the expression over the variable from one bound to the other
+ *   - root(<expression>, <variable>, <lower>, <upper>), a value of the
+ *     variable between the bounds at which the expression is zero
+ *
+ * Expression's tokenizer replaces each call by its value, so calls may appear
+ * anywhere a number can, be nested in each other's arguments, and are
+ * calculated once per parse of the enclosing expression. The bounds are
+ * expressions without variables, and the inner expression has no variables
+ * besides its own.
+ *
+ * The inner expression is compiled once into a CompiledExpression and only
+ * evaluated afterwards. integrate() uses adaptive Gauss-Kronrod quadrature:
+ * the 15-point Kronrod rule of an interval gives the integral over it, and its
+ * difference from the embedded 7-point Gauss rule bounds the error, so the
+ * interval with the largest error is halved, both halves evaluated in a
+ * single batch, until the errors sum to a small fraction of the integral of
+ * the absolute value. An integral diverging at a point becomes infinite once
+ * the intervals there are small enough for its values to overflow, while one
+ * whose error stops shrinking throws. root() uses Brent's method, which keeps
+ * the root bracketed between two points while taking inverse quadratic
+ * interpolation or secant steps, and bisects whenever those would converge
+ * slowly, so it needs only the values of the expression and finds a root to
+ * within a few units in the last place.
+ *****************************************************************************/
+class Calculus {
+public:
+  // Public methods
+
+  /// Whether a name is that of an operation, written like a function call
+  static bool isOperation(std::string_view name);
+  /// Calculate a whole call of an operation, from its name to its ')'
+  static double calculate(std::string_view call);
+  /// Integral of an expression of at most one variable from lower to upper
+  static double integrate(const CompiledExpression &integrand, double lower,
+                          double upper);
+  /// Root of an expression of at most one variable between lower and upper,
+  /// at which its values must have opposite signs
+  static double root(const CompiledExpression &function, double lower,
+                     double upper);
+
+private:
+  // Structs
+
+  /// Integral over an interval, from the Kronrod rule
+  struct Interval {
+    double lower{0.0};
+    double upper{0.0};
+    double integral{0.0};
+    double error{0.0};     /// Difference from the Gauss rule
+    double magnitude{0.0}; /// Integral of the absolute value
+
+    /// Order of a max-heap by error
+    bool operator<(const Interval &other) const { return error < other.error; }
+  };
+
+  // Private constants
+
+  /// Number of points of the Kronrod rule
+  static constexpr size_t numRulePoints_{15};
+  /// Intervals integrate() may split the range into before giving up
+  static constexpr size_t maxIntervals_{65536};
+  /// Error allowed relative to the integral of the absolute value
+  static constexpr double relativeTolerance_{1e-12};
+  /// Iterations root() may take before giving up, enough to bisect from the
+  /// largest double to the smallest
+  static constexpr size_t maxIterations_{2100};
+
+  // Private methods
+
+  /// Apply the Kronrod and Gauss rules to one or two intervals, given their
+  /// bounds, evaluating the integrand at all of their points in one batch
+  static void applyRules_(const CompiledExpression &integrand,
+                          std::span<Interval> intervals);
+  /// Value of an expression of at most one variable
+  static double evaluate_(const CompiledExpression &function, double value);
+};
@@ -0,0 +1,124 @@
+// Internal headers
+#include "Client.h"
+#include "Server.h"
+
+// Standard library
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+// POSIX
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Namespaces
+using namespace std::string_literals;
+
+// ----------------------------------------------------------------------------
+// Constructors
+// ----------------------------------------------------------------------------
+Client::Client(const std::string &path) : fd_(-1), input_() {
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  if (path.empty() || path.size() >= sizeof(address.sun_path))
+    throw std::runtime_error("Invalid socket path "s + path);
+  std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+  fd_ = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd_ < 0)
+    throw std::runtime_error("Could not create socket: "s +
+                             std::strerror(errno));
+  if (::connect(fd_, reinterpret_cast<const sockaddr *>(&address),
+                sizeof(address)) != 0) {
+    int error{errno};
+    ::close(fd_);
+    throw std::runtime_error("Could not connect to "s + path + ": " +
+                             std::strerror(error));
+  }
+}
+
+Client::~Client() { ::close(fd_); }
+
+// ----------------------------------------------------------------------------
+// Public Methods
+// ----------------------------------------------------------------------------
+std::string Client::evaluate(std::string_view expression) {
+  std::string request;
+  Server::appendFrame(request, expression);
+  send_(request);
+  std::vector<std::string> responses;
+  receive_(1, responses);
+  return std::move(responses.front());
+}
+
+std::vector<std::string>
+Client::evaluate(const std::vector<std::string> &expressions) {
+  std::string requests;
+  for (const std::string &expression : expressions)
+    Server::appendFrame(requests, expression);
+  send_(requests);
+  std::vector<std::string> responses;
+  responses.reserve(expressions.size());
+  receive_(expressions.size(), responses);
+  return responses;
+}
+
+// ----------------------------------------------------------------------------
+// Private Methods
+// ----------------------------------------------------------------------------
+void Client::send_(std::string_view buffer) {
+  while (!buffer.empty()) {
+    ssize_t numWritten{::send(fd_, buffer.data(), buffer.size(),
+                              MSG_NOSIGNAL | MSG_DONTWAIT)};
+    if (numWritten >= 0) {
+      buffer.remove_prefix(static_cast<size_t>(numWritten));
+      continue;
+    }
+    if (errno == EINTR)
+      continue;
+    if (errno != EAGAIN && errno != EWOULDBLOCK)
+      throw std::runtime_error("Could not send to server: "s +
+                               std::strerror(errno));
+    // Wait until the server either reads more or sends responses, which
+    // must be read for it to carry on reading
+    pollfd events{.fd = fd_, .events = POLLIN | POLLOUT, .revents = 0};
+    if (::poll(&events, 1, -1) < 0 && errno != EINTR)
+      throw std::runtime_error("Could not wait for server: "s +
+                               std::strerror(errno));
+    if (events.revents & POLLIN)
+      read_();
+  }
+}
+
+void Client::receive_(size_t numResponses,
+                      std::vector<std::string> &responses) {
+  size_t numReceived{0};
+  while (true) {
+    std::string_view rest{input_};
+    std::string_view response;
+    while (numReceived < numResponses && Server::takeFrame(rest, response)) {
+      responses.emplace_back(response);
+      ++numReceived;
+    }
+    input_.erase(0, input_.size() - rest.size());
+    if (numReceived == numResponses)
+      return;
+    read_();
+  }
+}
+
+void Client::read_() {
+  std::array<char, 1 << 16> chunk;
+  ssize_t numRead{};
+  do {
+    numRead = ::read(fd_, chunk.data(), chunk.size());
+  } while (numRead < 0 && errno == EINTR);
+  if (numRead < 0)
+    throw std::runtime_error("Could not receive from server: "s +
+                             std::strerror(errno));
+  if (numRead == 0)
+    throw std::runtime_error("Server closed the connection");
+  input_.append(chunk.data(), static_cast<size_t>(numRead));
+}
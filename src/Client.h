@@ -0,0 +1,48 @@
+#pragma once
+
+// Standard library
+#include <string>
+#include <string_view>
+#include <vector>
+
+/******************************************************************************
+ * Connection to a Server, sending expressions and receiving their responses.
+ *
+ * Requests and responses are framed as Server describes. Sending several
+ * expressions at once writes every request without waiting for responses, so
+ * a batch costs one round trip rather than one per expression. Responses
+ * arriving while the socket is full are read meanwhile, as the Server stops
+ * reading from clients which let too many responses pile up.
+ *****************************************************************************/
+class Client {
+public:
+  // Constructors
+
+  /// Connect to the Server listening on the socket at path
+  explicit Client(const std::string &path);
+  Client(const Client &) = delete;
+  Client &operator=(const Client &) = delete;
+  ~Client();
+
+  // Public methods
+
+  /// The response to one expression: its result or "error: <reason>"
+  std::string evaluate(std::string_view expression);
+  /// The responses to several expressions, in the same order
+  std::vector<std::string> evaluate(const std::vector<std::string> &expressions);
+
+private:
+  // Private methods
+
+  /// Write all of buffer to the socket, reading responses into input_
+  /// whenever it is full
+  void send_(std::string_view buffer);
+  /// Read the bytes available on the socket into input_, waiting for some
+  void read_();
+  /// Read until numResponses responses have arrived, appending them
+  void receive_(size_t numResponses, std::vector<std::string> &responses);
+
+  // Private variables
+  int fd_;             /// Connected socket
+  std::string input_;  /// Bytes received but not yet forming a whole frame
+};
@@ -0,0 +1,415 @@
+// Internal headers
+#include "CompiledExpression.h"
+#include "Optimizer.h"
+
+// Standard library
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// The batch kernels are compiled once per x86-64 instruction set below, and
+// the loader picks the best one the CPU supports. The default clone uses SSE2,
+// which every x86-64 CPU has.
+#if defined(__x86_64__) && defined(__has_attribute)
+#if __has_attribute(target_clones)
+#define CALC_TARGET_CLONES                                                     \
+  __attribute__((target_clones("avx512f", "avx2", "default"), flatten))
+#endif
+#endif
+#ifndef CALC_TARGET_CLONES
+#define CALC_TARGET_CLONES
+#endif
+
+// ----------------------------------------------------------------------------
+// Constructors
+// ----------------------------------------------------------------------------
+template <typename Scalar>
+BasicCompiledExpression<Scalar>::BasicCompiledExpression(
+    Expression &expression)
+    : instructions_(), constants_(), variables_(), maxStackDepth_(0),
+      numTemporaries_(0) {
+  if constexpr (std::is_same_v<Scalar, double>) {
+    // Parsing builds the whole tree at once, but only when first needed
+    if (!expression.isParsed_) {
+      expression.parse_();
+    }
+    if (!expression.isOptimized_) {
+      Optimizer::optimize(expression);
+    }
+    compile_(expression);
+  } else {
+    // Constants the Optimizer folded as doubles would be off in this type,
+    // so the program is lowered from a tree of its own
+    *this = BasicCompiledExpression(expression.expression());
+  }
+}
+
+template <typename Scalar>
+BasicCompiledExpression<Scalar>::BasicCompiledExpression(
+    const std::string &expression)
+    : BasicCompiledExpression() {
+  Expression parsed(expression);
+  if constexpr (std::is_same_v<Scalar, double>) {
+    *this = BasicCompiledExpression(parsed);
+  } else {
+    parsed.parse_();
+    // Integers are exact in every type, while the other constants are folded
+    // in this one by emitOperation_()
+    Optimizer::optimize(parsed, true);
+    compile_(parsed);
+  }
+}
+
+// ----------------------------------------------------------------------------
+// Public Methods
+// ----------------------------------------------------------------------------
+template <typename Scalar>
+Scalar BasicCompiledExpression<Scalar>::evaluate(
+    std::span<const Scalar> bindings) const {
+  if (bindings.size() < variables_.size())
+    throw std::runtime_error("Compiled expression needs " +
+                             std::to_string(variables_.size()) +
+                             " variable values but was given " +
+                             std::to_string(bindings.size()) + ".");
+  if (maxStackDepth_ + numTemporaries_ <= inlineStackSize_) {
+    std::array<Scalar, inlineStackSize_> stack;
+    return run_(stack.data(), bindings.data());
+  }
+  return run_(scratch_(maxStackDepth_ + numTemporaries_), bindings.data());
+}
+
+template <typename Scalar>
+void BasicCompiledExpression<Scalar>::evaluateBatch(
+    std::span<const std::span<const Scalar>> columns,
+    std::span<Scalar> results) const {
+  if (columns.size() < variables_.size())
+    throw std::runtime_error("Compiled expression needs " +
+                             std::to_string(variables_.size()) +
+                             " variable columns but was given " +
+                             std::to_string(columns.size()) + ".");
+  for (size_t i{0}; i < variables_.size(); ++i) {
+    if (columns[i].size() < results.size())
+      throw std::runtime_error("Column for variable " + variables_[i] +
+                               " has fewer rows than the results.");
+  }
+  Scalar *stack{scratch_((maxStackDepth_ + numTemporaries_) * batchBlockSize_)};
+  for (size_t firstRow{0}; firstRow < results.size();
+       firstRow += batchBlockSize_) {
+    size_t numRows{std::min(batchBlockSize_, results.size() - firstRow)};
+    runBlock_(stack, columns, firstRow, numRows, results.data());
+  }
+}
+
+// ----------------------------------------------------------------------------
+// Private Methods
+// ----------------------------------------------------------------------------
+template <typename Scalar>
+Scalar *BasicCompiledExpression<Scalar>::scratch_(size_t size) {
+  // Kept per thread and only ever grown, so evaluating again allocates
+  // nothing, and CompiledExpressions can be shared between threads
+  thread_local std::vector<Scalar> scratch;
+  if (scratch.size() < size)
+    scratch.resize(size);
+  return scratch.data();
+}
+
+template <typename Scalar>
+void BasicCompiledExpression<Scalar>::compile_(const Expression &expression) {
+  variables_ = expression.variables_;
+  uses_.assign(expression.nodes_.size(), 0);
+  temporaries_.assign(expression.nodes_.size(), noTemporary_);
+  countUses_(expression, expression.outerStep_);
+  compile_(expression, expression.outerStep_);
+  uses_ = {};
+  temporaries_ = {};
+  if (stackDepth_ != 1)
+    throw std::runtime_error("Compiled program leaves " +
+                             std::to_string(stackDepth_) +
+                             " values on the stack instead of one.");
+}
+
+template <typename Scalar>
+void BasicCompiledExpression<Scalar>::compile_(const Expression &expression,
+                                               size_t node) {
+  // Mirrors Expression::calculate_(size_t): operators apply left-to-right
+  const Expression::Node &current{expression.nodes_[node]};
+  if (temporaries_[node] != noTemporary_) {
+    emitTemporary_(OpCode::LoadTemporary, temporaries_[node]);
+    return;
+  }
+  if (current.variable != Expression::noVariable) {
+    emitVariable_(current.variable);
+    return;
+  }
+  if (current.numOperands == 0) {
+    emitConstant_(constant_(current));
+    return;
+  }
+  const Expression::Operand *operands{
+      &expression.operands_[current.firstOperand]};
+  compile_(expression, operands[0].node);
+  if (current.function != Expression::Operator::None) {
+    emitOperation_(OpCode::UnaryOperation, current.function);
+  }
+  for (size_t i{1}; i < current.numOperands; ++i) {
+    compile_(expression, operands[i].node);
+    emitOperation_(OpCode::BinaryOperation, operands[i].oper);
+  }
+  if (uses_[node] > 1) {
+    temporaries_[node] = numTemporaries_++;
+    emitTemporary_(OpCode::StoreTemporary, temporaries_[node]);
+  }
+}
+
+template <typename Scalar>
+void BasicCompiledExpression<Scalar>::countUses_(const Expression &expression,
+                                                 size_t node) {
+  const Expression::Node &current{expression.nodes_[node]};
+  for (size_t i{0}; i < current.numOperands; ++i) {
+    size_t operand{expression.operands_[current.firstOperand + i].node};
+    // Operands of a shared Node are only used by it once
+    if (uses_[operand]++ == 0)
+      countUses_(expression, operand);
+  }
+}
+
+template <typename Scalar>
+Scalar BasicCompiledExpression<Scalar>::constant_(const Expression::Node &node) {
+  if constexpr (std::is_same_v<Scalar, double>) {
+    return node.result;
+  } else {
+    if (node.isInteger)
+      return static_cast<Scalar>(node.integer);
+    // The shortest text reading back as the double is the number as written,
+    // for numbers written with at most 15 significant digits
+    std::array<char, 32> text;
+    char *last{
+        std::to_chars(text.data(), text.data() + text.size(), node.result).ptr};
+    Scalar value{};
+    std::from_chars(text.data(), last, value);
+    return value;
+  }
+}
+
+template <typename Scalar>
+void BasicCompiledExpression<Scalar>::emitConstant_(Scalar value) {
+  instructions_.push_back(
+      {.code = OpCode::PushConstant,
+       .oper = Expression::Operator::None,
+       .index = static_cast<std::uint32_t>(constants_.size())});
+  constants_.push_back(value);
+  if (++stackDepth_ > maxStackDepth_)
+    maxStackDepth_ = stackDepth_;
+}
+
+template <typename Scalar>
+void BasicCompiledExpression<Scalar>::emitVariable_(size_t variable) {
+  instructions_.push_back({.code = OpCode::PushVariable,
+                           .oper = Expression::Operator::None,
+                           .index = static_cast<std::uint32_t>(variable)});
+  if (++stackDepth_ > maxStackDepth_)
+    maxStackDepth_ = stackDepth_;
+}
+
+template <typename Scalar>
+void BasicCompiledExpression<Scalar>::emitTemporary_(OpCode code,
+                                                     size_t temporary) {
+  instructions_.push_back({.code = code,
+                           .oper = Expression::Operator::None,
+                           .index = static_cast<std::uint32_t>(temporary)});
+  if (code == OpCode::LoadTemporary && ++stackDepth_ > maxStackDepth_)
+    maxStackDepth_ = stackDepth_;
+}
+
+template <typename Scalar>
+void BasicCompiledExpression<Scalar>::emitOperation_(
+    OpCode code, Expression::Operator oper) {
+  // Operations on constants are calculated now, for the constants left
+  // unfolded by the Optimizer in programs of other types than double
+  auto pushesConstant{[this](size_t fromEnd) {
+    return instructions_.size() >= fromEnd &&
+           instructions_[instructions_.size() - fromEnd].code ==
+               OpCode::PushConstant;
+  }};
+  if (code == OpCode::UnaryOperation && pushesConstant(1)) {
+    constants_.back() = calculate_(oper, constants_.back());
+    return;
+  }
+  if (code == OpCode::BinaryOperation && pushesConstant(1) &&
+      pushesConstant(2)) {
+    Scalar rightOperand{constants_.back()};
+    constants_.pop_back();
+    instructions_.pop_back();
+    constants_.back() = calculate_(oper, constants_.back(), rightOperand);
+    --stackDepth_;
+    return;
+  }
+  instructions_.push_back({.code = code, .oper = oper, .index = 0});
+  if (code == OpCode::BinaryOperation)
+    --stackDepth_;
+}
+
+template <typename Scalar>
+Scalar BasicCompiledExpression<Scalar>::calculate_(Expression::Operator oper,
+                                                   Scalar operand) {
+  return dispatchUnary(oper, [operand]<Expression::Operator unary>() {
+    return applyUnary<unary>(operand);
+  });
+}
+
+template <typename Scalar>
+Scalar BasicCompiledExpression<Scalar>::calculate_(Expression::Operator oper,
+                                                   Scalar leftOperand,
+                                                   Scalar rightOperand) {
+  return dispatchBinary(
+      oper, [leftOperand, rightOperand]<Expression::Operator binary>() {
+        return applyBinary<binary>(leftOperand, rightOperand);
+      });
+}
+
+template <typename Scalar>
+Scalar BasicCompiledExpression<Scalar>::run_(Scalar *stack,
+                                             const Scalar *bindings) const {
+  Scalar *temporaries{stack + maxStackDepth_};
+  // Index of the next free stack slot
+  size_t top{0};
+  for (const Instruction &instruction : instructions_) {
+    switch (instruction.code) {
+    case OpCode::PushConstant:
+      stack[top++] = constants_[instruction.index];
+      break;
+    case OpCode::PushVariable:
+      stack[top++] = bindings[instruction.index];
+      break;
+    case OpCode::StoreTemporary:
+      temporaries[instruction.index] = stack[top - 1];
+      break;
+    case OpCode::LoadTemporary:
+      stack[top++] = temporaries[instruction.index];
+      break;
+    case OpCode::UnaryOperation:
+      stack[top - 1] = calculate_(instruction.oper, stack[top - 1]);
+      break;
+    case OpCode::BinaryOperation:
+      --top;
+      stack[top - 1] =
+          calculate_(instruction.oper, stack[top - 1], stack[top]);
+      break;
+    }
+  }
+  return stack[0];
+}
+
+template <typename Scalar>
+void BasicCompiledExpression<Scalar>::runBlock_(
+    Scalar *stack, std::span<const std::span<const Scalar>> columns,
+    size_t firstRow, size_t numRows, Scalar *results) const {
+  // Index of the next free stack column. Kernels always process whole
+  // columns, whose fixed length lets the compiler vectorize them without a
+  // scalar remainder loop; rows past numRows are unused.
+  size_t top{0};
+  Scalar *temporaries{stack + maxStackDepth_ * batchBlockSize_};
+  for (const Instruction &instruction : instructions_) {
+    Scalar *next{stack + top * batchBlockSize_};
+    switch (instruction.code) {
+    case OpCode::PushConstant:
+      std::fill_n(next, numRows, constants_[instruction.index]);
+      ++top;
+      break;
+    case OpCode::PushVariable:
+      std::copy_n(columns[instruction.index].data() + firstRow, numRows, next);
+      ++top;
+      break;
+    case OpCode::StoreTemporary:
+      std::copy_n(next - batchBlockSize_, batchBlockSize_,
+                  temporaries + instruction.index * batchBlockSize_);
+      break;
+    case OpCode::LoadTemporary:
+      std::copy_n(temporaries + instruction.index * batchBlockSize_,
+                  batchBlockSize_, next);
+      ++top;
+      break;
+    case OpCode::UnaryOperation:
+      unaryKernel_(instruction.oper, next - batchBlockSize_);
+      break;
+    case OpCode::BinaryOperation:
+      --top;
+      binaryKernel_(instruction.oper, next - 2 * batchBlockSize_,
+                    next - batchBlockSize_);
+      break;
+    }
+  }
+  std::copy_n(stack, numRows, results + firstRow);
+}
+
+template <typename Scalar>
+inline void
+BasicCompiledExpression<Scalar>::unaryLoop_(Expression::Operator oper,
+                                            Scalar *__restrict values) {
+  dispatchUnary(oper, [values]<Expression::Operator unary>() {
+    for (size_t i{0}; i < batchBlockSize_; ++i)
+      values[i] = applyUnary<unary>(values[i]);
+  });
+}
+
+template <typename Scalar>
+inline void BasicCompiledExpression<Scalar>::binaryLoop_(
+    Expression::Operator oper, Scalar *__restrict leftValues,
+    const Scalar *__restrict rightValues) {
+  dispatchBinary(oper, [leftValues, rightValues]<Expression::Operator binary>() {
+    for (size_t i{0}; i < batchBlockSize_; ++i)
+      leftValues[i] = applyBinary<binary>(leftValues[i], rightValues[i]);
+  });
+}
+
+// GCC only clones functions which aren't templates, so each Scalar type's
+// kernels are specializations around the same loops
+template <>
+CALC_TARGET_CLONES void
+BasicCompiledExpression<float>::unaryKernel_(Expression::Operator oper,
+                                             float *__restrict values) {
+  unaryLoop_(oper, values);
+}
+
+template <>
+CALC_TARGET_CLONES void BasicCompiledExpression<float>::binaryKernel_(
+    Expression::Operator oper, float *__restrict leftValues,
+    const float *__restrict rightValues) {
+  binaryLoop_(oper, leftValues, rightValues);
+}
+
+template <>
+CALC_TARGET_CLONES void
+BasicCompiledExpression<double>::unaryKernel_(Expression::Operator oper,
+                                              double *__restrict values) {
+  unaryLoop_(oper, values);
+}
+
+template <>
+CALC_TARGET_CLONES void BasicCompiledExpression<double>::binaryKernel_(
+    Expression::Operator oper, double *__restrict leftValues,
+    const double *__restrict rightValues) {
+  binaryLoop_(oper, leftValues, rightValues);
+}
+
+template <>
+CALC_TARGET_CLONES void BasicCompiledExpression<long double>::unaryKernel_(
+    Expression::Operator oper, long double *__restrict values) {
+  unaryLoop_(oper, values);
+}
+
+template <>
+CALC_TARGET_CLONES void BasicCompiledExpression<long double>::binaryKernel_(
+    Expression::Operator oper, long double *__restrict leftValues,
+    const long double *__restrict rightValues) {
+  binaryLoop_(oper, leftValues, rightValues);
+}
+
+template class BasicCompiledExpression<float>;
+template class BasicCompiledExpression<double>;
+template class BasicCompiledExpression<long double>;
@@ -0,0 +1,167 @@
+#pragma once
+
+// Internal headers
+#include "Expression.h"
+
+// Standard library
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+/// Scalar types of the BasicCompiledExpression instantiations, for choosing
+/// one at runtime
+enum class ScalarType { Float, Double, LongDouble };
+
+/******************************************************************************
+ * Flat bytecode form of a parsed Expression, evaluated on a small stack VM.
+ *
+ * Compiling lowers the recursive Expression tree into a linear stream of
+ * instructions in postfix order: constants and variables are pushed onto a
+ * stack, unary functions replace the top of the stack and binary operators
+ * combine the top two entries. Evaluating the program then needs no recursion,
+ * no string handling and no per-node bookkeeping, which makes it suitable for
+ * re-evaluating the same formula many times. Variables are numbered in the
+ * order of variables(), and evaluate() takes their values as an array in that
+ * order, so a formula is compiled once and evaluated for any bindings.
+ *
+ * The Expression is simplified by the Optimizer before compiling, so constant
+ * subexpressions are calculated once at compile time. A subexpression shared
+ * by several parts of the formula is calculated once per evaluation and kept
+ * in a temporary slot, from which later uses load it.
+ *
+ * evaluateBatch() runs the program over many rows of bindings at once, given
+ * as one column per variable. Rows are processed in blocks, and each
+ * instruction is applied to a whole block in a loop specialized for its
+ * Operator, which the compiler vectorizes for the CPU it runs on.
+ *
+ * Programs calculate in their Scalar type, float, double or long double, and
+ * share Expression's parser. float halves the memory a batch streams through
+ * and doubles the rows each vector instruction processes, while long double
+ * keeps more digits where the CPU has an extended type. Since Expression and
+ * the Optimizer calculate constants as doubles, programs of other types fold
+ * only exact integers with the Optimizer, read decimal numbers from the
+ * shortest text of their double, and calculate the remaining constant
+ * subexpressions in their own type while compiling. CompiledExpression is the
+ * double instantiation.
+ *****************************************************************************/
+template <typename Scalar> class BasicCompiledExpression {
+public:
+  // Enums
+  enum class OpCode : std::uint8_t {
+    PushConstant,    /// Push constants_[index] onto the stack
+    PushVariable,    /// Push the value bound to variable index onto the stack
+    StoreTemporary,  /// Copy the top of the stack into temporary slot index
+    LoadTemporary,   /// Push temporary slot index onto the stack
+    UnaryOperation,  /// Apply a unary Operator to the top of the stack
+    BinaryOperation, /// Combine the top two stack entries with an Operator
+  };
+
+  // Structs
+
+  /// A single VM instruction
+  struct Instruction {
+    OpCode code{OpCode::PushConstant};
+    Expression::Operator oper{Expression::Operator::None};
+    std::uint32_t index{0}; /// Constant, variable or temporary index
+  };
+
+  // Constructors
+  BasicCompiledExpression()
+      : instructions_(), constants_(), variables_(), maxStackDepth_(0),
+        numTemporaries_(0) {}
+  explicit BasicCompiledExpression(Expression &expression);
+  explicit BasicCompiledExpression(const std::string &expression);
+
+  // Public methods
+
+  /// Evaluate the compiled program, with values for each of variables()
+  Scalar evaluate(std::span<const Scalar> bindings = {}) const;
+  /// Evaluate the compiled program for each row of a table of bindings, given
+  /// as one column per variable in variables() order, into results
+  void evaluateBatch(std::span<const std::span<const Scalar>> columns,
+                     std::span<Scalar> results) const;
+  /// Names of the variables bound by evaluate(), in binding order
+  const std::vector<std::string> &variables() const { return variables_; }
+  /// The instruction stream, in execution order
+  const std::vector<Instruction> &instructions() const { return instructions_; }
+  /// Constant pool indexed by PushConstant instructions
+  const std::vector<Scalar> &constants() const { return constants_; }
+  /// Number of stack slots needed to evaluate the program
+  size_t maxStackDepth() const { return maxStackDepth_; }
+  /// Number of shared subexpression results kept during evaluation
+  size_t numTemporaries() const { return numTemporaries_; }
+
+private:
+  // Private constants
+
+  /// Stack slots available without a heap allocation during evaluation
+  static constexpr size_t inlineStackSize_{64};
+  /// Entry of temporaries_ for Nodes not stored in a temporary slot
+  static constexpr size_t noTemporary_{static_cast<size_t>(-1)};
+  /// Rows evaluated together by evaluateBatch(), small enough that a whole
+  /// stack of blocks stays in L1 cache
+  static constexpr size_t batchBlockSize_{256};
+
+  // Private methods
+
+  /// Lower the parsed and optimized tree of an Expression into the program
+  void compile_(const Expression &expression);
+  /// Append the instructions computing a Node of an Expression's tree
+  void compile_(const Expression &expression, size_t node);
+  /// Value of a number Node in the Scalar type
+  static Scalar constant_(const Expression::Node &node);
+  /// Append an instruction pushing a constant onto the stack
+  void emitConstant_(Scalar value);
+  /// Append an instruction pushing a variable's value onto the stack
+  void emitVariable_(size_t variable);
+  /// Append an instruction storing to or loading from a temporary slot
+  void emitTemporary_(OpCode code, size_t temporary);
+  /// Count the uses of each Node reachable from a Node, once per parent
+  void countUses_(const Expression &expression, size_t node);
+  /// Append an instruction applying an Operator to the top of the stack, or
+  /// apply it to the constants pushed last
+  void emitOperation_(OpCode code, Expression::Operator oper);
+  /// Apply a unary Operator to a number
+  static Scalar calculate_(Expression::Operator oper, Scalar operand);
+  /// Apply a binary Operator to two numbers
+  static Scalar calculate_(Expression::Operator oper, Scalar leftOperand,
+                           Scalar rightOperand);
+  /// Storage for at least size values, reused by later calls on this thread
+  static Scalar *scratch_(size_t size);
+  /// Run the program using the given stack storage, followed by storage for
+  /// the temporaries, and variable values
+  Scalar run_(Scalar *stack, const Scalar *bindings) const;
+  /// Run the program over a block of rows, with one column per stack slot
+  /// followed by one column per temporary
+  void runBlock_(Scalar *stack,
+                 std::span<const std::span<const Scalar>> columns,
+                 size_t firstRow, size_t numRows, Scalar *results) const;
+  /// Apply a unary Operator to each value of a stack column
+  static void unaryKernel_(Expression::Operator oper, Scalar *values);
+  /// Combine two stack columns with a binary Operator into the left one
+  static void binaryKernel_(Expression::Operator oper, Scalar *leftValues,
+                            const Scalar *rightValues);
+  /// Loop of unaryKernel_(), which is compiled once per Scalar type and
+  /// instruction set from it
+  static void unaryLoop_(Expression::Operator oper, Scalar *values);
+  /// Loop of binaryKernel_(), which is compiled once per Scalar type and
+  /// instruction set from it
+  static void binaryLoop_(Expression::Operator oper, Scalar *leftValues,
+                          const Scalar *rightValues);
+
+  // Private variables
+  std::vector<Instruction> instructions_; /// Program in postfix order
+  std::vector<Scalar> constants_;         /// Constant pool
+  std::vector<std::string> variables_;    /// Names of bound variables
+  size_t maxStackDepth_;                  /// Deepest stack use of the program
+  size_t numTemporaries_;                 /// Temporary slots of the program
+  size_t stackDepth_{0}; /// Stack depth at the end of the program so far
+  /// While compiling, the number of Nodes using each Node as an operand
+  std::vector<size_t> uses_{};
+  /// While compiling, the temporary slot holding each Node's result, if any
+  std::vector<size_t> temporaries_{};
+};
+
+using CompiledExpression = BasicCompiledExpression<double>;
@@ -0,0 +1,490 @@
+#pragma once
+
+// Internal headers
+#include "Operator.h"
+
+// Standard library
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/******************************************************************************
+ * Parser calculating expressions without variables in constant expressions.
+ *
+ * Expression itself relies on std::string, hash maps and std::from_chars,
+ * none of which can be used at compile time, so this class repeats its
+ * grammar in constexpr form: the same tokens as Lexer, leading signs read as
+ * -1 x, implicit multiplication, and binary operators of equal priority
+ * applied left-to-right. Numbers are converted to the nearest double, like
+ * std::from_chars, and every Operator is calculated by applyUnary() and
+ * applyBinary(), with the same exact integer arithmetic on int64 literals.
+ * An expression which Expression would reject, or which has a variable,
+ * throws, which at compile time fails the build. So does one using the
+ * Calculus operations integrate() and root(), which are only calculated at
+ * runtime.
+ *
+ * calc::eval<"...">() is the entry point for compile-time use, while
+ * ConstantParser can also be used at runtime.
+ *****************************************************************************/
+class ConstantParser {
+public:
+  // Constructors
+  constexpr explicit ConstantParser(std::string_view expression)
+      : expression_(expression), tokens_(), index_(0) {}
+
+  // Public methods
+
+  /// Calculate the value of the whole expression
+  constexpr double calculate() {
+    tokenize_();
+    index_ = 0;
+    Number result{operation_(1)};
+    if (index_ != tokens_.size())
+      fail_("unexpected token after end of expression");
+    return result.value;
+  }
+
+private:
+  // Enums
+  enum class TokenType {
+    Number,
+    Function,
+    BinaryOperator,
+    LeftBracket,
+    RightBracket,
+  };
+
+  // Structs
+  struct Token {
+    TokenType type{TokenType::Number};
+    Operator oper{Operator::None};
+    Number value{};
+  };
+
+  // Private methods
+
+  /// Split the expression into tokens as Lexer and Expression do
+  constexpr void tokenize_() {
+    tokens_.clear();
+    size_t position{0};
+    size_t depth{0};
+    bool expectOperand{true};
+    bool atGroupStart{true};
+    bool afterFunction{false};
+    // The start of the expression behaves like an opening bracket
+    TokenType previous{TokenType::LeftBracket};
+    auto add{[this, &previous](Token token) {
+      bool startsOperand{token.type == TokenType::Number ||
+                         token.type == TokenType::Function ||
+                         token.type == TokenType::LeftBracket};
+      if (startsOperand && (previous == TokenType::Number ||
+                            previous == TokenType::RightBracket))
+        tokens_.push_back({TokenType::BinaryOperator, Operator::Times});
+      tokens_.push_back(token);
+      previous = token.type;
+    }};
+    while (true) {
+      while (position < expression_.size() && isSpace_(expression_[position]))
+        ++position;
+      if (position == expression_.size())
+        break;
+      char c{expression_[position]};
+      if (afterFunction && c != '(')
+        fail_("function without argument");
+      Operator oper{binaryOperator_(c)};
+      if (!expectOperand) {
+        if (c == ')') {
+          if (depth == 0)
+            fail_("unmatched parentheses");
+          --depth;
+          ++position;
+          add({TokenType::RightBracket});
+        } else if (oper != Operator::None) {
+          expectOperand = true;
+          ++position;
+          add({TokenType::BinaryOperator, oper});
+        } else if (isDigit_(c) && previous == TokenType::Number) {
+          fail_("two numbers without an operator");
+        } else if (isDigit_(c) || isNameStart_(c) || c == '(') {
+          // Adjacent operands are implicitly multiplied
+          expectOperand = true;
+        } else {
+          fail_("invalid character");
+        }
+        continue;
+      }
+      if (isDigit_(c)) {
+        expectOperand = false;
+        atGroupStart = false;
+        add({TokenType::Number, Operator::None, number_(position)});
+      } else if (c == '(') {
+        ++depth;
+        ++position;
+        atGroupStart = true;
+        afterFunction = false;
+        add({TokenType::LeftBracket});
+      } else if (isNameStart_(c)) {
+        atGroupStart = false;
+        afterFunction = true;
+        add({TokenType::Function, function_(position)});
+      } else if (atGroupStart &&
+                 (oper == Operator::Plus || oper == Operator::Minus)) {
+        // Leading sign: -<expr> is -1 x <expr>, and a leading + is dropped
+        atGroupStart = false;
+        ++position;
+        if (oper == Operator::Minus) {
+          tokens_.push_back(
+              {TokenType::Number, Operator::None, Number::exact(-1)});
+          tokens_.push_back({TokenType::BinaryOperator, Operator::Times});
+        }
+        previous = TokenType::BinaryOperator;
+      } else {
+        fail_(oper != Operator::None ? "binary operator without left operand"
+                                     : "missing operand or invalid character");
+      }
+    }
+    if (afterFunction)
+      fail_("function without argument");
+    if (depth != 0)
+      fail_("unmatched parentheses");
+    if (expectOperand)
+      fail_("no operands, or ends with a binary operator or sign");
+  }
+
+  /// Parse and calculate operands joined by binary operators of at least the
+  /// given priority, applying equal priorities left-to-right
+  constexpr Number operation_(int priority) {
+    if (priority > priority_(Operator::Pow))
+      return operand_();
+    Number result{operation_(priority + 1)};
+    while (index_ < tokens_.size() &&
+           tokens_[index_].type == TokenType::BinaryOperator &&
+           priority_(tokens_[index_].oper) == priority) {
+      Operator oper{tokens_[index_++].oper};
+      Number operand{operation_(priority + 1)};
+      result = dispatchBinary(oper, [result, operand]<Operator op>() {
+        return applyNumberBinary<op>(result, operand);
+      });
+    }
+    return result;
+  }
+
+  /// Parse and calculate a number, bracketed subexpression or function call
+  constexpr Number operand_() {
+    if (index_ >= tokens_.size())
+      fail_("expected an operand at end of expression");
+    Token token{tokens_[index_++]};
+    switch (token.type) {
+    case TokenType::Number:
+      return token.value;
+    case TokenType::LeftBracket: {
+      Number result{operation_(1)};
+      expect_(TokenType::RightBracket);
+      return result;
+    }
+    case TokenType::Function: {
+      expect_(TokenType::LeftBracket);
+      Number argument{operation_(1)};
+      expect_(TokenType::RightBracket);
+      return {dispatchUnary(token.oper, [argument]<Operator op>() {
+        return applyUnary<op>(argument.value);
+      })};
+    }
+    default:
+      fail_("unexpected token");
+    }
+  }
+
+  /// Move past a token of the given type, which must come next
+  constexpr void expect_(TokenType type) {
+    if (index_ >= tokens_.size() || tokens_[index_].type != type)
+      fail_("unexpected token");
+    ++index_;
+  }
+
+  /// Read a function name starting at position, moving past it
+  constexpr Operator function_(size_t &position) const {
+    size_t end{position};
+    while (end < expression_.size() && (isNameStart_(expression_[end]) ||
+                                        isDigit_(expression_[end])))
+      ++end;
+    // The function e^() is spelled with Euler's number and a '^'
+    if (end == position + 1 && expression_[position] == 'e' &&
+        end < expression_.size() && expression_[end] == '^')
+      ++end;
+    std::string_view name{expression_.substr(position, end - position)};
+    size_t bracket{end};
+    while (bracket < expression_.size() && isSpace_(expression_[bracket]))
+      ++bracket;
+    if (bracket == expression_.size() || expression_[bracket] != '(')
+      fail_("variables can't be calculated without values");
+    // Calculus evaluates a CompiledExpression many times over
+    if (name == "integrate" || name == "root")
+      fail_("integrate() and root() are only calculated at runtime");
+    constexpr std::array<std::pair<std::string_view, Operator>, 11>
+        functions{{{"e^", Operator::Exp},
+                   {"exp", Operator::Exp},
+                   {"sqrt", Operator::Sqrt},
+                   {"ln", Operator::Ln},
+                   {"log", Operator::Log},
+                   {"sin", Operator::Sin},
+                   {"cos", Operator::Cos},
+                   {"tan", Operator::Tan},
+                   {"sinh", Operator::Sinh},
+                   {"cosh", Operator::Cosh},
+                   {"tanh", Operator::Tanh}}};
+    for (const auto &[functionName, oper] : functions) {
+      if (name == functionName) {
+        position = end;
+        return oper;
+      }
+    }
+    fail_("unknown function");
+  }
+
+  /// Read a number starting at position, moving past it, and convert it to
+  /// the nearest double, keeping its exact value if it is an int64 literal
+  constexpr Number number_(size_t &position) const {
+    // The decimal digits form an integer, divided by 10^numFractionDigits
+    std::vector<std::uint32_t> numerator{0};
+    std::vector<std::uint32_t> denominator{1};
+    bool isFraction{false};
+    for (; position < expression_.size(); ++position) {
+      char c{expression_[position]};
+      if (c == '.' && !isFraction) {
+        isFraction = true;
+        continue;
+      }
+      if (!isDigit_(c))
+        break;
+      multiplyAdd_(numerator, 10, static_cast<std::uint32_t>(c - '0'));
+      if (isFraction)
+        multiplyAdd_(denominator, 10, 0);
+    }
+    Number number{};
+    if (!isFraction && numerator.size() <= 2) {
+      std::uint64_t integer{numerator[0]};
+      if (numerator.size() == 2)
+        integer |= std::uint64_t{numerator[1]} << 32;
+      if (integer <= std::uint64_t{std::numeric_limits<std::int64_t>::max()})
+        number = Number::exact(static_cast<std::int64_t>(integer));
+    }
+    if (!number.isInteger)
+      number.value =
+          nearestDouble_(std::move(numerator), std::move(denominator));
+    return number;
+  }
+
+  /// The double nearest to a ratio of big integers, rounding ties to even
+  static constexpr double
+  nearestDouble_(std::vector<std::uint32_t> numerator,
+                 std::vector<std::uint32_t> denominator) {
+    if (bitLength_(numerator) == 0)
+      return 0.0;
+    // Scale by 2^shift so that 2^53 <= numerator / denominator < 2^54
+    int shift{54 - (static_cast<int>(bitLength_(numerator)) -
+                    static_cast<int>(bitLength_(denominator)))};
+    if (shift > 0)
+      shiftLeft_(numerator, static_cast<size_t>(shift));
+    else
+      shiftLeft_(denominator, static_cast<size_t>(-shift));
+    std::vector<std::uint32_t> limit{denominator};
+    shiftLeft_(limit, 53);
+    while (compare_(numerator, limit) < 0) {
+      shiftLeft_(numerator, 1);
+      ++shift;
+    }
+    shiftLeft_(limit, 1);
+    while (compare_(numerator, limit) >= 0) {
+      shiftLeft_(denominator, 1);
+      shiftLeft_(limit, 1);
+      --shift;
+    }
+    // Long division into the 54-bit quotient, leaving the remainder
+    std::uint64_t quotient{0};
+    for (int bit{53}; bit >= 0; --bit) {
+      std::vector<std::uint32_t> part{denominator};
+      shiftLeft_(part, static_cast<size_t>(bit));
+      if (compare_(numerator, part) >= 0) {
+        subtract_(numerator, part);
+        quotient |= std::uint64_t{1} << bit;
+      }
+    }
+    bool isInexact{bitLength_(numerator) != 0};
+    // The value is quotient * 2^-shift, with 2^53 <= quotient < 2^54.
+    // Below the smallest normal exponent fewer mantissa bits remain.
+    int exponent{53 - shift};
+    int droppedBits{1 + std::max(0, -1022 - exponent)};
+    if (droppedBits > 54)
+      fail_("number out of range");
+    std::uint64_t mantissa{quotient >> droppedBits};
+    std::uint64_t rest{quotient & ((std::uint64_t{1} << droppedBits) - 1)};
+    std::uint64_t half{std::uint64_t{1} << (droppedBits - 1)};
+    if (rest > half || (rest == half && (isInexact || (mantissa & 1))))
+      ++mantissa;
+    if (mantissa == 0)
+      fail_("number out of range");
+    if (droppedBits > 1) {
+      // Subnormal, whose bits are just the mantissa; rounding up to 2^52
+      // gives the smallest normal number
+      return std::bit_cast<double>(mantissa);
+    }
+    // Rounding up to 2^53 carries into the exponent
+    std::uint64_t bits{(static_cast<std::uint64_t>(exponent + 1023) << 52) +
+                       (mantissa - (std::uint64_t{1} << 52))};
+    if ((bits >> 52) >= 0x7FF)
+      fail_("number out of range");
+    return std::bit_cast<double>(bits);
+  }
+
+  /// number = number * factor + addend
+  static constexpr void multiplyAdd_(std::vector<std::uint32_t> &number,
+                                     std::uint32_t factor,
+                                     std::uint32_t addend) {
+    std::uint64_t carry{addend};
+    for (std::uint32_t &limb : number) {
+      carry += std::uint64_t{limb} * factor;
+      limb = static_cast<std::uint32_t>(carry);
+      carry >>= 32;
+    }
+    if (carry != 0)
+      number.push_back(static_cast<std::uint32_t>(carry));
+  }
+
+  /// number = number * 2^bits
+  static constexpr void shiftLeft_(std::vector<std::uint32_t> &number,
+                                   size_t bits) {
+    number.insert(number.begin(), bits / 32, 0);
+    bits %= 32;
+    if (bits == 0)
+      return;
+    std::uint32_t carry{0};
+    for (std::uint32_t &limb : number) {
+      std::uint32_t next{limb >> (32 - bits)};
+      limb = (limb << bits) | carry;
+      carry = next;
+    }
+    if (carry != 0)
+      number.push_back(carry);
+  }
+
+  /// left = left - right, where left >= right
+  static constexpr void subtract_(std::vector<std::uint32_t> &left,
+                                  const std::vector<std::uint32_t> &right) {
+    std::int64_t borrow{0};
+    for (size_t i{0}; i < left.size(); ++i) {
+      std::int64_t difference{std::int64_t{left[i]} - borrow -
+                              (i < right.size() ? std::int64_t{right[i]} : 0)};
+      borrow = difference < 0;
+      left[i] = static_cast<std::uint32_t>(difference + (borrow << 32));
+    }
+  }
+
+  /// Negative, zero or positive as left is less than, equal to or greater
+  /// than right
+  static constexpr int compare_(const std::vector<std::uint32_t> &left,
+                                const std::vector<std::uint32_t> &right) {
+    size_t leftBits{bitLength_(left)};
+    size_t rightBits{bitLength_(right)};
+    if (leftBits != rightBits)
+      return leftBits < rightBits ? -1 : 1;
+    for (size_t i{(leftBits + 31) / 32}; i-- > 0;) {
+      if (left[i] != right[i])
+        return left[i] < right[i] ? -1 : 1;
+    }
+    return 0;
+  }
+
+  /// Number of bits up to the highest set bit
+  static constexpr size_t
+  bitLength_(const std::vector<std::uint32_t> &number) {
+    for (size_t i{number.size()}; i-- > 0;) {
+      if (number[i] != 0)
+        return 32 * i + static_cast<size_t>(std::bit_width(number[i]));
+    }
+    return 0;
+  }
+
+  /// Priority of a binary Operator in BEDMAS, as in Expression
+  static constexpr int priority_(Operator oper) {
+    switch (oper) {
+    case Operator::Plus:
+    case Operator::Minus:
+      return 1;
+    case Operator::Times:
+    case Operator::Divide:
+    case Operator::Mod:
+      return 2;
+    case Operator::Pow:
+      return 3;
+    default:
+      return 0;
+    }
+  }
+
+  /// The Operator represented by a binary operator character, if any
+  static constexpr Operator binaryOperator_(char c) {
+    switch (c) {
+    case '+':
+      return Operator::Plus;
+    case '-':
+      return Operator::Minus;
+    case '*':
+    case 'x':
+      return Operator::Times;
+    case '/':
+      return Operator::Divide;
+    case '^':
+      return Operator::Pow;
+    case '%':
+      return Operator::Mod;
+    }
+    return Operator::None;
+  }
+
+  static constexpr bool isDigit_(char c) { return c >= '0' && c <= '9'; }
+  static constexpr bool isNameStart_(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+  }
+  static constexpr bool isSpace_(char c) {
+    return c == ' ' || (c >= '\t' && c <= '\r');
+  }
+  /// Reject the expression. Not being constexpr, calling it at compile time
+  /// fails the build, with the reason in the compiler's message.
+  [[noreturn]] static void fail_(const char *reason) {
+    throw std::runtime_error(std::string("Invalid expression: ") + reason);
+  }
+
+  // Private variables
+  std::string_view expression_; /// Expression being calculated
+  std::vector<Token> tokens_;   /// Tokens of the expression
+  size_t index_;                /// Index of the next token to parse
+};
+
+namespace calc {
+
+/// A string literal usable as a template argument
+template <size_t size> struct FixedString {
+  consteval FixedString(const char (&text)[size]) {
+    for (size_t i{0}; i < size; ++i)
+      characters[i] = text[i];
+  }
+  constexpr std::string_view view() const { return {characters, size - 1}; }
+
+  char characters[size]{};
+};
+
+/// Calculate an expression without variables at compile time, failing the
+/// build if it is invalid, eg. calc::eval<"ln(3) + 3^2">()
+template <FixedString expression> consteval double eval() {
+  return ConstantParser(expression.view()).calculate();
+}
+
+} // namespace calc
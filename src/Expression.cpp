@@ -1,17 +1,27 @@
 // Internal headers
 #include "Expression.h"
+#include "Calculus.h"
+#include "Lexer.h"
+#include "Optimizer.h"
+#include "OutputBuffer.h"
+#include "Profiler.h"
+#include "ResultCache.h"
 
 // Standard library
 #include <algorithm>
+#include <bit>
 #include <cctype>
 #include <cmath>
-#include <iomanip>
+#include <cstddef>
+#include <cstdint>
 #include <iostream>
 #include <limits>
-#include <ranges>
-#include <regex>
+#include <optional>
 #include <stdexcept>
 #include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
 
 // Namespaces
 using namespace std::string_literals;
@@ -19,37 +29,15 @@ using namespace std::string_literals;
 // ----------------------------------------------------------------------------
 // Public Methods
 // ----------------------------------------------------------------------------
-std::string Expression::expression() {
+const std::string &Expression::expression() {
+  static const std::string noExpression{"<NO EXPRESSION>"};
   if (expression_.size() > 0) {
     return expression_;
   }
-  if (tokens_.tokens.size() == 0) {
-    if (isCalculated_) {
-      std::ostringstream oss;
-      oss << std::setprecision(precision) << result();
-      expression_ = oss.str();
-      trimmedExpression_ = expression_;
-      return expression_;
-    }
-    return "<NO EXPRESSION>";
-  }
-  if (tokens_.tokens.size() == 1) {
-    expression_ = tokens_.tokens[0].expression();
-    if (tokens_.function != Operator::None) {
-      expression_ =
-          static_cast<std::string>(operatorStrings_.at(tokens_.function)) +
-          "("s + expression_ + ")"s;
-    }
-    trimmedExpression_ = expression_;
-    return expression_;
+  if (nodes_.empty()) {
+    return noExpression;
   }
-  expression_ = "";
-  for (size_t i{0}; i < tokens_.binOps.size(); ++i) {
-    expression_ +=
-        tokens_.tokens[i].expression() +
-        static_cast<std::string>(operatorStrings_.at(tokens_.binOps[i]));
-  }
-  expression_ += tokens_.tokens.back().expression();
+  appendExpression_(expression_, outerStep_);
   trimmedExpression_ = expression_;
   return expression_;
 }
@@ -57,20 +45,35 @@ std::string Expression::expression() {
 void Expression::set_expression(const std::string &expression) {
   isParsed_ = false;
   isCalculated_ = false;
+  isAtomic_ = false;
   expression_ = expression;
   validate();
 }
 
 void Expression::validate() {
+  CALC_PROFILE_PHASE(Phase::Validate);
   isValidated_ = false;
-  // Check parentheses are matched
-  auto leftBrackets{std::count(expression_.begin(), expression_.end(), '(')};
-  if (leftBrackets != std::count(expression_.begin(), expression_.end(), ')'))
-    throw std::runtime_error("Unmatched parentheses in expression.");
-  // Trim whitespace
-  std::string trimmedExpression{expression_};
-  std::erase_if(trimmedExpression,
-                [](unsigned char c) { return std::isspace(c); });
+  // Lexing the whole expression checks its numbers, names and brackets, and
+  // the ordering of operators and operands, and rejects two numbers separated
+  // only by whitespace. Whitespace is dropped from the trimmed form except
+  // where it keeps a name apart from a following name or number, or keeps a
+  // variable e from being read as the function e^().
+  std::string trimmedExpression;
+  trimmedExpression.reserve(expression_.size());
+  Lexer lexer(expression_);
+  Lexer::TokenType previous{Lexer::TokenType::End};
+  std::string_view previousText;
+  for (Lexer::Token token{lexer.next()}; token.type != Lexer::TokenType::End;
+       token = lexer.next()) {
+    bool isSeparated{previous == Lexer::TokenType::Variable &&
+                     (Lexer::isNameCharacter(token.text.front()) ||
+                      (previousText == "e" && token.oper == Operator::Pow))};
+    if (isSeparated)
+      trimmedExpression += ' ';
+    trimmedExpression += token.text;
+    previous = token.type;
+    previousText = token.text;
+  }
   // Remove unnecessary outer parentheses
   while (trimmedExpression.front() == '(' &&
          closingBracketIndex_(trimmedExpression) + 1 ==
@@ -81,48 +84,6 @@ void Expression::validate() {
   // Remove leading '+' sign
   if (trimmedExpression.front() == '+')
     trimmedExpression.erase(trimmedExpression.begin());
-  // Check operators are all valid
-  if (!std::regex_match(trimmedExpression, exprPattern_)) {
-    throw std::runtime_error(
-        "Expression "s + trimmedExpression +
-        " is invalid: Invalid operators or numbers present");
-  }
-  // Check for valid ordering of operators, operands and parentheses
-  char firstChar{trimmedExpression.front()};
-  if (isBinaryOperator(firstChar) && firstChar != '+' && firstChar != '-') {
-    throw std::runtime_error("Expression "s + trimmedExpression +
-                             " is invalid: Begins with binary operator" +
-                             trimmedExpression.front());
-  }
-  for (size_t i{0}; i < trimmedExpression.size() - 1; i++) {
-    char curChar{trimmedExpression[i]};
-    char nextChar{trimmedExpression[i + 1]};
-    if (curChar == '(' && isBinaryOperator(nextChar) && nextChar != '+' &&
-        nextChar != '-') {
-      throw std::runtime_error("Expression "s + trimmedExpression +
-                               " is invalid: contains binary operator " +
-                               nextChar + " with no left operand");
-    }
-    if (!isBinaryOperator(curChar)) {
-      continue;
-    }
-    if (isBinaryOperator(nextChar)) {
-      throw std::runtime_error(
-          "Expression " + trimmedExpression +
-          " is invalid: contains two consecutive binary operators "s + curChar +
-          " and " + nextChar);
-    }
-    if (nextChar == ')') {
-      throw std::runtime_error("Expression "s + trimmedExpression +
-                               " is invalid: contains binary operator " +
-                               curChar + " with no right operand");
-    }
-  }
-  if (isBinaryOperator(trimmedExpression.back())) {
-    throw std::runtime_error("Expression "s + trimmedExpression +
-                             " is invalid: ends with binary operator " +
-                             trimmedExpression.back());
-  }
   isValidated_ = true;
   trimmedExpression_ = trimmedExpression;
   return;
@@ -151,17 +112,46 @@ double Expression::result() {
   if (isCalculated_) {
     return result_;
   }
-  if (isTokenized_) {
-    outerStep_ = lastCalculationStep_(tokens_);
-  } else if (!isParsed_) {
+  // Results are cached by the trimmed form of their expression string, so a
+  // hit skips tokenizing, parsing and calculating
+  bool isCacheable{cache_ && !isParsed_};
+  if (isCacheable) {
+    if (!isValidated_) {
+      validate();
+    }
+    if (std::optional<double> cached{cache_->find(trimmedExpression_)}) {
+      result_ = *cached;
+      isCalculated_ = true;
+      checkNaN_(result_);
+      return result_;
+    }
+  }
+  if (!isParsed_) {
     parse_();
   }
-  if (isAtomic_) {
-    return result_; // Value has been calculated inside parse_()
+  // Simplifying may drop a variable from the tree, as in x^0, but it must
+  // still have a value
+  for (size_t i{0}; i < variables_.size(); ++i) {
+    if (!variableValues_[i])
+      throw std::runtime_error("Variable "s + variables_[i] +
+                               " has no value.");
+  }
+  // Results of expressions with variables are recalculated for each value,
+  // so it pays to simplify them first. Without variables, simplifying would
+  // only calculate the same Nodes once more.
+  if (!isOptimized_ && !variables_.empty()) {
+    Optimizer::optimize(*this);
   }
   result_ = std::numeric_limits<double>::quiet_NaN();
-  result_ = calculate_(outerStep_);
+  {
+    CALC_PROFILE_PHASE(Phase::Calculate);
+    result_ = calculate_(outerStep_);
+  }
   isCalculated_ = true;
+  // Results of variables depend on their values as well as the expression
+  if (isCacheable && variables_.empty()) {
+    cache_->insert(trimmedExpression_, result_);
+  }
   checkNaN_(result_);
   return result_;
 }
@@ -170,24 +160,75 @@ void Expression::printCalculation() {
   showCalculation_ = true;
   isCalculated_ = false;
   parse_();
-  auto oldPrecision{std::cout.precision()};
-  std::cout.precision(precision);
-  std::cout << trimmedExpression_ << '\n';
-  if (isAtomic_) {
-    std::cout << "Result: " << result_ << '\n';
-    return;
-  }
-  while (!subexpressionsCalculated_()) {
-    for (Expression &token : tokens_.tokens) {
-      token.calculateNextStep_();
+  OutputBuffer output(std::cout);
+  output << trimmedExpression_ << '\n';
+  // Each step calculates the subexpressions whose operands are all known
+  while (!subexpressionsCalculated_(outerStep_)) {
+    const Node &root{nodes_[outerStep_]};
+    for (size_t i{0}; i < root.numOperands; ++i) {
+      calculateNextStep_(operands_[root.firstOperand + i].node);
     }
-    printPartialCalculation_();
+    printPartialCalculation_(output, outerStep_);
+    output << '\n';
   }
-  std::cout << "Result: " << result() << '\n';
-  std::cout << std::setprecision(oldPrecision);
+  double calculated{result()};
+  output << "Result: ";
+  output.appendNumber(calculated, precision) << '\n';
   showCalculation_ = false;
 }
 
+const std::vector<std::string> &Expression::variables() {
+  if (!isParsed_) {
+    parse_();
+  }
+  return variables_;
+}
+
+void Expression::set_variable(std::string_view name, double value) {
+  if (!isParsed_) {
+    parse_();
+  }
+  auto match{std::find(variables_.begin(), variables_.end(), name)};
+  if (match == variables_.end())
+    throw std::runtime_error("Expression "s + trimmedExpression_ +
+                             " has no variable " + std::string(name));
+  size_t variable{static_cast<size_t>(match - variables_.begin())};
+  variableValues_[variable] = value;
+  if (!isLinked_) {
+    linkParents_();
+  }
+  // Only the ancestors of the variable's leaves depend on its value. A
+  // calculated Node's operands are all calculated, so the walk up can stop
+  // at a Node which is already uncalculated.
+  for (size_t i{leafOffsets_[variable]}; i < leafOffsets_[variable + 1]; ++i) {
+    Node &leaf{nodes_[leaves_[i]]};
+    if (leaf.isCalculated &&
+        std::bit_cast<std::uint64_t>(leaf.result) ==
+            std::bit_cast<std::uint64_t>(value))
+      continue;
+    leaf.result = value;
+    leaf.isCalculated = true;
+    isCalculated_ = false;
+    invalidateAncestors_(leaves_[i]);
+  }
+}
+
+void Expression::set_fast_math(int precision) {
+  std::span<const FastMath::Function> functions;
+  if (precision != FastMath::fullPrecision)
+    functions = FastMath::functions(precision);
+  if (functions.data() == fastFunctions_.data())
+    return;
+  fastFunctions_ = functions;
+  // Numbers and variables keep their values, while everything above them
+  // may include a function
+  for (Node &node : nodes_) {
+    if (node.numOperands > 0)
+      node.isCalculated = false;
+  }
+  isCalculated_ = false;
+}
+
 bool Expression::isAtomic() {
   if (!isParsed_) {
     parse_();
@@ -198,309 +239,363 @@ bool Expression::isAtomic() {
 // ----------------------------------------------------------------------------
 // Private Methods
 // ----------------------------------------------------------------------------
-void Expression::calculateNextStep_() {
-  if (isCalculated_ || isAtomic()) {
+void Expression::calculateNextStep_(size_t node) {
+  if (nodes_[node].isCalculated) {
     return;
   }
-  if (!isParsed_) {
-    parse_();
+  // Operands calculated during this step only become usable in the next one
+  if (subexpressionsCalculated_(node)) {
+    calculate_(node);
+    return;
   }
-  // Expressions with wrapping function have 1 token: the function argument
-  if (tokens_.function != Operator::None && tokens_.tokens[0].isCalculated_) {
-    result(); // Evaluate this expression
+  for (size_t i{0}; i < nodes_[node].numOperands; ++i) {
+    calculateNextStep_(operands_[nodes_[node].firstOperand + i].node);
+  }
+}
+
+void Expression::printPartialCalculation_(OutputBuffer &output,
+                                          size_t node) const {
+  const Node &current{nodes_[node]};
+  if (current.isCalculated) {
+    output.appendNumber(current.result, precision);
     return;
   }
-  bool uncalculatedSubExpressions{false};
-  for (Expression &token : tokens_.tokens) {
-    if (!token.isCalculated_) {
-      uncalculatedSubExpressions = true;
-      if (token.subexpressionsCalculated_()) {
-        result();
-        continue;
-      }
-      token.calculateNextStep_();
+  if (current.variable != noVariable) {
+    output << variables_[current.variable];
+    return;
+  }
+  if (current.hasBrackets) {
+    output << '(';
+  }
+  if (current.function != Operator::None) {
+    output << operatorStrings_.at(current.function) << '(';
+  }
+  for (size_t i{0}; i < current.numOperands; ++i) {
+    const Operand &operand{operands_[current.firstOperand + i]};
+    if (i > 0) {
+      output << operatorStrings_.at(operand.oper);
     }
+    printPartialCalculation_(output, operand.node);
   }
-  if (uncalculatedSubExpressions) {
-    return;
+  if (current.function != Operator::None) {
+    output << ')';
+  }
+  if (current.hasBrackets) {
+    output << ')';
   }
-  result();
 }
 
-void Expression::printPartialCalculation_() {
-  if (isCalculated_) {
-    std::cout << result_ << (isSubexpression_ ? "" : "\n");
+void Expression::appendExpression_(std::string &str, size_t node) const {
+  const Node &current{nodes_[node]};
+  if (current.variable != noVariable) {
+    str += variables_[current.variable];
     return;
   }
-  if (tokens_.function != Operator::None) {
-    std::cout << operatorStrings_.at(tokens_.function) << '(';
+  if (current.numOperands == 0) {
+    OutputBuffer::appendNumber(str, current.result,
+                               precision < 0 ? OutputBuffer::shortest
+                                             : std::clamp(precision, 1, 17));
+    return;
   }
-  if (hasBrackets_) {
-    std::cout << '(';
+  if (current.hasBrackets) {
+    str += '(';
   }
-  for (size_t i{0}; i < tokens_.tokens.size(); ++i) {
-    Expression token{tokens_.tokens[i]};
-    if (!token.isParsed_) {
-      token.parse_();
-    }
-    tokens_.tokens[i].printPartialCalculation_();
-    if (i + 1 == tokens_.tokens.size()) {
-      continue;
-    }
-    std::cout << operatorStrings_.at(tokens_.binOps[i]);
+  if (current.function != Operator::None) {
+    str += operatorStrings_.at(current.function);
+    str += '(';
   }
-  if (tokens_.function != Operator::None) {
-    std::cout << ')';
+  for (size_t i{0}; i < current.numOperands; ++i) {
+    const Operand &operand{operands_[current.firstOperand + i]};
+    if (i > 0) {
+      str += operatorStrings_.at(operand.oper);
+    }
+    appendExpression_(str, operand.node);
   }
-  if (hasBrackets_) {
-    std::cout << ')';
+  if (current.function != Operator::None) {
+    str += ')';
   }
-  if (!isSubexpression_) {
-    std::cout << '\n';
+  if (current.hasBrackets) {
+    str += ')';
   }
 }
 
-bool Expression::subexpressionsCalculated_() {
-  for (Expression &token : tokens_.tokens) {
-    if (!token.isCalculated_) {
+bool Expression::subexpressionsCalculated_(size_t node) const {
+  for (size_t i{0}; i < nodes_[node].numOperands; ++i) {
+    if (!nodes_[operands_[nodes_[node].firstOperand + i].node].isCalculated) {
       return false;
     }
   }
   return true;
 }
 
-double Expression::parsedNumber_(const std::string &numStr) {
-  std::string cleaned;
-  // Remove any parentheses and whitespace from the string
-  cleaned.reserve(numStr.size());
-  for (char c : numStr) {
-    if (c == '(' || c == ')' || std::isspace(static_cast<unsigned char>(c)))
-      continue;
-    cleaned += c;
-  }
-  // Convert from std::string to double
-  return std::stod(cleaned);
-}
-
 // Arrange expression into subexpressions
 // Arranged such that outermost expression consists of the last operation to
 // calculate on subexpressions according to BEDMAS, so full result can be found
 // recursively.
 void Expression::parse_() {
+  CALC_PROFILE_PHASE(Phase::Parse);
   if (!isValidated_) {
     validate();
   }
-  // Clear previous results
-  tokens_.tokens.clear();
-  tokens_.binOps.clear();
-  outerStep_.operands.clear();
-  outerStep_.operators.clear();
-  // Check if expression is just a number
-  if (!isAtomic_ && std::regex_match(trimmedExpression_, numPattern_)) {
-    isAtomic_ = true;
+  // Break expression down into recursive subexpressions based on BEDMAS
+  // arithmetic rules
+  // Outer parentheses were removed in trimmedExpression_ during validation
+  // Variables found again when parsing keep the values bound to them
+  std::vector<std::string> oldVariables{std::move(variables_)};
+  std::vector<std::optional<double>> oldValues{std::move(variableValues_)};
+  variables_.clear();
+  variableValues_.clear();
+  outerStep_ = lastCalculationStep_(tokenizeExpression_());
+  isOptimized_ = false;
+  isLinked_ = false;
+#ifdef CALC_STATS
+  if (Profiler::isEnabled())
+    Profiler::recordTree(nodes_.size(), depth_(outerStep_));
+#endif
+  for (size_t i{0}; i < oldVariables.size(); ++i) {
+    auto match{std::find(variables_.begin(), variables_.end(), oldVariables[i])};
+    if (match != variables_.end())
+      variableValues_[static_cast<size_t>(match - variables_.begin())] =
+          oldValues[i];
+  }
+  for (Node &node : nodes_) {
+    if (node.variable != noVariable && variableValues_[node.variable]) {
+      node.result = *variableValues_[node.variable];
+      node.isCalculated = true;
+    }
   }
+  // Check if expression is just a number
+  isAtomic_ = nodes_[outerStep_].numOperands == 0 &&
+              nodes_[outerStep_].variable == noVariable;
   if (isAtomic_) {
-    result_ = parsedNumber_(trimmedExpression_);
+    result_ = nodes_[outerStep_].result;
     isCalculated_ = true;
-    return;
   }
-  // Break expression down into recursive subexpressions based on BEDMAS
-  // arithmetic rules
-  // Outer parentheses were removed in trimmedExpression_ during validation
-  tokenizeExpression_(showCalculation_);
-  outerStep_ = lastCalculationStep_(tokens_);
   isParsed_ = true;
 }
 
-void Expression::tokenizeExpression_(bool showCalculation) {
+std::vector<Lexer::Token> Expression::tokenizeExpression_() {
+  CALC_PROFILE_PHASE(Phase::Tokenize);
   if (!isValidated_) {
     validate();
   }
-  std::vector<Expression> subexpressions;
-  Operator function{Operator::None};     // on whole expression
-  std::vector<Operator> binaryOperators; // between subexpressions
-  std::string remainingExpression;
-  // Check for leading operators
-  bool hasFrontMultiplier{false};
-  switch (trimmedExpression_.front()) {
-  case '-':
-    hasFrontMultiplier = true;
-    subexpressions.push_back(Expression(-1.0));
-    binaryOperators.push_back(Operator::Times);
-    remainingExpression = trimmedExpression_.substr(1);
-    break;
-  case '+':
-    remainingExpression = trimmedExpression_.substr(1);
-    break;
-  case 'x':
-  case '/':
-  case '*':
-  case '^':
-  case '%':
-    throw std::runtime_error("Leading binary operator found in expression.");
-  default:
-    remainingExpression = trimmedExpression_;
-  }
-
-  // Tokenize the string from left to right into subexpressions and operators
-  bool prevTokenWasBinOp{false};
-  std::smatch match;
-  while (remainingExpression.size() > 0) {
-    size_t closingIndex;    // End index of token
-    bool foundMatch{false}; // Used to avoid regex matching when unnecessary
-    char frontChar{remainingExpression.front()};
-    switch (frontChar) {
-    case '+':
-    case '-':
-    case 'x':
-    case '*':
-    case '/':
-    case '^':
-    case '%':
-      binaryOperators.push_back(operators_.at(std::string(1, frontChar)));
-      prevTokenWasBinOp = true;
-      remainingExpression = remainingExpression.substr(1);
-      continue;
-    case '(':
-      closingIndex = closingBracketIndex_(remainingExpression);
-      subexpressions.push_back(Expression(
-          remainingExpression.substr(1, closingIndex - 1), showCalculation));
-      remainingExpression = remainingExpression.substr(closingIndex + 1);
-      prevTokenWasBinOp = false;
-      foundMatch = true;
-    }
-    // Is remaining expression wrapped in brackets?
-    if (!foundMatch &&
-        std::regex_match(remainingExpression, match, numToken_)) {
-      // Construct expression with result already stored, since it's just a
-      // double
-      subexpressions.push_back(
-          Expression(std::stod(match[1].str()), showCalculation));
-      closingIndex = static_cast<size_t>(match[1].length() - 1);
-      remainingExpression = match[2].str();
-      prevTokenWasBinOp = false;
-    } else if (!foundMatch &&
-               std::regex_match(remainingExpression, match, funcToken_)) {
-      if (!match[2].matched)
-        throw std::runtime_error("Function in expression without argument.");
-      closingIndex = closingBracketIndex_(match[2].str(), true);
-      std::string argument{match[2].str().substr(0, closingIndex)};
-      // Account for size of function and opening bracket
-
-      closingIndex += static_cast<size_t>(match[1].length() + 1);
-      if (closingIndex + 1 == remainingExpression.size()) {
-        // remainingExpression is just function call on inner expression
-        if (binaryOperators.size() > 0) {
-          subexpressions.push_back(
-              Expression(remainingExpression, showCalculation));
-          break;
-        }
-        function = operators_.at(match[1].str());
-        subexpressions.push_back(Expression(argument, showCalculation));
-        remainingExpression.clear();
-      } else {
-        subexpressions.push_back(Expression(
-            remainingExpression.substr(0, closingIndex + 1), showCalculation));
-        remainingExpression = remainingExpression.substr(closingIndex + 1);
-        prevTokenWasBinOp = false;
+  static constexpr Lexer::Token minusOne{.type = Lexer::TokenType::Number,
+                                         .oper = Operator::None,
+                                         .value = -1.0,
+                                         .text = "-1",
+                                         .integer = -1,
+                                         .isInteger = true};
+  static constexpr Lexer::Token times{.type = Lexer::TokenType::BinaryOperator,
+                                      .oper = Operator::Times,
+                                      .value = 0.0,
+                                      .text = "x"};
+  std::vector<Lexer::Token> tokens;
+  tokens.reserve(trimmedExpression_.size());
+  Lexer lexer(trimmedExpression_);
+  // The start of the expression behaves like an opening bracket
+  Lexer::TokenType previous{Lexer::TokenType::LeftBracket};
+  for (Lexer::Token token{lexer.next()}; token.type != Lexer::TokenType::End;
+       token = lexer.next()) {
+    if (token.type == Lexer::TokenType::BinaryOperator &&
+        previous == Lexer::TokenType::LeftBracket) {
+      // Leading sign: rewrite -<expr> as -1 x <expr> and drop a leading +
+      if (token.oper == Operator::Minus) {
+        tokens.push_back(minusOne);
+        tokens.push_back(times);
       }
-    } else if (!foundMatch) {
-      throw std::runtime_error("Unexpected token found during tokenization.");
+      previous = Lexer::TokenType::BinaryOperator;
+      continue;
     }
-    if (prevTokenWasBinOp)
-      binaryOperators.push_back(Operator::Times);
-    foundMatch = false;
-  }
-  TokenizedExpression result = {.tokens = subexpressions,
-                                .binOps = binaryOperators,
-                                .function = function};
-  tokens_ = result;
-  isTokenized_ = true;
-}
-
-Expression::Step Expression::lastCalculationStep_(TokenizedExpression &tokens) {
-  Step lastStep;
-  // Assumes that any functions are present, they wrap the whole expression
-  if (tokens.tokens.size() == 1) {
-    if (!tokens.binOps.empty() || tokens.function == Operator::None)
-      throw std::runtime_error(
-          "Found binary operator acting on single token and no unary operator");
-    lastStep.operators.push_back(tokens.function);
-    lastStep.operands.push_back(tokens.tokens[0]);
-    return lastStep;
-  }
-  if (tokens.binOps.size() + 1 != tokens.tokens.size())
-    throw std::runtime_error(
-        "Too many or too few binary operators for number of tokens.");
-  if (tokens.tokens.size() == 2) {
-    lastStep.operators.push_back(tokens.binOps[0]);
-    lastStep.operands.push_back(tokens.tokens[0]);
-    lastStep.operands.push_back(tokens.tokens[1]);
-    return lastStep;
-  }
-  // From lowest to highest priority in BEDMAS:
-  // priority 3 for + -, 2 for * x /, 1 for ^
-  int priority{3};
-  int numSteps{0};
-  bool foundStepThisIter{false};
-  size_t operInd{0};
-  size_t lastUngroupedTokenInd{0};
-  while (priority > 0 && (numSteps == 0 || operInd != 0)) {
-    Operator op{tokens.binOps[operInd]};
-    if ((priority == 3 && (op == Operator::Plus || op == Operator::Minus)) ||
-        (priority == 2 && (op == Operator::Times || op == Operator::Divide ||
-                           op == Operator::Mod)) ||
-        priority == 1) {
-      foundStepThisIter = true;
-      numSteps++;
-      lastStep.operators.push_back(op);
-      if (operInd - lastUngroupedTokenInd == 0) {
-        lastStep.operands.push_back(tokens.tokens[lastUngroupedTokenInd]);
-      } else {
-        lastStep.operands.push_back(
-            combinedTokens_(tokens, lastUngroupedTokenInd, operInd + 1));
-      }
-      lastUngroupedTokenInd = operInd + 1;
+    // Operations such as integrate() are calculated here, becoming numbers
+    if (token.type == Lexer::TokenType::Operation) {
+      token = {.type = Lexer::TokenType::Number,
+               .oper = Operator::None,
+               .value = Calculus::calculate(token.text),
+               .text = token.text};
     }
-    if (operInd + 1 == tokens.binOps.size()) {
-      if (foundStepThisIter) {
-        // Must be only one token left
-        lastStep.operands.push_back(tokens.tokens.back());
-        break;
-      }
-      if (priority == 1 && !foundStepThisIter)
-        throw std::runtime_error(
-            "Failed to find lowest-priority calculation step.");
-      operInd = 0;
-      priority--;
-    } else {
-      operInd++;
+    // Adjacent operands without a binary operator between them are multiplied
+    bool startsOperand{token.type == Lexer::TokenType::Number ||
+                       token.type == Lexer::TokenType::Variable ||
+                       token.type == Lexer::TokenType::Function ||
+                       token.type == Lexer::TokenType::LeftBracket};
+    if (startsOperand && (previous == Lexer::TokenType::Number ||
+                          previous == Lexer::TokenType::Variable ||
+                          previous == Lexer::TokenType::RightBracket)) {
+      tokens.push_back(times);
     }
-    foundStepThisIter = false;
+    tokens.push_back(token);
+    previous = token.type;
   }
-  if (numSteps > 0 && lastUngroupedTokenInd < tokens.binOps.size()) {
-    // Have to append combined token of all remaining tokens
-    lastStep.operands.push_back(
-        combinedTokens_(tokens, lastUngroupedTokenInd, tokens.tokens.size()));
+  return tokens;
+}
+
+size_t
+Expression::lastCalculationStep_(const std::vector<Lexer::Token> &tokens) {
+  CALC_PROFILE_PHASE(Phase::BuildTree);
+  // Precedence climbing: every token is visited once, and each Node is built
+  // in place as soon as its last operand has been read. There are never more
+  // Nodes or Operands than tokens, so reserving up front avoids reallocation.
+  nodes_.clear();
+  operands_.clear();
+  nodes_.reserve(tokens.size());
+  operands_.reserve(tokens.size());
+  std::vector<Operand> pending;
+  pending.reserve(tokens.size());
+  size_t index{0};
+  size_t root{parseOperation_(tokens, index, 1, pending)};
+  if (index != tokens.size())
+    throw std::runtime_error("Unexpected token found after end of expression.");
+  return root;
+}
+
+size_t Expression::parseOperation_(const std::vector<Lexer::Token> &tokens,
+                                   size_t &index, int priority,
+                                   std::vector<Operand> &pending) {
+  if (priority > priority_(Operator::Pow)) {
+    return parseOperand_(tokens, index, pending);
+  }
+  size_t firstOperand{parseOperation_(tokens, index, priority + 1, pending)};
+  auto continuesStep{[&tokens, &index, priority]() {
+    return index < tokens.size() &&
+           tokens[index].type == Lexer::TokenType::BinaryOperator &&
+           priority_(tokens[index].oper) == priority;
+  }};
+  if (!continuesStep()) {
+    return firstOperand;
+  }
+  // Operators of equal priority are applied left-to-right in a single Node
+  size_t pendingStart{pending.size()};
+  pending.push_back({.node = firstOperand, .oper = Operator::None});
+  while (continuesStep()) {
+    Operator oper{tokens[index++].oper};
+    size_t operand{parseOperation_(tokens, index, priority + 1, pending)};
+    pending.push_back({.node = operand, .oper = oper});
+  }
+  Node node{.firstOperand = operands_.size(),
+            .numOperands = pending.size() - pendingStart};
+  auto first{pending.begin() + static_cast<std::ptrdiff_t>(pendingStart)};
+  operands_.insert(operands_.end(), first, pending.end());
+  pending.erase(first, pending.end());
+  return addNode_(node);
+}
+
+size_t Expression::parseOperand_(const std::vector<Lexer::Token> &tokens,
+                                 size_t &index, std::vector<Operand> &pending) {
+  auto expect{[&tokens, &index](Lexer::TokenType type) {
+    if (index >= tokens.size() || tokens[index].type != type)
+      throw std::runtime_error("Unexpected token found during parsing.");
+    ++index;
+  }};
+  if (index >= tokens.size())
+    throw std::runtime_error("Expected an operand at end of expression.");
+  const Lexer::Token &token{tokens[index++]};
+  switch (token.type) {
+  case Lexer::TokenType::Number:
+    return addNode_({.result = token.value,
+                     .isCalculated = true,
+                     .integer = token.integer,
+                     .isInteger = token.isInteger});
+  case Lexer::TokenType::Variable:
+    return addNode_({.variable = variableIndex_(token.text)});
+  case Lexer::TokenType::LeftBracket: {
+    size_t subexpression{parseOperation_(tokens, index, 1, pending)};
+    expect(Lexer::TokenType::RightBracket);
+    nodes_[subexpression].hasBrackets = true;
+    return subexpression;
+  }
+  case Lexer::TokenType::Function: {
+    expect(Lexer::TokenType::LeftBracket);
+    size_t argument{parseOperation_(tokens, index, 1, pending)};
+    expect(Lexer::TokenType::RightBracket);
+    operands_.push_back({.node = argument, .oper = Operator::None});
+    return addNode_({.function = token.oper,
+                     .firstOperand = operands_.size() - 1,
+                     .numOperands = 1});
   }
-  return lastStep;
+  default:
+    throw std::runtime_error("Unexpected token found during parsing.");
+  }
+}
+
+void Expression::linkParents_() {
+  // Count the parents of each Node and the leaves of each variable into the
+  // offsets, sum them into the end of each range, then fill each range from
+  // its end, which leaves the offsets at the start of each range
+  parentOffsets_.assign(nodes_.size() + 1, 0);
+  leafOffsets_.assign(variables_.size() + 1, 0);
+  for (const Node &node : nodes_) {
+    for (size_t i{0}; i < node.numOperands; ++i)
+      ++parentOffsets_[operands_[node.firstOperand + i].node];
+    if (node.variable != noVariable)
+      ++leafOffsets_[node.variable];
+  }
+  for (size_t i{1}; i < parentOffsets_.size(); ++i)
+    parentOffsets_[i] += parentOffsets_[i - 1];
+  for (size_t i{1}; i < leafOffsets_.size(); ++i)
+    leafOffsets_[i] += leafOffsets_[i - 1];
+  parents_.resize(parentOffsets_.back());
+  leaves_.resize(leafOffsets_.back());
+  for (size_t parent{0}; parent < nodes_.size(); ++parent) {
+    const Node &node{nodes_[parent]};
+    for (size_t i{0}; i < node.numOperands; ++i)
+      parents_[--parentOffsets_[operands_[node.firstOperand + i].node]] =
+          parent;
+    if (node.variable != noVariable)
+      leaves_[--leafOffsets_[node.variable]] = parent;
+  }
+  isLinked_ = true;
+}
+
+void Expression::invalidateAncestors_(size_t node) {
+  for (size_t i{parentOffsets_[node]}; i < parentOffsets_[node + 1]; ++i) {
+    Node &parent{nodes_[parents_[i]]};
+    if (parent.isCalculated) {
+      parent.isCalculated = false;
+      invalidateAncestors_(parents_[i]);
+    }
+  }
+}
+
+size_t Expression::addNode_(const Node &node) {
+  nodes_.push_back(node);
+  return nodes_.size() - 1;
+}
+
+size_t Expression::depth_(size_t node) const {
+  // Operands are stored before the Nodes they belong to
+  std::vector<size_t> depths(node + 1, 1);
+  for (size_t i{0}; i <= node; ++i) {
+    const Node &current{nodes_[i]};
+    for (size_t j{0}; j < current.numOperands; ++j)
+      depths[i] = std::max(depths[i],
+                           depths[operands_[current.firstOperand + j].node] + 1);
+  }
+  return depths[node];
 }
 
-Expression Expression::combinedTokens_(TokenizedExpression &tokens,
-                                       const size_t &startInd,
-                                       const size_t &stopInd,
-                                       bool showCalculation) {
-  if (stopInd - startInd < 1)
-    throw std::runtime_error("Attempting to 'combine' zero tokens.");
-  auto tokenSlice = tokens.tokens | std::views::drop(startInd) |
-                    std::views::take(stopInd - startInd);
-  auto operSlice = tokens.binOps | std::views::drop(startInd) |
-                   std::views::take(stopInd - startInd - 1);
-  TokenizedExpression subTokens{
-      .tokens = std::vector<Expression>(tokenSlice.begin(), tokenSlice.end()),
-      .binOps = std::vector<Operator>(operSlice.begin(), operSlice.end()),
-  };
-  return Expression(subTokens, showCalculation);
+size_t Expression::variableIndex_(std::string_view name) {
+  auto match{std::find(variables_.begin(), variables_.end(), name)};
+  if (match != variables_.end())
+    return static_cast<size_t>(match - variables_.begin());
+  variables_.emplace_back(name);
+  variableValues_.emplace_back();
+  return variables_.size() - 1;
+}
+
+int Expression::priority_(Operator oper) {
+  switch (oper) {
+  case Operator::Plus:
+  case Operator::Minus:
+    return 1;
+  case Operator::Times:
+  case Operator::Divide:
+  case Operator::Mod:
+    return 2;
+  case Operator::Pow:
+    return 3;
+  default:
+    return 0;
+  }
 }
 
 size_t Expression::closingBracketIndex_(const std::string &str,
@@ -526,96 +621,64 @@ size_t Expression::closingBracketIndex_(const std::string &str,
 
 double Expression::calculate_(const Operator &numOperator,
                               const double operand) {
-  double value{std::numeric_limits<double>::quiet_NaN()};
-  switch (numOperator) {
-  case Operator::None:
-    value = operand;
-    break;
-  case Operator::Exp:
-    value = std::exp(operand);
-    break;
-  case Operator::Sqrt:
-    value = std::sqrt(operand);
-    break;
-  case Operator::Ln:
-    value = std::log(operand);
-    break;
-  case Operator::Log:
-    value = std::log10(operand);
-    break;
-  case Operator::Sin:
-    value = std::sin(operand);
-    break;
-  case Operator::Cos:
-    value = std::cos(operand);
-    break;
-  case Operator::Tan:
-    value = std::tan(operand);
-    break;
-  case Operator::Sinh:
-    value = std::sinh(operand);
-    break;
-  case Operator::Cosh:
-    value = std::cosh(operand);
-    break;
-  case Operator::Tanh:
-    value = std::tanh(operand);
-    break;
-  default:
-    throw std::runtime_error("Invalid operator given single operand.");
-  }
-  checkNaN_(value);
-  return value;
+  return dispatchUnary(numOperator, [operand]<Operator oper>() {
+    return applyUnary<oper>(operand);
+  });
 }
 
 double Expression::calculate_(const Operator &numOperator,
                               const double leftOperand,
                               const double rightOperand) {
-  double value{std::numeric_limits<double>::quiet_NaN()};
-  switch (numOperator) {
-  case Operator::Plus:
-    value = leftOperand + rightOperand;
-    break;
-  case Operator::Minus:
-    value = leftOperand - rightOperand;
-    break;
-  case Operator::Times:
-    value = leftOperand * rightOperand;
-    break;
-  case Operator::Divide:
-    value = leftOperand / rightOperand;
-    break;
-  case Operator::Mod:
-    value = std::fmod(leftOperand, rightOperand);
-    break;
-  case Operator::Pow:
-    value = std::pow(leftOperand, rightOperand);
-    break;
-  default:
-    throw std::runtime_error("Invalid operator given two operands.");
-  }
-  checkNaN_(value);
-  return value;
+  return dispatchBinary(
+      numOperator, [leftOperand, rightOperand]<Operator oper>() {
+        return applyBinary<oper>(leftOperand, rightOperand);
+      });
 }
 
-double Expression::calculate_(Step &step) {
-  // Apply operators to operands left-to-right
-  // Assumes unary operators only appear when there is one operand
-  if (step.operands.size() == 1) {
-    if (step.operators.size() != 1)
-      throw std::runtime_error("Too many operators relative to operands.");
-    return calculate_(step.operators[0], step.operands[0].result());
-  }
-  if (step.operators.size() + 1 != step.operands.size()) {
-    throw std::runtime_error(
-        "For binary operations, there must be one less operator than operands");
-  }
-  double runningResult{step.operands[0].result()};
-  for (size_t i{1}; i < step.operands.size(); ++i) {
-    runningResult = calculate_(step.operators[i - 1], runningResult,
-                               step.operands[i].result());
+Expression::Number Expression::calculate_(const Operator &numOperator,
+                                          const Number leftOperand,
+                                          const Number rightOperand) {
+  return dispatchBinary(
+      numOperator, [leftOperand, rightOperand]<Operator oper>() {
+        return applyNumberBinary<oper>(leftOperand, rightOperand);
+      });
+}
+
+double Expression::calculate_(size_t node) {
+  Node &current{nodes_[node]};
+  if (current.isCalculated) {
+    return current.result;
+  }
+  if (current.variable != noVariable) {
+    throw std::runtime_error("Variable "s + variables_[current.variable] +
+                             " has no value.");
+  }
+  if (current.numOperands == 0) {
+    throw std::runtime_error("Found uncalculated Node with no operands.");
+  }
+  const Operand *operands{&operands_[current.firstOperand]};
+  calculate_(operands[0].node);
+  Number runningResult{number_(nodes_[operands[0].node])};
+  if (current.function != Operator::None) {
+    // Functions of integers are rarely integers, so they are always doubles
+    if (!fastFunctions_.empty()) {
+      runningResult = {fastFunctions_[static_cast<size_t>(current.function)](
+          runningResult.value)};
+    } else {
+      runningResult = {calculate_(current.function, runningResult.value)};
+    }
   }
-  return runningResult;
+  // Apply binary operators to operands left-to-right
+  for (size_t i{1}; i < current.numOperands; ++i) {
+    calculate_(operands[i].node);
+    runningResult = calculate_(operands[i].oper, runningResult,
+                               number_(nodes_[operands[i].node]));
+  }
+  current.result = runningResult.value;
+  current.integer = runningResult.integer;
+  current.isInteger = runningResult.isInteger;
+  current.isCalculated = true;
+  return runningResult.value;
 }
 
 const std::unordered_map<Expression::Operator, std::string_view>
@@ -631,32 +694,6 @@ Expression::constructOperatorStrings_() {
   return map;
 }
 
-const std::regex Expression::constructExprPattern_() {
-  std::string pattern;
-  bool first{true};
-  for (const auto &[key, value] : operators_) {
-    if (!first)
-      pattern += '|';
-    pattern += escapeRegex_(key);
-    first = false;
-  }
-  pattern = R"(^()"s + pattern + R"(|\(|\)|\d+\.?\d*)+$)";
-  return std::regex(pattern);
-}
-
-const std::string Expression::escapeRegex_(std::string_view str) {
-  const std::string_view regexSpecials = R"(.^$*+?()[]{}|\)";
-  std::string escaped;
-  escaped.reserve(str.size() * 2);
-  for (char c : str) {
-    if (regexSpecials.find(c) != std::string::npos) {
-      escaped += '\\';
-    }
-    escaped += c;
-  }
-  return escaped;
-}
-
 const std::unordered_map<std::string_view, Expression::Operator>
     Expression::operators_{{"+", Expression::Operator::Plus},
                            {"-", Expression::Operator::Minus},
@@ -679,7 +716,3 @@ const std::unordered_map<std::string_view, Expression::Operator>
                            {"NULL", Expression::Operator::None}};
 const std::unordered_map<Expression::Operator, std::string_view>
     Expression::operatorStrings_{constructOperatorStrings_()};
-const std::regex Expression::exprPattern_{constructExprPattern_()};
-const std::regex Expression::numPattern_{std::regex(R"(^\d+\.?\d*$)")};
-const std::regex Expression::numToken_{std::regex(R"(^(\d+\.?\d*)(.*))")};
-const std::regex Expression::funcToken_{std::regex(R"(^([a-z]+|e^)\((.+))")};
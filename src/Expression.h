@@ -1,13 +1,22 @@
 #pragma once
 
+// Internal headers
+#include "FastMath.h"
+#include "Lexer.h"
+#include "Operator.h"
+
 // Standard library
 #include <cmath>
+#include <cstdint>
 #include <iostream>
-#include <regex>
+#include <memory>
+#include <optional>
+#include <span>
 #include <stdexcept>
 #include <string>
 #include <string_view>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 /******************************************************************************
@@ -21,99 +30,97 @@
  *   - some mathematical functions: sqrt(), sin(), cos(), tan(), sinh(), cosh(),
  *       tanh(), ln() (natural logarithm), log() (base 10 logarithm),
  *       and e^() (Exponent of Euler's number)
+ *   - the Calculus operations integrate(<expression>, <variable>, <from>,
+ *       <to>) and root(<expression>, <variable>, <lower>, <upper>), which are
+ *       calculated while tokenizing and then read as numbers
  * Any mathematically valid combination of these operators is valid as an input
  * string, nested or otherwise, but functions must be followed by their
- * arguments enclosed in parentheses. Note: whitespace is ignored in input
- * strings.
+ * arguments enclosed in parentheses. Any other name, such as x, rate or t0, is
+ * a variable whose value is bound with set_variable() before calculating. An
+ * 'x' following an operand is read as multiplication, so "2x3" is 6 while
+ * "2 x x" is twice the variable x. Whitespace is otherwise ignored, except
+ * that it separates adjacent names, and two numbers separated only by
+ * whitespace, as in "1 000", are invalid rather than multiplied.
  *****************************************************************************/
+class OutputBuffer;
+class ResultCache;
+
 class Expression {
+  /// Lowers parsed Expressions into bytecode, reusing calculate_()
+  template <typename Scalar> friend class BasicCompiledExpression;
+  /// Folds constants and merges identical subexpressions of parsed trees
+  friend class Optimizer;
+  /// Tokenizes expression strings, looking names up in operators_
+  friend class Lexer;
+  /// Times tokenizing and building the tree separately in the benchmarks
+  friend struct ParsingPhases;
+
 public:
-  // Enums
-  enum class Operator {
-    None, /// Represents the identity, or no operation.
-    Plus,
-    Minus,
-    Times,
-    Divide,
-    Pow, /// One number to the power of another: x^y
-    Mod,
-    Exp, /// A power of Euler's number: e^()
-    Sqrt,
-    Ln,
-    Log,
-    Sin,
-    Cos,
-    Tan,
-    Sinh,
-    Cosh,
-    Tanh,
-  };
+  // Types
+  using Operator = ::Operator;
+  using Number = ::Number;
+
+  // Constants
+
+  /// Node::variable of Nodes which are not variables
+  static constexpr size_t noVariable{static_cast<size_t>(-1)};
 
   // Structs
 
-  /// Subexpressions and their connecting operators composing an Expression
-  struct TokenizedExpression {
-    std::vector<Expression> tokens{};
-    std::vector<Operator> binOps{};
-    Operator function{Operator::None};
+  /// A single mathematical calculation in the parsed tree of an Expression:
+  /// a number, a unary function of one operand, or binary operators of equal
+  /// priority applied left-to-right between operands. All nodes of a tree are
+  /// stored in one array owned by the Expression and refer to each other by
+  /// index, so parsing needs a fixed handful of allocations.
+  struct Node {
+    Operator function{Operator::None}; /// Unary function, if any
+    size_t firstOperand{0}; /// Index of the first Operand in operands_
+    size_t numOperands{0};  /// Zero for numbers
+    double result{0.0};     /// Value of a number, or the calculated result
+    bool isCalculated{false};
+    bool hasBrackets{false}; /// Whether wrapped in parentheses in the input
+    size_t variable{noVariable}; /// Index in variables() of a variable leaf
+    std::int64_t integer{0}; /// Exact value of result, if isInteger
+    bool isInteger{false};   /// Whether an integer-only subexpression
   };
-  /// Represents a single mathematical calculation to be conducted
-  struct Step {
-    std::vector<Operator> operators{};
-    std::vector<Expression> operands{};
+  /// An operand of a Node, together with the binary operator applied to it
+  struct Operand {
+    size_t node{0};                /// Index of the operand in nodes_
+    Operator oper{Operator::None}; /// None for the first operand
   };
 
   // Ensure default constructor exists even though we've defined others
   Expression()
-      : precision(3), expression_(), trimmedExpression_(), hasBrackets_(false),
-        isValidated_(false), isParsed_(false), isTokenized_(false),
-        isCalculated_(false), isAtomic_(false), showCalculation_(false),
-        isSubexpression_(false), result_(0.0), tokens_(), outerStep_() {}
-  explicit Expression(const std::string &expr, bool isSubexpression = false,
-                      bool showCalculation = false, bool hasBrackets = false)
-      : precision(3), expression_(expr),
-        trimmedExpression_(isSubexpression ? expr : ""),
-        hasBrackets_(hasBrackets), isValidated_(isSubexpression),
-        isParsed_(false), isTokenized_(false), isCalculated_(false),
-        isAtomic_(false), showCalculation_(showCalculation),
-        isSubexpression_(isSubexpression), result_(0.0), tokens_(),
-        outerStep_() {
+      : precision(3), expression_(), trimmedExpression_(), isValidated_(false),
+        isParsed_(false), isOptimized_(false), isCalculated_(false),
+        isAtomic_(false), showCalculation_(false), result_(0.0), nodes_(),
+        operands_(), outerStep_(0), variables_(), variableValues_(),
+        isLinked_(false), parentOffsets_(), parents_(), leafOffsets_(),
+        leaves_(), cache_(), fastFunctions_() {}
+  explicit Expression(const std::string &expr, bool showCalculation = false)
+      : precision(3), expression_(expr), trimmedExpression_(),
+        isValidated_(false), isParsed_(false), isOptimized_(false),
+        isCalculated_(false), isAtomic_(false),
+        showCalculation_(showCalculation), result_(0.0), nodes_(), operands_(),
+        outerStep_(0), variables_(), variableValues_(), isLinked_(false),
+        parentOffsets_(), parents_(), leafOffsets_(), leaves_(), cache_(),
+        fastFunctions_() {
     if (showCalculation)
       std::cout << "Expression instantiated: " << expression() << std::endl;
   }
-  explicit Expression(TokenizedExpression &tokens, bool isSubexpression = true,
-                      bool showCalculation = false, bool hasBrackets = false)
-      : precision(3), expression_(), trimmedExpression_(),
-        hasBrackets_(hasBrackets), isValidated_(isSubexpression),
-        isParsed_(false), isTokenized_(true), isCalculated_(false),
-        isAtomic_(false), showCalculation_(showCalculation),
-        isSubexpression_(isSubexpression), result_(0.0), tokens_(tokens),
-        outerStep_() {
-    if (tokens.tokens.size() == 1) {
-      if (tokens.tokens[0].isCalculated_) {
-        isCalculated_ = true;
-        result_ = tokens.tokens[0].result_;
-      } else {
-        throw std::runtime_error(
-            "Cannot initialize expressions using TokenizedExpression with only "
-            "one uncalculated token.");
-      }
-    }
-    if (showCalculation)
-      std::cout << "Expression instantiated: " << expression() << std::endl;
-  }
-  explicit Expression(double result, bool isSubexpression = true,
-                      bool hasBrackets = false)
-      : precision(3), expression_(), trimmedExpression_(),
-        hasBrackets_(hasBrackets), isValidated_(true), isParsed_(true),
-        isTokenized_(true), isCalculated_(true), isAtomic_(true),
-        showCalculation_(false), isSubexpression_(isSubexpression),
-        result_(result), tokens_(), outerStep_() {}
+  explicit Expression(double result)
+      : precision(3), expression_(), trimmedExpression_(), isValidated_(true),
+        isParsed_(true), isOptimized_(true), isCalculated_(true),
+        isAtomic_(true), showCalculation_(false), result_(result),
+        nodes_{{.result = result, .isCalculated = true}}, operands_(),
+        outerStep_(0), variables_(), variableValues_(), isLinked_(false),
+        parentOffsets_(), parents_(), leafOffsets_(), leaves_(), cache_(),
+        fastFunctions_() {}
 
   // Public methods
 
   /// The string form of this mathematical Expression
-  std::string expression();
+  const std::string &expression();
   /// Reset the Expression with a new mathematical Expression
   void set_expression(const std::string &expression);
   /// Set a new expression and calculate the result()
@@ -130,9 +137,27 @@ public:
   bool isAtomic();
   /// Whether or not input expression string was validated
   bool isValidated() { return isValidated_; }
+  /// Names of the variables in the expression, in order of first appearance
+  const std::vector<std::string> &variables();
+  /// Bind a value to a variable, which is kept if the expression is reset.
+  /// Only the Nodes depending on the variable are calculated again, so the
+  /// next result() recalculates the paths from its leaves to the root.
+  void set_variable(std::string_view name, double value);
+  /// Look results up in, and add them to, a cache shared with other
+  /// Expressions, or stop using a cache if cache is nullptr
+  void set_cache(std::shared_ptr<ResultCache> cache) {
+    cache_ = std::move(cache);
+  }
+  /// Calculate functions with the cheapest FastMath kernels keeping precision
+  /// significant digits, or with the std:: functions for
+  /// FastMath::fullPrecision, the default. Results already calculated are
+  /// calculated again. Only Expressions calculating functions the same way
+  /// should share a ResultCache.
+  void set_fast_math(int precision);
 
   // Public variables
-  /// Number of digits to show after decimal in scientific notation
+  /// Number of significant digits to show, or OutputBuffer::shortest for
+  /// the shortest form which reads back exactly
   int precision;
 
 private:
@@ -142,59 +167,72 @@ private:
   static const std::unordered_map<std::string_view, Operator> operators_;
   /// Correspondence between Operator objects and their string form
   static const std::unordered_map<Operator, std::string_view> operatorStrings_;
-  /// RegEx pattern for validating a string as a mathematical expression
-  static const std::regex exprPattern_;
-  /// RegEx pattern matching an integer or real number
-  static const std::regex numPattern_;
-  /// RegEx pattern for matching a string beginning with a number
-  static const std::regex numToken_;
-  /// RegEx pattern for matching a string beginning with a function call
-  static const std::regex funcToken_;
 
   // Private methods
 
-  /// Calculate each lowest-level uncalculated subexpression
-  void calculateNextStep_();
-  /// Print Expression substituting calculated subexpressions with their result
-  void printPartialCalculation_();
-  /// Whether all immediate child expressions have been calculated
-  bool subexpressionsCalculated_();
-  /// Translates a number in string form into a double for calculation
-  static double parsedNumber_(const std::string &numStr);
+  /// Calculate each lowest-level uncalculated subexpression below a Node
+  void calculateNextStep_(size_t node);
+  /// Print a Node substituting calculated subexpressions with their result
+  void printPartialCalculation_(OutputBuffer &output, size_t node) const;
+  /// Append the string form of a Node to a string
+  void appendExpression_(std::string &str, size_t node) const;
+  /// Whether all immediate operands of a Node have been calculated
+  bool subexpressionsCalculated_(size_t node) const;
   /// Parse the expression into tokens and determine the first calculation step
   void parse_();
-  /// Parse an expression into token Expressions and operators for calculation
-  void tokenizeExpression_(bool showCalculation = false);
-  /// Determine the last calculation step according to BEDMAS, for recursive
-  /// evaluation
-  static Step lastCalculationStep_(TokenizedExpression &tokens);
-  /// Merge tokens and operations back into a single Expression
-  static Expression combinedTokens_(TokenizedExpression &tokens,
-                                    const size_t &startInd,
-                                    const size_t &stopInd,
-                                    bool showCalculation = false);
+  /// Split the expression into tokens, making implicit multiplications and
+  /// leading signs explicit
+  std::vector<Lexer::Token> tokenizeExpression_();
+  /// Determine the last calculation step according to BEDMAS, building the
+  /// tree of Nodes calculated before it along the way
+  size_t lastCalculationStep_(const std::vector<Lexer::Token> &tokens);
+  /// Parse tokens joined by binary operators of at least the given priority.
+  /// Operands of unfinished Nodes wait in pending until their Node is built.
+  size_t parseOperation_(const std::vector<Lexer::Token> &tokens,
+                         size_t &index, int priority,
+                         std::vector<Operand> &pending);
+  /// Parse a number, variable, bracketed subexpression or function call
+  size_t parseOperand_(const std::vector<Lexer::Token> &tokens, size_t &index,
+                       std::vector<Operand> &pending);
+  /// Store a new Node in the tree and return its index
+  size_t addNode_(const Node &node);
+  /// Number of Nodes from a Node down to its deepest leaf, inclusive
+  size_t depth_(size_t node) const;
+  /// Record the parents of every Node and the leaves of every variable
+  void linkParents_();
+  /// Mark every calculated ancestor of a Node as uncalculated
+  void invalidateAncestors_(size_t node);
+  /// Index in variables_ of a variable name, adding it if it is new
+  size_t variableIndex_(std::string_view name);
+  /// Priority of a binary Operator in BEDMAS, from 1 (+ -) to 3 (^)
+  static int priority_(Operator oper);
   /// Find the ')' parenthesis character index matching a beginning '('
   static size_t closingBracketIndex_(const std::string &str,
                                      const bool includeFrontBracket = false);
-  /// Calculate a mathematical operation bundled as a Step object
-  static double calculate_(Step &step);
+  /// Calculate a Node of the tree, and any of its uncalculated operands
+  double calculate_(size_t node);
   /// Calculate a unary mathematical Operator on a number
   static double calculate_(const Operator &oper, const double operand);
   /// Calculate a binary mathematical Operator acting on two numbers
   static double calculate_(const Operator &oper, const double leftOperand,
                            const double rightOperand);
-  /// Warn if an input number is not a number
+  /// Calculate a binary mathematical Operator acting on two Numbers, with
+  /// integer arithmetic if both are integers
+  static Number calculate_(const Operator &oper, const Number leftOperand,
+                           const Number rightOperand);
+  /// The value of a calculated Node
+  static Number number_(const Node &node) {
+    return {node.result, node.integer, node.isInteger};
+  }
+  /// Warn if a result is not a number. Only result() warns, once per
+  /// expression, so evaluating compiled programs never writes to std::cerr.
   static void checkNaN_(double num) {
     if (std::isnan(num))
-      std::cout << "Warning: num is NaN." << '\n';
+      std::cerr << "Warning: num is NaN." << '\n';
   }
   /// Generate the Operator-string map
   static const std::unordered_map<Operator, std::string_view>
   constructOperatorStrings_();
-  /// Return a string with all special RegEx characters escaped
-  static const std::string escapeRegex_(std::string_view str);
-  /// Construct the RegEx pattern for validating expressions
-  static const std::regex constructExprPattern_();
 
   // Private variables
 
@@ -202,17 +240,37 @@ private:
   std::string expression_;
   /// String form of this Expression with whitespace and outer brackets removed
   std::string trimmedExpression_;
-  bool hasBrackets_;     /// Whether (sub)expression is wrapped in parentheses
   bool isValidated_;     /// Whether the Expression string has been validated
   bool isParsed_;        /// Whether the Expression string has been parsed fully
-  bool isTokenized_;     /// Whether the Expression string has been tokenized
+  bool isOptimized_;     /// Whether the parsed tree has been simplified
   bool isCalculated_;    /// Whether the result of the Expression is calculated
   bool isAtomic_;        /// Whether the expression is just a number or compound
   bool showCalculation_; /// Whether to show verbose output of calculations
-  bool isSubexpression_; /// Whether Expression is subexpression to a parent
   double result_;        /// Result of the mathematical expression
-  /// Expression broken down into sub-Expressions and Operators
-  TokenizedExpression tokens_;
-  /// Last calculation step to perform on Expression re: BEDMAS
-  Step outerStep_;
+  /// Every subexpression of the parsed tree
+  std::vector<Node> nodes_;
+  /// Operands of every Node, each Node's operands stored contiguously
+  std::vector<Operand> operands_;
+  /// Index of the Node for the last calculation step to perform re: BEDMAS
+  size_t outerStep_;
+  /// Variable names, in order of first appearance in the expression
+  std::vector<std::string> variables_;
+  /// Value bound to each variable, if any
+  std::vector<std::optional<double>> variableValues_;
+  /// Whether the links below describe the current tree. Rebuilt lazily, as
+  /// parsing and optimizing replace the Nodes.
+  bool isLinked_;
+  /// Parents of each Node, those of Node i being parents_[parentOffsets_[i]]
+  /// up to parents_[parentOffsets_[i + 1]]. Nodes shared by the Optimizer
+  /// have several parents.
+  std::vector<size_t> parentOffsets_;
+  std::vector<size_t> parents_;
+  /// Leaf Nodes of each variable, indexed like parents_
+  std::vector<size_t> leafOffsets_;
+  std::vector<size_t> leaves_;
+  /// Cache of results of other Expressions with the same trimmed form
+  std::shared_ptr<ResultCache> cache_;
+  /// Kernels calculating functions by Operator, or none for the std::
+  /// functions
+  std::span<const FastMath::Function> fastFunctions_;
 };
@@ -0,0 +1,325 @@
+// Internal headers
+#include "FastMath.h"
+
+// Standard library
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+// Namespaces
+using namespace std::string_literals;
+
+// ----------------------------------------------------------------------------
+// Series
+// ----------------------------------------------------------------------------
+
+/// Number of series terms of the exp, sin and cos, and small sinh kernels of
+/// each tier, from the cheapest to the most accurate
+static constexpr std::array<size_t, 3> expTerms{6, 9, 12};
+static constexpr std::array<size_t, 3> trigTerms{4, 6, 8};
+static constexpr std::array<size_t, 3> sinhTerms{4, 6, 8};
+
+/// Coefficients 1/k! for k = first, first + 2 or first + 1, ..., with
+/// alternating signs if isAlternating
+template <size_t numTerms>
+static consteval std::array<double, numTerms>
+factorialSeries(int first, int step, bool isAlternating) {
+  std::array<double, numTerms> coefficients{};
+  double factorial{1.0};
+  int k{0};
+  for (size_t i{0}; i < numTerms; ++i) {
+    for (int end{first + static_cast<int>(i) * step}; k < end;)
+      factorial *= ++k;
+    coefficients[i] = (isAlternating && i % 2 == 1 ? -1.0 : 1.0) / factorial;
+  }
+  return coefficients;
+}
+
+template <size_t tier>
+static constexpr auto expSeries{
+    factorialSeries<expTerms[tier]>(0, 1, false)};
+template <size_t tier>
+static constexpr auto sinSeries{
+    factorialSeries<trigTerms[tier]>(1, 2, true)};
+template <size_t tier>
+static constexpr auto cosSeries{
+    factorialSeries<trigTerms[tier]>(0, 2, true)};
+template <size_t tier>
+static constexpr auto sinhSeries{
+    factorialSeries<sinhTerms[tier]>(1, 2, false)};
+
+/// Value of a polynomial at x by Horner's rule, lowest coefficient first,
+/// unrolled into straight-line code
+template <size_t numTerms>
+static double horner(const std::array<double, numTerms> &coefficients,
+                     double x) {
+  return [&]<size_t... i>(std::index_sequence<i...>) {
+    double result{coefficients[numTerms - 1]};
+    ((result = result * x + coefficients[numTerms - 2 - i]), ...);
+    return result;
+  }(std::make_index_sequence<numTerms - 1>());
+}
+
+// ----------------------------------------------------------------------------
+// Kernels
+// ----------------------------------------------------------------------------
+
+/// Adding and subtracting 1.5 x 2^52 rounds a double below 2^51 to an integer
+static constexpr double roundingShift{0x1.8p52};
+/// ln(2) split so that its first part times any exponent is exact
+static constexpr double ln2High{6.93147180369123816490e-01};
+static constexpr double ln2Low{1.90821492927058770002e-10};
+static constexpr double log2e{1.44269504088896338700e+00};
+static constexpr double log10e{4.34294481903251827651e-01};
+/// pi/2 split into three 33-bit parts, so that their products with any
+/// quadrant count below 2^20 are exact, and the rest
+static constexpr double twoOverPi{6.36619772367581382433e-01};
+static constexpr double halfPi1{1.57079632673412561417e+00};
+static constexpr double halfPi2{6.07710050630396597660e-11};
+static constexpr double halfPi3{2.02226624871116645580e-21};
+static constexpr double halfPi4{8.47842766036889956997e-32};
+/// Largest arguments the kernels reduce accurately
+static constexpr double maxExpArgument{708.0};
+static constexpr double maxTrigArgument{0x1p19};
+
+/// e^x = 2^k e^r with |r| <= ln(2)/2
+template <size_t tier> static double exp_(double x) {
+  // Results which overflow or are subnormal, and NaN, fail this test
+  if (!(std::abs(x) < maxExpArgument))
+    return std::exp(x);
+  double k{(x * log2e + roundingShift) - roundingShift};
+  double r{(x - k * ln2High) - k * ln2Low};
+  double scale{std::bit_cast<double>(
+      static_cast<std::uint64_t>(static_cast<std::int64_t>(k) + 1023) << 52)};
+  return horner(expSeries<tier>, r) * scale;
+}
+
+/// x = r + k pi/2 with |r| <= pi/4, where the last two bits of k pick the
+/// quadrant
+struct Reduced {
+  double r;
+  unsigned quadrant;
+};
+
+static Reduced reduce(double x) {
+  double k{(x * twoOverPi + roundingShift) - roundingShift};
+  // Each subtraction is exact while r is much smaller than its operands, so
+  // r keeps its relative accuracy for x next to a multiple of pi/2
+  double r{(((x - k * halfPi1) - k * halfPi2) - k * halfPi3) - k * halfPi4};
+  return {r, static_cast<unsigned>(static_cast<std::int64_t>(k)) & 3u};
+}
+
+template <size_t tier> static double sinSeries_(double r) {
+  return r * horner(sinSeries<tier>, r * r);
+}
+
+template <size_t tier> static double cosSeries_(double r) {
+  return horner(cosSeries<tier>, r * r);
+}
+
+/// Negate a value if bit 1 of a quadrant count is set, without branching on
+/// a quadrant which is effectively random
+static double negateIf(double value, unsigned quadrant) {
+  return std::bit_cast<double>(std::bit_cast<std::uint64_t>(value) ^
+                               std::uint64_t{quadrant & 2u} << 62);
+}
+
+template <size_t tier> static double sin_(double x) {
+  if (!(std::abs(x) < maxTrigArgument))
+    return std::sin(x);
+  auto [r, quadrant]{reduce(x)};
+  // Both series are cheaper than mispredicting which one is needed
+  double sine{sinSeries_<tier>(r)};
+  double cosine{cosSeries_<tier>(r)};
+  return negateIf(quadrant & 1 ? cosine : sine, quadrant);
+}
+
+template <size_t tier> static double cos_(double x) {
+  if (!(std::abs(x) < maxTrigArgument))
+    return std::cos(x);
+  auto [r, quadrant]{reduce(x)};
+  double sine{sinSeries_<tier>(r)};
+  double cosine{cosSeries_<tier>(r)};
+  return negateIf(quadrant & 1 ? sine : cosine, quadrant + 1);
+}
+
+template <size_t tier> static double tan_(double x) {
+  if (!(std::abs(x) < maxTrigArgument))
+    return std::tan(x);
+  auto [r, quadrant]{reduce(x)};
+  double sine{sinSeries_<tier>(r)};
+  double cosine{cosSeries_<tier>(r)};
+  return quadrant & 1 ? -cosine / sine : sine / cosine;
+}
+
+/// sinh(x) by its series for |x| < 1, where (e^x - e^-x)/2 would cancel
+template <size_t tier> static double sinh_(double x) {
+  double a{std::abs(x)};
+  if (a < 1.0)
+    return x * horner(sinhSeries<tier>, x * x);
+  if (!(a < maxExpArgument))
+    return std::sinh(x);
+  double e{exp_<tier>(a)};
+  return std::copysign(0.5 * e - 0.5 / e, x);
+}
+
+template <size_t tier> static double cosh_(double x) {
+  double a{std::abs(x)};
+  if (!(a < maxExpArgument))
+    return std::cosh(x);
+  double e{exp_<tier>(a)};
+  return 0.5 * e + 0.5 / e;
+}
+
+/// tanh(x) = 1 - 2/(e^2x + 1) for |x| >= 1, which rounds to 1 beyond 20
+template <size_t tier> static double tanh_(double x) {
+  double a{std::abs(x)};
+  if (a < 1.0)
+    return sinh_<tier>(x) / cosh_<tier>(x);
+  if (a > 20.0)
+    return std::copysign(1.0, x);
+  return std::copysign(1.0 - 2.0 / (exp_<tier>(2.0 * a) + 1.0), x);
+}
+
+/// log10(x) as ln(x) / ln(10), since glibc's table-driven log is much cheaper
+/// than its log10
+static double lnLog10(double x) { return std::log(x) * log10e; }
+
+static double stdExp(double x) { return std::exp(x); }
+static double stdSqrt(double x) { return std::sqrt(x); }
+static double stdLog(double x) { return std::log(x); }
+static double stdLog10(double x) { return std::log10(x); }
+static double stdSin(double x) { return std::sin(x); }
+static double stdCos(double x) { return std::cos(x); }
+static double stdTan(double x) { return std::tan(x); }
+static double stdSinh(double x) { return std::sinh(x); }
+static double stdCosh(double x) { return std::cosh(x); }
+static double stdTanh(double x) { return std::tanh(x); }
+
+/// Largest error of the std:: functions themselves, which glibc documents
+static constexpr double stdMaxUlps{2.0};
+
+// ----------------------------------------------------------------------------
+// Kernel tables
+// ----------------------------------------------------------------------------
+using Kernel = FastMath::Kernel;
+
+// Kernels are only listed while cheaper than the std:: function. The largest
+// errors measured over millions of arguments, including those next to each
+// reduction boundary, are about two thirds of these bounds. The first tier
+// keeps at least 3 significant digits, the second 7 and the third 12.
+
+static constexpr Kernel expKernels[]{{"exp/1", exp_<0>, 3e10},
+                                     {"exp/2", exp_<1>, 2.5e6},
+                                     {"std::exp", stdExp, stdMaxUlps}};
+// std::sqrt is a single, correctly rounded, instruction, and glibc's log
+// is cheaper than any series without a table
+static constexpr Kernel sqrtKernels[]{{"std::sqrt", stdSqrt, 0.5}};
+static constexpr Kernel logKernels[]{{"std::log", stdLog, stdMaxUlps}};
+static constexpr Kernel log10Kernels[]{{"ln*log10e", lnLog10, 4.0},
+                                       {"std::log10", stdLog10, stdMaxUlps}};
+static constexpr Kernel sinKernels[]{{"sin/1", sin_<0>, 5e10},
+                                     {"sin/2", sin_<1>, 1.5e6},
+                                     {"sin/3", sin_<2>, 16.0},
+                                     {"std::sin", stdSin, stdMaxUlps}};
+static constexpr Kernel cosKernels[]{{"cos/1", cos_<0>, 5e10},
+                                     {"cos/2", cos_<1>, 1.5e6},
+                                     {"cos/3", cos_<2>, 16.0},
+                                     {"std::cos", stdCos, stdMaxUlps}};
+static constexpr Kernel tanKernels[]{{"tan/1", tan_<0>, 6e10},
+                                     {"tan/2", tan_<1>, 2e6},
+                                     {"tan/3", tan_<2>, 24.0},
+                                     {"std::tan", stdTan, stdMaxUlps}};
+static constexpr Kernel sinhKernels[]{{"sinh/1", sinh_<0>, 3.5e10},
+                                      {"sinh/2", sinh_<1>, 3e6},
+                                      {"sinh/3", sinh_<2>, 96.0},
+                                      {"std::sinh", stdSinh, stdMaxUlps}};
+static constexpr Kernel coshKernels[]{{"cosh/1", cosh_<0>, 3e10},
+                                      {"cosh/2", cosh_<1>, 2.5e6},
+                                      {"std::cosh", stdCosh, stdMaxUlps}};
+static constexpr Kernel tanhKernels[]{{"tanh/1", tanh_<0>, 2e10},
+                                      {"tanh/2", tanh_<1>, 1e6},
+                                      {"tanh/3", tanh_<2>, 32.0},
+                                      {"std::tanh", stdTanh, stdMaxUlps}};
+
+/// Most significant digits any kernel cheaper than a std:: function keeps
+static constexpr int maxFastPrecision{17};
+
+// ----------------------------------------------------------------------------
+// Public Methods
+// ----------------------------------------------------------------------------
+std::span<const Kernel> FastMath::kernels(Operator oper) {
+  switch (oper) {
+  case Operator::Exp:
+    return expKernels;
+  case Operator::Sqrt:
+    return sqrtKernels;
+  case Operator::Ln:
+    return logKernels;
+  case Operator::Log:
+    return log10Kernels;
+  case Operator::Sin:
+    return sinKernels;
+  case Operator::Cos:
+    return cosKernels;
+  case Operator::Tan:
+    return tanKernels;
+  case Operator::Sinh:
+    return sinhKernels;
+  case Operator::Cosh:
+    return coshKernels;
+  case Operator::Tanh:
+    return tanhKernels;
+  default:
+    throw std::runtime_error("Invalid operator given single operand.");
+  }
+}
+
+const Kernel &FastMath::select(Operator oper, int precision) {
+  std::span<const Kernel> candidates{kernels(oper)};
+  if (precision != fullPrecision) {
+    for (const Kernel &kernel : candidates) {
+      if (isAccurateTo(kernel.maxUlps, precision))
+        return kernel;
+    }
+  }
+  return candidates.back();
+}
+
+const FastMath::Functions &FastMath::functions(int precision) {
+  if (precision < fullPrecision)
+    throw std::runtime_error("Invalid precision "s +
+                             std::to_string(precision));
+  // Built once for every precision a fast kernel could satisfy
+  static const std::array<Functions, maxFastPrecision + 2> tables{[] {
+    std::array<Functions, maxFastPrecision + 2> built{};
+    for (int index{0}; index < static_cast<int>(built.size()); ++index) {
+      Functions &table{built[static_cast<size_t>(index)]};
+      table.fill(nullptr);
+      for (Operator oper : {Operator::Exp, Operator::Sqrt, Operator::Ln,
+                            Operator::Log, Operator::Sin, Operator::Cos,
+                            Operator::Tan, Operator::Sinh, Operator::Cosh,
+                            Operator::Tanh})
+        table[static_cast<size_t>(oper)] =
+            select(oper, index - 1).function;
+    }
+    return built;
+  }()};
+  // Index 0 holds the std:: functions for fullPrecision
+  if (precision > maxFastPrecision)
+    return tables[0];
+  return tables[static_cast<size_t>(precision + 1)];
+}
+
+bool FastMath::isAccurateTo(double maxUlps, int precision) {
+  if (precision == fullPrecision)
+    return false;
+  // An ULP is at most 2^-52 of a result, and half a unit of the digit after
+  // the last one shown is at least 5 x 10^-(precision + 2) of it
+  return maxUlps * 0x1p-52 <=
+         5.0 * std::pow(10.0, -static_cast<double>(precision + 2));
+}
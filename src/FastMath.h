@@ -0,0 +1,68 @@
+#pragma once
+
+// Internal headers
+#include "Operator.h"
+
+// Standard library
+#include <array>
+#include <cstddef>
+#include <span>
+#include <string_view>
+
+/******************************************************************************
+ * Cheaper implementations of the unary function Operators, accurate to fewer
+ * significant digits than the std:: functions.
+ *
+ * Each function has kernels of increasing cost and accuracy, ending with its
+ * std:: function, and only kernels cheaper than the std:: function are kept.
+ * A kernel reduces its argument to a small interval, using exact multiples of
+ * ln(2) or pi/2 split into several doubles, and evaluates a truncated series
+ * there by Horner's rule; sinh, cosh and tanh are built from the exp kernels.
+ * Arguments outside the range a kernel reduces accurately, and infinities,
+ * NaNs and subnormals, go to the std:: function. sqrt is one instruction and
+ * glibc's ln is table-driven, so neither has a cheaper kernel, while log10 is
+ * cheaper as ln(x) log10(e).
+ *
+ * Every kernel documents the largest error of its results in units in the
+ * last place (ULPs) of the correctly rounded result. The bounds follow from
+ * the truncation error of the series plus a few roundings, and the test suite
+ * checks them against the std:: functions over each function's domain.
+ * select() picks the cheapest kernel whose bound still leaves a requested
+ * number of significant digits intact with one digit to spare. Like any
+ * rounding error, a kernel's error can be amplified by the operations applied
+ * to its result, such as subtracting nearly equal numbers.
+ *****************************************************************************/
+class FastMath {
+public:
+  // Types
+  using Function = double (*)(double);
+  /// Functions indexed by their Operator
+  using Functions =
+      std::array<Function, static_cast<size_t>(Operator::Tanh) + 1>;
+
+  // Structs
+  struct Kernel {
+    std::string_view name{};
+    Function function{nullptr};
+    double maxUlps{0.0}; /// Largest error in units in the last place
+  };
+
+  // Public constants
+
+  /// Precision asking for the std:: functions' full accuracy
+  static constexpr int fullPrecision{-1};
+
+  // Public methods
+
+  /// Kernels of a unary function Operator, cheapest first, ending with the
+  /// std:: function
+  static std::span<const Kernel> kernels(Operator oper);
+  /// Cheapest kernel of a unary function Operator accurate to precision
+  /// significant digits, or the std:: function for fullPrecision
+  static const Kernel &select(Operator oper, int precision);
+  /// The kernel select() picks for every unary function Operator
+  static const Functions &functions(int precision);
+  /// Whether an error of maxUlps keeps precision significant digits, plus
+  /// one spare digit, of any result
+  static bool isAccurateTo(double maxUlps, int precision);
+};
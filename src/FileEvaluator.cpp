@@ -0,0 +1,83 @@
+// Internal headers
+#include "FileEvaluator.h"
+#include "MappedFile.h"
+#include "StreamEvaluator.h"
+#include "ThreadPool.h"
+
+// Standard library
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <utility>
+
+// ----------------------------------------------------------------------------
+// Public Methods
+// ----------------------------------------------------------------------------
+size_t FileEvaluator::run(const std::string &path) {
+  MappedFile file(path);
+  std::vector<std::string_view> chunks{
+      splitChunks(file.contents(), chunkSize_)};
+  struct ChunkResult {
+    std::string output{};
+    size_t numErrors{0};
+    std::exception_ptr error{};
+    std::atomic<bool> isDone{false};
+  };
+  std::vector<ChunkResult> results(chunks.size());
+  ThreadPool pool(numThreads_);
+  auto submitChunk{[this, &pool, &chunks, &results](size_t chunk) {
+    pool.submit([this, text = chunks[chunk], &result = results[chunk]]() {
+      try {
+        StreamEvaluator evaluator(OutputBuffer(), precision_, cache_);
+        evaluator.set_fast_math(fastMath_);
+        evaluator.set_scalar_type(scalarType_);
+        for (std::string_view rest{text}; !rest.empty();) {
+          size_t end{std::min(rest.find('\n'), rest.size())};
+          if (!evaluator.evaluateLine(rest.substr(0, end)))
+            ++result.numErrors;
+          rest.remove_prefix(std::min(end + 1, rest.size()));
+        }
+        result.output = evaluator.output().take();
+      } catch (...) {
+        result.error = std::current_exception();
+      }
+      result.isDone.store(true, std::memory_order_release);
+      result.isDone.notify_one();
+    });
+  }};
+
+  size_t maxInFlight{pool.size() * chunksInFlightPerThread_};
+  size_t numSubmitted{0};
+  size_t numErrors{0};
+  for (size_t chunk{0}; chunk < chunks.size(); ++chunk) {
+    while (numSubmitted < chunks.size() && numSubmitted < chunk + maxInFlight)
+      submitChunk(numSubmitted++);
+    ChunkResult &result{results[chunk]};
+    result.isDone.wait(false, std::memory_order_acquire);
+    // The pool finishes the chunks in flight before their results go away
+    if (result.error)
+      std::rethrow_exception(result.error);
+    output_ << result.output;
+    numErrors += result.numErrors;
+    // Release the buffer now rather than when the whole file is done
+    std::string().swap(result.output);
+  }
+  pool.wait();
+  output_.flush();
+  return numErrors;
+}
+
+std::vector<std::string_view>
+FileEvaluator::splitChunks(std::string_view text, size_t chunkSize) {
+  std::vector<std::string_view> chunks;
+  chunks.reserve(text.size() / std::max(chunkSize, size_t{1}) + 1);
+  while (!text.empty()) {
+    // Extend each chunk to the end of the line it would otherwise split
+    size_t minimumEnd{std::clamp(chunkSize, size_t{1}, text.size())};
+    size_t end{text.find('\n', minimumEnd - 1)};
+    end = end == std::string_view::npos ? text.size() : end + 1;
+    chunks.push_back(text.substr(0, end));
+    text.remove_prefix(end);
+  }
+  return chunks;
+}
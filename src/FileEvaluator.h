@@ -0,0 +1,74 @@
+#pragma once
+
+// Internal headers
+#include "CompiledExpression.h"
+
+// Standard library
+#include <cstddef>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+class ResultCache;
+
+/******************************************************************************
+ * Evaluates a file of newline-delimited expressions on several threads.
+ *
+ * The file is memory-mapped and split into chunks of whole lines, which are
+ * evaluated in parallel on a ThreadPool, each with its own StreamEvaluator
+ * writing to its own buffer. Buffers are written to the output in input
+ * order, so the output is exactly what StreamEvaluator would print for the
+ * same lines on a single thread. Only a few chunks per thread are in flight at
+ * once, which bounds memory use however large the file is.
+ *****************************************************************************/
+class FileEvaluator {
+public:
+  // Constructors
+  FileEvaluator(std::ostream &output, size_t numThreads, int precision = 6,
+                size_t chunkSize = defaultChunkSize)
+      : output_(output), numThreads_(numThreads), precision_(precision),
+        chunkSize_(chunkSize), cache_(), fastMath_(false),
+        scalarType_(ScalarType::Double) {}
+
+  // Public constants
+
+  /// Approximate number of bytes of input evaluated by each task
+  static constexpr size_t defaultChunkSize{size_t{1} << 18};
+
+  // Public methods
+
+  /// Share a cache of results between every thread, or stop using a cache
+  /// if cache is nullptr
+  void set_cache(std::shared_ptr<ResultCache> cache) {
+    cache_ = std::move(cache);
+  }
+  /// Calculate functions as StreamEvaluator::set_fast_math() does
+  void set_fast_math(bool fastMath) { fastMath_ = fastMath; }
+  /// Calculate in a type as StreamEvaluator::set_scalar_type() does
+  void set_scalar_type(ScalarType scalarType) { scalarType_ = scalarType; }
+  /// Evaluate every line of a file, returning the number of lines whose
+  /// expression could not be calculated
+  size_t run(const std::string &path);
+  /// Split text into chunks of roughly chunkSize bytes, each ending with a
+  /// complete line
+  static std::vector<std::string_view> splitChunks(std::string_view text,
+                                                   size_t chunkSize);
+
+private:
+  // Private constants
+
+  /// Chunks per thread which may be evaluated ahead of the output
+  static constexpr size_t chunksInFlightPerThread_{4};
+
+  // Private variables
+  std::ostream &output_; /// Destination of one result line per input line
+  size_t numThreads_;    /// Number of threads evaluating chunks
+  int precision_;        /// Number of significant digits in results
+  size_t chunkSize_;     /// Approximate number of bytes in each chunk
+  std::shared_ptr<ResultCache> cache_; /// Results shared by all threads
+  bool fastMath_; /// Whether functions use FastMath kernels
+  ScalarType scalarType_; /// Type results are calculated in
+};
@@ -0,0 +1,229 @@
+// Internal headers
+#include "JitExpression.h"
+
+// Standard library
+#include <bit>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+// POSIX
+#include <sys/mman.h>
+#include <unistd.h>
+
+// ----------------------------------------------------------------------------
+// Machine code encoding
+//
+// Only the handful of x86-64 instructions the translation needs are encoded.
+// The VM stack and temporaries are addressed as [rsp + disp32], and variable
+// values as [rbx + disp32], rbx holding the bindings pointer across calls.
+// ----------------------------------------------------------------------------
+using Code = std::vector<std::uint8_t>;
+
+static void emitBytes(Code &code, std::initializer_list<std::uint8_t> bytes) {
+  // One push_back per byte, as GCC 12 reports a false -Wstringop-overflow for
+  // a range insert inlined into generate_()
+  for (std::uint8_t byte : bytes)
+    code.push_back(byte);
+}
+
+static void emitImmediate32(Code &code, std::uint32_t value) {
+  for (int shift{0}; shift < 32; shift += 8)
+    code.push_back(static_cast<std::uint8_t>(value >> shift));
+}
+
+static void emitImmediate64(Code &code, std::uint64_t value) {
+  for (int shift{0}; shift < 64; shift += 8)
+    code.push_back(static_cast<std::uint8_t>(value >> shift));
+}
+
+/// movsd xmm0, [rsp + 8 * slot]
+static void loadSlot(Code &code, size_t slot) {
+  emitBytes(code, {0xF2, 0x0F, 0x10, 0x84, 0x24});
+  emitImmediate32(code, static_cast<std::uint32_t>(8 * slot));
+}
+
+/// movsd [rsp + 8 * slot], xmm0
+static void storeSlot(Code &code, size_t slot) {
+  emitBytes(code, {0xF2, 0x0F, 0x11, 0x84, 0x24});
+  emitImmediate32(code, static_cast<std::uint32_t>(8 * slot));
+}
+
+/// movsd xmm0, [rbx + 8 * variable]
+static void loadVariable(Code &code, size_t variable) {
+  emitBytes(code, {0xF2, 0x0F, 0x10, 0x83});
+  emitImmediate32(code, static_cast<std::uint32_t>(8 * variable));
+}
+
+/// movabs rax, value; movq xmm0, rax
+static void loadConstant(Code &code, double value) {
+  emitBytes(code, {0x48, 0xB8});
+  emitImmediate64(code, std::bit_cast<std::uint64_t>(value));
+  emitBytes(code, {0x66, 0x48, 0x0F, 0x6E, 0xC0});
+}
+
+/// movabs rax, function; call rax
+static void callFunction(Code &code, const void *function) {
+  emitBytes(code, {0x48, 0xB8});
+  emitImmediate64(code, reinterpret_cast<std::uintptr_t>(function));
+  emitBytes(code, {0xFF, 0xD0});
+}
+
+// ----------------------------------------------------------------------------
+// Constructors
+// ----------------------------------------------------------------------------
+JitExpression::JitExpression(CompiledExpression compiled)
+    : compiled_(std::move(compiled)), page_(nullptr), pageSize_(0),
+      function_(nullptr) {
+  if constexpr (isSupported)
+    install_(generate_());
+}
+
+JitExpression::JitExpression(JitExpression &&other) noexcept
+    : compiled_(std::move(other.compiled_)),
+      page_(std::exchange(other.page_, nullptr)),
+      pageSize_(std::exchange(other.pageSize_, 0)),
+      function_(std::exchange(other.function_, nullptr)) {}
+
+JitExpression &JitExpression::operator=(JitExpression &&other) noexcept {
+  if (this != &other) {
+    release_();
+    compiled_ = std::move(other.compiled_);
+    page_ = std::exchange(other.page_, nullptr);
+    pageSize_ = std::exchange(other.pageSize_, 0);
+    function_ = std::exchange(other.function_, nullptr);
+  }
+  return *this;
+}
+
+JitExpression::~JitExpression() { release_(); }
+
+// ----------------------------------------------------------------------------
+// Public Methods
+// ----------------------------------------------------------------------------
+double JitExpression::evaluate(std::span<const double> bindings) const {
+  if (function_ == nullptr)
+    return compiled_.evaluate(bindings);
+  if (bindings.size() < variables().size())
+    throw std::runtime_error("Compiled expression needs " +
+                             std::to_string(variables().size()) +
+                             " variable values but was given " +
+                             std::to_string(bindings.size()) + ".");
+  return function_(bindings.data());
+}
+
+// ----------------------------------------------------------------------------
+// Private Methods
+// ----------------------------------------------------------------------------
+std::vector<std::uint8_t> JitExpression::generate_() const {
+  using OpCode = CompiledExpression::OpCode;
+  using Operator = Expression::Operator;
+  // Stack entries below the top are kept in slots 0 to maxStackDepth - 1,
+  // followed by the temporaries
+  size_t firstTemporary{compiled_.maxStackDepth()};
+  size_t frameSize{8 * (firstTemporary + compiled_.numTemporaries())};
+  // rsp is 16-byte aligned after pushing rbx, and must stay so for calls
+  frameSize = (frameSize + 15) / 16 * 16;
+
+  Code code;
+  code.reserve(32 + 24 * compiled_.instructions().size());
+  // push rbx; mov rbx, rdi; sub rsp, frameSize
+  emitBytes(code, {0x53, 0x48, 0x89, 0xFB, 0x48, 0x81, 0xEC});
+  emitImmediate32(code, static_cast<std::uint32_t>(frameSize));
+
+  // Number of values on the VM stack, the top one being in xmm0
+  size_t depth{0};
+  auto push{[&code, &depth] {
+    if (depth > 0)
+      storeSlot(code, depth - 1);
+    ++depth;
+  }};
+  for (const CompiledExpression::Instruction &instruction :
+       compiled_.instructions()) {
+    switch (instruction.code) {
+    case OpCode::PushConstant:
+      push();
+      loadConstant(code, compiled_.constants()[instruction.index]);
+      break;
+    case OpCode::PushVariable:
+      push();
+      loadVariable(code, instruction.index);
+      break;
+    case OpCode::StoreTemporary:
+      storeSlot(code, firstTemporary + instruction.index);
+      break;
+    case OpCode::LoadTemporary:
+      push();
+      loadSlot(code, firstTemporary + instruction.index);
+      break;
+    case OpCode::UnaryOperation:
+      if (instruction.oper != Operator::None)
+        callFunction(code,
+                     reinterpret_cast<const void *>(dispatchUnary(
+                         instruction.oper, []<Operator oper>() {
+                           return &applyUnary<oper, double>;
+                         })));
+      break;
+    case OpCode::BinaryOperation:
+      // movapd xmm1, xmm0, then the left operand into xmm0
+      emitBytes(code, {0x66, 0x0F, 0x28, 0xC8});
+      loadSlot(code, depth - 2);
+      --depth;
+      switch (instruction.oper) {
+      case Operator::Plus:
+        emitBytes(code, {0xF2, 0x0F, 0x58, 0xC1}); // addsd xmm0, xmm1
+        break;
+      case Operator::Minus:
+        emitBytes(code, {0xF2, 0x0F, 0x5C, 0xC1}); // subsd xmm0, xmm1
+        break;
+      case Operator::Times:
+        emitBytes(code, {0xF2, 0x0F, 0x59, 0xC1}); // mulsd xmm0, xmm1
+        break;
+      case Operator::Divide:
+        emitBytes(code, {0xF2, 0x0F, 0x5E, 0xC1}); // divsd xmm0, xmm1
+        break;
+      default:
+        callFunction(code,
+                     reinterpret_cast<const void *>(dispatchBinary(
+                         instruction.oper, []<Operator oper>() {
+                           return &applyBinary<oper, double>;
+                         })));
+      }
+      break;
+    }
+  }
+
+  // add rsp, frameSize; pop rbx; ret
+  emitBytes(code, {0x48, 0x81, 0xC4});
+  emitImmediate32(code, static_cast<std::uint32_t>(frameSize));
+  emitBytes(code, {0x5B, 0xC3});
+  return code;
+}
+
+void JitExpression::install_(const std::vector<std::uint8_t> &code) {
+  size_t pageSize{static_cast<size_t>(::sysconf(_SC_PAGESIZE))};
+  size_t size{(code.size() + pageSize - 1) / pageSize * pageSize};
+  void *page{::mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)};
+  // Systems forbidding executable mappings keep the interpreter
+  if (page == MAP_FAILED)
+    return;
+  std::memcpy(page, code.data(), code.size());
+  // The page is never writable and executable at the same time
+  if (::mprotect(page, size, PROT_READ | PROT_EXEC) != 0) {
+    ::munmap(page, size);
+    return;
+  }
+  page_ = page;
+  pageSize_ = size;
+  function_ = reinterpret_cast<Function>(page);
+}
+
+void JitExpression::release_() {
+  if (page_ != nullptr)
+    ::munmap(page_, pageSize_);
+  page_ = nullptr;
+  pageSize_ = 0;
+  function_ = nullptr;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+// Internal headers
+#include "CompiledExpression.h"
+
+// Standard library
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+/******************************************************************************
+ * Native x86-64 machine code form of a CompiledExpression.
+ *
+ * The bytecode of a CompiledExpression is translated instruction by
+ * instruction into a function taking the array of variable values and
+ * returning the result, written into its own memory-mapped page which is then
+ * made executable. The top of the VM stack lives in register xmm0 and the rest
+ * of it, with the temporaries, in the function's stack frame. Arithmetic uses
+ * scalar SSE2 instructions, while ^, %, and the functions call the same
+ * applyBinary() and applyUnary() definitions the interpreter uses, so results
+ * are identical to CompiledExpression::evaluate() bit for bit.
+ *
+ * On other architectures, or if an executable page can't be mapped, no code is
+ * generated: function() is nullptr and evaluate() runs the interpreter.
+ *****************************************************************************/
+class JitExpression {
+public:
+  // Types
+
+  /// Signature of generated code, taking values for each of variables()
+  using Function = double (*)(const double *bindings);
+
+  // Public constants
+
+  /// Whether native code can be generated for this architecture
+#if defined(__x86_64__) && defined(__unix__)
+  static constexpr bool isSupported{true};
+#else
+  static constexpr bool isSupported{false};
+#endif
+
+  // Constructors
+  explicit JitExpression(CompiledExpression compiled);
+  explicit JitExpression(const std::string &expression)
+      : JitExpression(CompiledExpression(expression)) {}
+  JitExpression(JitExpression &&other) noexcept;
+  JitExpression &operator=(JitExpression &&other) noexcept;
+  JitExpression(const JitExpression &) = delete;
+  JitExpression &operator=(const JitExpression &) = delete;
+  ~JitExpression();
+
+  // Public methods
+
+  /// Evaluate the expression, with values for each of variables()
+  double evaluate(std::span<const double> bindings = {}) const;
+  /// The generated function, or nullptr if evaluate() uses the interpreter
+  Function function() const { return function_; }
+  /// Whether evaluate() runs generated machine code
+  bool isNative() const { return function_ != nullptr; }
+  /// Names of the variables bound by evaluate(), in binding order
+  const std::vector<std::string> &variables() const {
+    return compiled_.variables();
+  }
+  /// The bytecode the machine code was generated from
+  const CompiledExpression &compiled() const { return compiled_; }
+
+private:
+  // Private methods
+
+  /// Translate the bytecode into machine code
+  std::vector<std::uint8_t> generate_() const;
+  /// Copy machine code into a new executable page and point function_ to it
+  void install_(const std::vector<std::uint8_t> &code);
+  /// Unmap the page holding the generated code, if any
+  void release_();
+
+  // Private variables
+  CompiledExpression compiled_; /// Program translated, and run as fallback
+  void *page_;                  /// Mapping holding the generated code
+  size_t pageSize_;             /// Length of the mapping in bytes
+  Function function_;           /// Entry point of the generated code
+};
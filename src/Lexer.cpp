@@ -0,0 +1,213 @@
+// Internal headers
+#include "Lexer.h"
+#include "Calculus.h"
+#include "Expression.h"
+
+// Standard library
+#include <cctype>
+#include <charconv>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+
+// Namespaces
+using namespace std::string_literals;
+
+// ----------------------------------------------------------------------------
+// Public Methods
+// ----------------------------------------------------------------------------
+Lexer::Token Lexer::next() {
+  while (position_ < expression_.size() &&
+         std::isspace(static_cast<unsigned char>(expression_[position_])))
+    ++position_;
+  if (position_ == expression_.size()) {
+    if (afterFunction_)
+      fail_("function without argument");
+    if (depth_ != 0)
+      fail_("unmatched parentheses");
+    if (expectOperand_)
+      fail_(position_ == 0 ? "no operands"
+                           : "ends with a binary operator or sign");
+    return {.type = TokenType::End,
+            .oper = Operator::None,
+            .value = 0.0,
+            .text = expression_.substr(position_)};
+  }
+  char c{expression_[position_]};
+  if (afterFunction_ && c != '(')
+    fail_("function without argument");
+  Operator oper{binaryOperator_(c)};
+  bool isAfterNumber{afterNumber_};
+  afterNumber_ = false;
+
+  if (expectOperand_) {
+    if (isDigit_(c)) {
+      expectOperand_ = false;
+      atGroupStart_ = false;
+      afterNumber_ = true;
+      return number_();
+    }
+    if (c == '(') {
+      ++depth_;
+      atGroupStart_ = true;
+      afterFunction_ = false;
+      return advance_(TokenType::LeftBracket, 1);
+    }
+    if (isNameStart(c)) {
+      atGroupStart_ = false;
+      return name_();
+    }
+    if (atGroupStart_ && (oper == Operator::Plus || oper == Operator::Minus)) {
+      // Leading sign of the expression or of a bracketed subexpression
+      atGroupStart_ = false;
+      return advance_(TokenType::BinaryOperator, 1, oper);
+    }
+    if (oper != Operator::None)
+      fail_("contains binary operator "s + c + " with no left operand");
+    if (c == ')')
+      fail_("contains brackets or a binary operator with no right operand");
+    fail_("contains invalid character "s + c);
+  }
+
+  // An operator or closing bracket is expected
+  if (c == ')') {
+    if (depth_ == 0)
+      fail_("unmatched parentheses");
+    --depth_;
+    return advance_(TokenType::RightBracket, 1);
+  }
+  if (oper != Operator::None) {
+    expectOperand_ = true;
+    return advance_(TokenType::BinaryOperator, 1, oper);
+  }
+  if (isDigit_(c) && isAfterNumber) {
+    // Only whitespace can end a number before another digit, and reading
+    // "1 000" as 1 x 000 would silently change the result of a typo
+    fail_("contains two numbers without an operator");
+  }
+  if (isDigit_(c) || isNameStart(c) || c == '(') {
+    // Adjacent operands are implicitly multiplied
+    expectOperand_ = true;
+    return next();
+  }
+  fail_("contains invalid character "s + c);
+}
+
+// ----------------------------------------------------------------------------
+// Private Methods
+// ----------------------------------------------------------------------------
+Lexer::Token Lexer::number_() {
+  size_t end{position_};
+  while (end < expression_.size() && isDigit_(expression_[end]))
+    ++end;
+  bool isInteger{end == expression_.size() || expression_[end] != '.'};
+  if (!isInteger) {
+    ++end;
+    while (end < expression_.size() && isDigit_(expression_[end]))
+      ++end;
+  }
+  const char *first{expression_.data() + position_};
+  const char *last{expression_.data() + end};
+  Token token{advance_(TokenType::Number, end - position_)};
+  // Integers too large for an int64 are only known as doubles, while
+  // converting the others to the nearest double is a single instruction
+  if (isInteger) {
+    auto [ptr, errorCode]{std::from_chars(first, last, token.integer)};
+    token.isInteger = errorCode == std::errc() && ptr == last;
+    token.value = static_cast<double>(token.integer);
+  }
+  if (!token.isInteger) {
+    auto [ptr, errorCode]{std::from_chars(first, last, token.value)};
+    if (errorCode != std::errc() || ptr != last)
+      fail_("contains invalid number " + std::string(first, last));
+    token.integer = 0;
+  }
+  return token;
+}
+
+Lexer::Token Lexer::name_() {
+  size_t end{position_};
+  while (end < expression_.size() && isNameCharacter(expression_[end]))
+    ++end;
+  // The function e^() is spelled with Euler's number and a '^'
+  bool isEuler{end == position_ + 1 && expression_[position_] == 'e' &&
+               end < expression_.size() && expression_[end] == '^'};
+  size_t bracket{isEuler ? end + 1 : end};
+  while (bracket < expression_.size() &&
+         std::isspace(static_cast<unsigned char>(expression_[bracket])))
+    ++bracket;
+  bool isCall{bracket < expression_.size() && expression_[bracket] == '('};
+  if (isEuler && isCall)
+    ++end;
+  std::string_view name{expression_.substr(position_, end - position_)};
+  if (Calculus::isOperation(name)) {
+    if (!isCall)
+      fail_("contains function " + std::string(name) + " without argument");
+    return operation_(bracket);
+  }
+  auto match{Expression::operators_.find(name)};
+  // 'x' is the multiplication operator rather than a function
+  bool isFunction{match != Expression::operators_.end() &&
+                  match->second != Operator::None && name != "x"};
+  if (isFunction != isCall) {
+    // Names followed by brackets must be functions, and functions must be
+    // followed by their bracketed argument
+    fail_(isCall ? "contains unknown function " + std::string(name)
+                 : "contains function " + std::string(name) +
+                       " without argument");
+  }
+  if (!isFunction) {
+    expectOperand_ = false;
+    return advance_(TokenType::Variable, name.size());
+  }
+  afterFunction_ = true;
+  return advance_(TokenType::Function, name.size(), match->second);
+}
+
+Lexer::Token Lexer::operation_(size_t bracket) {
+  // Arguments are lexed when the operation is calculated, as they may contain
+  // commas and names of variables which aren't the expression's
+  size_t unclosed{0};
+  for (size_t end{bracket}; end < expression_.size(); ++end) {
+    if (expression_[end] == '(') {
+      ++unclosed;
+    } else if (expression_[end] == ')' && --unclosed == 0) {
+      expectOperand_ = false;
+      return advance_(TokenType::Operation, end + 1 - position_);
+    }
+  }
+  fail_("unmatched parentheses");
+}
+
+Lexer::Token Lexer::advance_(TokenType type, size_t length, Operator oper) {
+  Token token{.type = type,
+              .oper = oper,
+              .value = 0.0,
+              .text = expression_.substr(position_, length)};
+  position_ += length;
+  return token;
+}
+
+void Lexer::fail_(std::string_view reason) const {
+  throw std::runtime_error("Expression "s + std::string(expression_) +
+                           " is invalid: " + std::string(reason));
+}
+
+Operator Lexer::binaryOperator_(char c) {
+  switch (c) {
+  case '+':
+    return Operator::Plus;
+  case '-':
+    return Operator::Minus;
+  case '*':
+  case 'x':
+    return Operator::Times;
+  case '/':
+    return Operator::Divide;
+  case '^':
+    return Operator::Pow;
+  case '%':
+    return Operator::Mod;
+  }
+  return Operator::None;
+}
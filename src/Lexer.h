@@ -0,0 +1,99 @@
+#pragma once
+
+// Internal headers
+#include "Operator.h"
+
+// Standard library
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+/******************************************************************************
+ * Single-pass tokenizer for mathematical expression strings.
+ *
+ * The Lexer walks an expression from left to right over a std::string_view,
+ * so neither the input nor any token is ever copied. Whitespace is skipped,
+ * numbers are converted with std::from_chars, and those without a decimal
+ * point which fit in an int64 also keep their exact value. Operator or
+ * function names are looked up in place. The Lexer also tracks whether an
+ * operand or an operator is expected next. This tells the multiplication
+ * operator 'x' apart from names starting with 'x', and rejects malformed
+ * sequences such as consecutive binary operators. Lexing an expression to its
+ * end therefore also validates it, except for the arguments of Calculus
+ * operations such as integrate(), whose whole call is a single token.
+ *****************************************************************************/
+class Lexer {
+public:
+  // Enums
+  enum class TokenType {
+    Number,
+    Function,       /// A function name such as sin or e^, before its '('
+    Variable,       /// Any other name, such as x, rate or t0
+    Operation,      /// A whole call of a Calculus operation, up to its ')'
+    BinaryOperator, /// Includes a leading sign at the start of a bracket
+    LeftBracket,
+    RightBracket,
+    End, /// No tokens remain
+  };
+
+  // Structs
+
+  /// A single token, viewing the part of the input it was read from
+  struct Token {
+    TokenType type{TokenType::End};
+    Operator oper{Operator::None};
+    double value{0.0}; /// Value of a Number token
+    std::string_view text{};
+    std::int64_t integer{0}; /// Exact value of a Number token, if isInteger
+    bool isInteger{false};   /// Whether a Number token is an int64 literal
+  };
+
+  // Constructors
+  explicit Lexer(std::string_view expression)
+      : expression_(expression), position_(0), depth_(0),
+        expectOperand_(true), atGroupStart_(true), afterFunction_(false),
+        afterNumber_(false) {}
+
+  // Public methods
+
+  /// Read the next token, throwing if the expression is malformed there
+  Token next();
+  /// Index just past the most recently read token
+  size_t position() const { return position_; }
+  /// Number of brackets opened but not yet closed
+  size_t depth() const { return depth_; }
+  /// Whether a character can start a function or variable name
+  static bool isNameStart(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+  }
+  /// Whether a character can continue a function or variable name
+  static bool isNameCharacter(char c) { return isNameStart(c) || isDigit_(c); }
+
+private:
+  // Private methods
+
+  /// Read a number starting at the current position
+  Token number_();
+  /// Read a function or variable name starting at the current position
+  Token name_();
+  /// Read a call of a Calculus operation whose '(' is at index bracket
+  Token operation_(size_t bracket);
+  /// Build a token of the given type spanning the next length characters
+  Token advance_(TokenType type, size_t length,
+                 Operator oper = Operator::None);
+  /// Throw an exception describing why the expression is invalid
+  [[noreturn]] void fail_(std::string_view reason) const;
+  /// The Operator represented by a binary operator character, if any
+  static Operator binaryOperator_(char c);
+  /// Whether a character is a decimal digit
+  static bool isDigit_(char c) { return c >= '0' && c <= '9'; }
+
+  // Private variables
+  std::string_view expression_; /// Expression being tokenized
+  size_t position_;             /// Index of the next unread character
+  size_t depth_;                /// Number of currently unclosed brackets
+  bool expectOperand_;          /// Whether an operand must come next
+  bool atGroupStart_;  /// Whether at the start of the expression or a bracket
+  bool afterFunction_; /// Whether the last token was a function name
+  bool afterNumber_;   /// Whether the last token was a number
+};
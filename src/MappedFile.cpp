@@ -0,0 +1,55 @@
+// Internal headers
+#include "MappedFile.h"
+
+// Standard library
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+// POSIX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Namespaces
+using namespace std::string_literals;
+
+// ----------------------------------------------------------------------------
+// Constructors
+// ----------------------------------------------------------------------------
+MappedFile::MappedFile(const std::string &path) : data_(nullptr), size_(0) {
+  int fd{::open(path.c_str(), O_RDONLY | O_CLOEXEC)};
+  if (fd < 0)
+    throw std::runtime_error("Could not open file "s + path + ": " +
+                             std::strerror(errno));
+  struct stat status {};
+  if (::fstat(fd, &status) != 0) {
+    int error{errno};
+    ::close(fd);
+    throw std::runtime_error("Could not read size of file "s + path + ": " +
+                             std::strerror(error));
+  }
+  size_ = static_cast<size_t>(status.st_size);
+  // Mapping zero bytes fails, and an empty file needs no mapping anyway
+  if (size_ > 0) {
+    data_ = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data_ == MAP_FAILED) {
+      int error{errno};
+      data_ = nullptr;
+      ::close(fd);
+      throw std::runtime_error("Could not map file "s + path + ": " +
+                               std::strerror(error));
+    }
+    // The file is read front to back, so ask for aggressive read-ahead
+    ::madvise(data_, size_, MADV_SEQUENTIAL);
+  }
+  // The mapping stays valid after its file descriptor is closed
+  ::close(fd);
+}
+
+MappedFile::~MappedFile() {
+  if (data_ != nullptr)
+    ::munmap(data_, size_);
+}
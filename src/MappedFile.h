@@ -0,0 +1,35 @@
+#pragma once
+
+// Standard library
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+/******************************************************************************
+ * Read-only memory mapping of a whole file.
+ *
+ * The file's contents are viewed in place through contents() rather than read
+ * into a buffer, so even very large inputs cost no copying up front and pages
+ * are only loaded as they are touched. The mapping lasts as long as the
+ * MappedFile, which can therefore not be copied.
+ *****************************************************************************/
+class MappedFile {
+public:
+  // Constructors
+  explicit MappedFile(const std::string &path);
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+  ~MappedFile();
+
+  // Public methods
+
+  /// The whole contents of the file
+  std::string_view contents() const {
+    return {static_cast<const char *>(data_), size_};
+  }
+
+private:
+  // Private variables
+  void *data_;  /// Start of the mapping, or nullptr for an empty file
+  size_t size_; /// Length of the file in bytes
+};
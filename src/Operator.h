@@ -0,0 +1,235 @@
+#pragma once
+
+// Standard library
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+
+/// Mathematical operations which can appear in an Expression
+enum class Operator {
+  None, /// Represents the identity, or no operation.
+  Plus,
+  Minus,
+  Times,
+  Divide,
+  Pow, /// One number to the power of another: x^y
+  Mod,
+  Exp, /// A power of Euler's number: e^()
+  Sqrt,
+  Ln,
+  Log,
+  Sin,
+  Cos,
+  Tan,
+  Sinh,
+  Cosh,
+  Tanh,
+};
+
+// ----------------------------------------------------------------------------
+// Arithmetic
+//
+// applyUnary() and applyBinary() are the one definition of what each Operator
+// computes. Evaluators with a runtime Operator select the matching template
+// through dispatchUnary() or dispatchBinary(), so that loops over many values
+// can be specialized, and vectorized, for a single Operator. They calculate in
+// any floating-point type through the <cmath> overloads for it, and are all
+// constexpr so that ConstantParser calculates with them at compile time; GCC
+// evaluates the <cmath> functions in constant expressions.
+// ----------------------------------------------------------------------------
+
+/// Apply a unary function Operator to a number
+template <Operator oper, typename Scalar = double>
+constexpr Scalar applyUnary(Scalar operand) {
+  if constexpr (oper == Operator::None) {
+    return operand;
+  } else if constexpr (oper == Operator::Exp) {
+    return std::exp(operand);
+  } else if constexpr (oper == Operator::Sqrt) {
+    return std::sqrt(operand);
+  } else if constexpr (oper == Operator::Ln) {
+    return std::log(operand);
+  } else if constexpr (oper == Operator::Log) {
+    return std::log10(operand);
+  } else if constexpr (oper == Operator::Sin) {
+    return std::sin(operand);
+  } else if constexpr (oper == Operator::Cos) {
+    return std::cos(operand);
+  } else if constexpr (oper == Operator::Tan) {
+    return std::tan(operand);
+  } else if constexpr (oper == Operator::Sinh) {
+    return std::sinh(operand);
+  } else if constexpr (oper == Operator::Cosh) {
+    return std::cosh(operand);
+  } else {
+    static_assert(oper == Operator::Tanh, "Operator is not a unary function");
+    return std::tanh(operand);
+  }
+}
+
+/// Apply a binary Operator to two numbers
+template <Operator oper, typename Scalar = double>
+constexpr Scalar applyBinary(Scalar leftOperand, Scalar rightOperand) {
+  if constexpr (oper == Operator::Plus) {
+    return leftOperand + rightOperand;
+  } else if constexpr (oper == Operator::Minus) {
+    return leftOperand - rightOperand;
+  } else if constexpr (oper == Operator::Times) {
+    return leftOperand * rightOperand;
+  } else if constexpr (oper == Operator::Divide) {
+    return leftOperand / rightOperand;
+  } else if constexpr (oper == Operator::Mod) {
+    return std::fmod(leftOperand, rightOperand);
+  } else {
+    static_assert(oper == Operator::Pow, "Operator is not a binary operator");
+    return std::pow(leftOperand, rightOperand);
+  }
+}
+
+// ----------------------------------------------------------------------------
+// Integer arithmetic
+//
+// Operands which are exact integers are combined with integer instructions,
+// so results stay exact beyond 2^53 and ^ and % avoid std::pow and std::fmod.
+// A result stays an integer while it fits in an int64 and, for /, while the
+// division has no remainder. Otherwise it becomes the nearest double, taken
+// from the exact 128-bit result where the compiler has __int128.
+// ----------------------------------------------------------------------------
+
+/// A calculated value, which is also exactly integer if isInteger
+struct Number {
+  double value{0.0};
+  std::int64_t integer{0};
+  bool isInteger{false};
+
+  /// An exact integer
+  static constexpr Number exact(std::int64_t integer) {
+    return {static_cast<double>(integer), integer, true};
+  }
+};
+
+#ifdef __SIZEOF_INT128__
+/// Signed 128-bit integer, holding any sum, difference or product of int64s
+__extension__ using Int128 = __int128;
+#endif
+
+/// Apply a binary Operator to two exact integers
+template <Operator oper>
+constexpr Number applyIntegerBinary(std::int64_t leftOperand,
+                                    std::int64_t rightOperand) {
+  std::int64_t result{0};
+  if constexpr (oper == Operator::Plus || oper == Operator::Minus ||
+                oper == Operator::Times) {
+    bool overflows{};
+    if constexpr (oper == Operator::Plus)
+      overflows = __builtin_add_overflow(leftOperand, rightOperand, &result);
+    else if constexpr (oper == Operator::Minus)
+      overflows = __builtin_sub_overflow(leftOperand, rightOperand, &result);
+    else
+      overflows = __builtin_mul_overflow(leftOperand, rightOperand, &result);
+    if (!overflows)
+      return Number::exact(result);
+#ifdef __SIZEOF_INT128__
+    Int128 left{leftOperand};
+    Int128 right{rightOperand};
+    Int128 wide{oper == Operator::Plus    ? left + right
+                : oper == Operator::Minus ? left - right
+                                          : left * right};
+    return {static_cast<double>(wide)};
+#endif
+  } else if constexpr (oper == Operator::Divide) {
+    // Dividing the smallest int64 by -1 is the one quotient out of range
+    if (rightOperand != 0 &&
+        !(leftOperand == std::numeric_limits<std::int64_t>::min() &&
+          rightOperand == -1) &&
+        leftOperand % rightOperand == 0)
+      return Number::exact(leftOperand / rightOperand);
+  } else if constexpr (oper == Operator::Mod) {
+    // Both truncate towards zero, so % matches std::fmod
+    if (rightOperand == -1)
+      return Number::exact(0);
+    if (rightOperand != 0)
+      return Number::exact(leftOperand % rightOperand);
+  } else {
+    static_assert(oper == Operator::Pow, "Operator is not a binary operator");
+    if (rightOperand >= 0) {
+      // Exponentiation by squaring, while every product fits
+      std::int64_t base{leftOperand};
+      std::int64_t exponent{rightOperand};
+      result = 1;
+      bool overflows{false};
+      while (exponent > 0 && !overflows) {
+        if (exponent & 1)
+          overflows = __builtin_mul_overflow(result, base, &result);
+        exponent >>= 1;
+        if (exponent > 0)
+          overflows |= __builtin_mul_overflow(base, base, &base);
+      }
+      if (!overflows)
+        return Number::exact(result);
+    }
+  }
+  return {applyBinary<oper>(static_cast<double>(leftOperand),
+                            static_cast<double>(rightOperand))};
+}
+
+/// Apply a binary Operator to two Numbers, exactly if both are integers
+template <Operator oper>
+constexpr Number applyNumberBinary(Number leftOperand, Number rightOperand) {
+  if (leftOperand.isInteger && rightOperand.isInteger)
+    return applyIntegerBinary<oper>(leftOperand.integer, rightOperand.integer);
+  return {applyBinary<oper>(leftOperand.value, rightOperand.value)};
+}
+
+/// Call visit.template operator()<oper>() for a unary function Operator
+template <typename Visitor>
+constexpr decltype(auto) dispatchUnary(Operator oper, Visitor &&visit) {
+  switch (oper) {
+  case Operator::None:
+    return visit.template operator()<Operator::None>();
+  case Operator::Exp:
+    return visit.template operator()<Operator::Exp>();
+  case Operator::Sqrt:
+    return visit.template operator()<Operator::Sqrt>();
+  case Operator::Ln:
+    return visit.template operator()<Operator::Ln>();
+  case Operator::Log:
+    return visit.template operator()<Operator::Log>();
+  case Operator::Sin:
+    return visit.template operator()<Operator::Sin>();
+  case Operator::Cos:
+    return visit.template operator()<Operator::Cos>();
+  case Operator::Tan:
+    return visit.template operator()<Operator::Tan>();
+  case Operator::Sinh:
+    return visit.template operator()<Operator::Sinh>();
+  case Operator::Cosh:
+    return visit.template operator()<Operator::Cosh>();
+  case Operator::Tanh:
+    return visit.template operator()<Operator::Tanh>();
+  default:
+    throw std::runtime_error("Invalid operator given single operand.");
+  }
+}
+
+/// Call visit.template operator()<oper>() for a binary Operator
+template <typename Visitor>
+constexpr decltype(auto) dispatchBinary(Operator oper, Visitor &&visit) {
+  switch (oper) {
+  case Operator::Plus:
+    return visit.template operator()<Operator::Plus>();
+  case Operator::Minus:
+    return visit.template operator()<Operator::Minus>();
+  case Operator::Times:
+    return visit.template operator()<Operator::Times>();
+  case Operator::Divide:
+    return visit.template operator()<Operator::Divide>();
+  case Operator::Mod:
+    return visit.template operator()<Operator::Mod>();
+  case Operator::Pow:
+    return visit.template operator()<Operator::Pow>();
+  default:
+    throw std::runtime_error("Invalid operator given two operands.");
+  }
+}
@@ -0,0 +1,269 @@
+// Internal headers
+#include "Optimizer.h"
+
+// Standard library
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+
+// ----------------------------------------------------------------------------
+// Constructors
+// ----------------------------------------------------------------------------
+Optimizer::Optimizer(const Expression &expression, bool integersOnly)
+    : expression_(expression), integersOnly_(integersOnly),
+      newIndices_(expression.nodes_.size(), unvisited_), nodes_(),
+      operands_(), pending_(), table_() {
+  // Only strength reduction makes the simplified tree larger than the
+  // original, by a few Nodes per power
+  nodes_.reserve(expression.nodes_.size());
+  operands_.reserve(expression.operands_.size());
+  pending_.reserve(expression.operands_.size());
+  // At most half full, so probe sequences stay short
+  table_.resize(std::bit_ceil(2 * expression.nodes_.size() + 1));
+}
+
+// ----------------------------------------------------------------------------
+// Public Methods
+// ----------------------------------------------------------------------------
+void Optimizer::optimize(Expression &expression, bool integersOnly) {
+  if (!expression.isParsed_) {
+    expression.parse_();
+  }
+  Optimizer optimizer(expression, integersOnly);
+  size_t root{optimizer.visit_(expression.outerStep_)};
+  expression.nodes_ = std::move(optimizer.nodes_);
+  expression.operands_ = std::move(optimizer.operands_);
+  expression.outerStep_ = root;
+  expression.isOptimized_ = true;
+  expression.isLinked_ = false;
+}
+
+// ----------------------------------------------------------------------------
+// Private Methods
+// ----------------------------------------------------------------------------
+size_t Optimizer::visit_(size_t node) {
+  if (newIndices_[node] != unvisited_) {
+    return newIndices_[node];
+  }
+  Node current{expression_.nodes_[node]};
+  // Operands are simplified first, so identical subexpressions below this
+  // Node have already been merged and can be compared by index
+  size_t firstPending{pending_.size()};
+  for (size_t i{0}; i < current.numOperands; ++i) {
+    const Operand &operand{expression_.operands_[current.firstOperand + i]};
+    size_t simplified{visit_(operand.node)};
+    pending_.push_back({.node = simplified, .oper = operand.oper});
+  }
+  if (current.numOperands > 0) {
+    foldConstants_(current, firstPending);
+    reduceStrength_(current, firstPending);
+  }
+  newIndices_[node] = intern_(current, firstPending);
+  return newIndices_[node];
+}
+
+void Optimizer::foldConstants_(Node &node, size_t firstPending) {
+  auto first{pending_.begin() + static_cast<std::ptrdiff_t>(firstPending)};
+  size_t numOperands{pending_.size() - firstPending};
+  // Functions never give integers
+  if (integersOnly_ && node.function != Expression::Operator::None)
+    return;
+  size_t numLeading{0};
+  while (numLeading < numOperands &&
+         isFoldable_(nodes_[pending_[firstPending + numLeading].node]))
+    ++numLeading;
+  if (numLeading == 0 || (numLeading == 1 && numOperands > 1)) {
+    return;
+  }
+  // Operators apply left-to-right, so leading numbers combine on their own
+  Expression::Number value{Expression::number_(nodes_[first->node])};
+  if (node.function != Expression::Operator::None) {
+    value = {Expression::calculate_(node.function, value.value)};
+  }
+  for (size_t i{1}; i < numLeading; ++i) {
+    const Operand &operand{pending_[firstPending + i]};
+    Expression::Number next{Expression::calculate_(
+        operand.oper, value, Expression::number_(nodes_[operand.node]))};
+    // A quotient with a remainder, say, is left to the evaluator's type
+    if (integersOnly_ && !next.isInteger) {
+      numLeading = i;
+      break;
+    }
+    value = next;
+  }
+  if (numLeading == 1 && numOperands > 1) {
+    return;
+  }
+  Node number{.result = value.value,
+              .isCalculated = true,
+              .integer = value.integer,
+              .isInteger = value.isInteger};
+  if (numLeading == numOperands) {
+    node = number;
+    pending_.erase(first, pending_.end());
+    return;
+  }
+  size_t folded{intern_(number, pending_.size())};
+  first = pending_.begin() + static_cast<std::ptrdiff_t>(firstPending);
+  first->node = folded;
+  pending_.erase(first + 1, first + static_cast<std::ptrdiff_t>(numLeading));
+}
+
+void Optimizer::reduceStrength_(Node &node, size_t firstPending) {
+  using Operator = Expression::Operator;
+  size_t numOperands{pending_.size() - firstPending};
+  if (numOperands == 0)
+    return;
+  if (node.function == Operator::None && numOperands == 2 &&
+      pending_[firstPending + 1].oper == Operator::Pow &&
+      isNumber_(nodes_[pending_[firstPending + 1].node])) {
+    size_t base{pending_[firstPending].node};
+    double exponent{nodes_[pending_[firstPending + 1].node].result};
+    if (std::trunc(exponent) == exponent &&
+        std::abs(exponent) <= static_cast<double>(maxMultipliedPower_)) {
+      auto magnitude{static_cast<std::int64_t>(std::abs(exponent))};
+      size_t power{magnitude == 0 ? number_(1.0, true)
+                                  : power_(base, magnitude)};
+      if (exponent < 0)
+        power = combine_(number_(1.0, true), Operator::Divide, power);
+      replaceWith_(node, firstPending, power);
+      return;
+    }
+  }
+  // Evaluators in other types calculate their constants themselves
+  if (integersOnly_)
+    return;
+  for (size_t i{firstPending + 1}; i < pending_.size(); ++i) {
+    const Operand &operand{pending_[i]};
+    if (operand.oper != Operator::Divide || !isNumber_(nodes_[operand.node]))
+      continue;
+    // A subnormal reciprocal would lose digits, and an infinite one is wrong
+    double reciprocal{1.0 / nodes_[operand.node].result};
+    if (std::isnormal(reciprocal))
+      pending_[i] = {.node = number_(reciprocal, false),
+                     .oper = Operator::Times};
+  }
+}
+
+void Optimizer::replaceWith_(Node &node, size_t firstPending,
+                             size_t replacement) {
+  node = nodes_[replacement];
+  pending_.resize(firstPending);
+  for (size_t i{0}; i < node.numOperands; ++i)
+    pending_.push_back(operands_[node.firstOperand + i]);
+}
+
+size_t Optimizer::power_(size_t base, std::int64_t exponent) {
+  if (exponent == 1)
+    return base;
+  size_t half{power_(base, exponent / 2)};
+  size_t square{combine_(half, Expression::Operator::Times, half)};
+  if (exponent % 2 == 0)
+    return square;
+  return combine_(square, Expression::Operator::Times, base);
+}
+
+size_t Optimizer::combine_(size_t left, Expression::Operator oper,
+                           size_t right) {
+  size_t firstPending{pending_.size()};
+  pending_.push_back({.node = left, .oper = Expression::Operator::None});
+  pending_.push_back({.node = right, .oper = oper});
+  return intern_({}, firstPending);
+}
+
+size_t Optimizer::number_(double value, bool isInteger) {
+  Node number{.result = value,
+              .isCalculated = true,
+              .integer = isInteger ? static_cast<std::int64_t>(value) : 0,
+              .isInteger = isInteger};
+  return intern_(number, pending_.size());
+}
+
+size_t Optimizer::intern_(Node node, size_t firstPending) {
+  const Operand *operands{pending_.data() + firstPending};
+  node.numOperands = pending_.size() - firstPending;
+  if (node.numOperands > 0) {
+    node.firstOperand = operands_.size();
+    node.isCalculated = false;
+  } else {
+    // Brackets around a lone number or variable are irrelevant
+    node.firstOperand = 0;
+    node.hasBrackets = false;
+  }
+  size_t mask{table_.size() - 1};
+  size_t slot{hash_(node, operands) & mask};
+  for (; table_[slot] != 0; slot = (slot + 1) & mask) {
+    if (isIdentical_(table_[slot] - 1, node, operands)) {
+      pending_.resize(firstPending);
+      return table_[slot] - 1;
+    }
+  }
+  operands_.insert(operands_.end(), operands, operands + node.numOperands);
+  pending_.resize(firstPending);
+  nodes_.push_back(node);
+  table_[slot] = nodes_.size();
+  // Keep the table at most half full as strength reduction adds Nodes
+  if (2 * nodes_.size() >= table_.size()) {
+    growTable_();
+  }
+  return nodes_.size() - 1;
+}
+
+void Optimizer::growTable_() {
+  table_.assign(2 * table_.size(), 0);
+  size_t mask{table_.size() - 1};
+  for (size_t i{0}; i < nodes_.size(); ++i) {
+    const Node &node{nodes_[i]};
+    size_t slot{hash_(node, operands_.data() + node.firstOperand) & mask};
+    while (table_[slot] != 0)
+      slot = (slot + 1) & mask;
+    table_[slot] = i + 1;
+  }
+}
+
+size_t Optimizer::hash_(const Node &node, const Operand *operands) const {
+  std::uint64_t hash{static_cast<std::uint64_t>(node.function)};
+  auto combine{[&hash](std::uint64_t value) {
+    hash = (hash ^ value) * 0x9e3779b97f4a7c15ULL;
+    hash ^= hash >> 32;
+  }};
+  combine(node.hasBrackets);
+  combine(node.variable);
+  if (isNumber_(node)) {
+    combine(std::bit_cast<std::uint64_t>(node.result));
+    combine(static_cast<std::uint64_t>(node.integer));
+  }
+  for (size_t i{0}; i < node.numOperands; ++i) {
+    combine(operands[i].node);
+    combine(static_cast<std::uint64_t>(operands[i].oper));
+  }
+  return static_cast<size_t>(hash);
+}
+
+bool Optimizer::isIdentical_(size_t node, const Node &other,
+                             const Operand *operands) const {
+  const Node &current{nodes_[node]};
+  if (current.function != other.function ||
+      current.numOperands != other.numOperands ||
+      current.variable != other.variable ||
+      current.hasBrackets != other.hasBrackets) {
+    return false;
+  }
+  // Numbers are compared bitwise, so eg. 0 and -0 stay distinct, and so are
+  // integers rounding to the same double, such as 2^53 and 2^53+1
+  if (isNumber_(current) &&
+      (std::bit_cast<std::uint64_t>(current.result) !=
+           std::bit_cast<std::uint64_t>(other.result) ||
+       current.isInteger != other.isInteger ||
+       current.integer != other.integer)) {
+    return false;
+  }
+  for (size_t i{0}; i < current.numOperands; ++i) {
+    const Operand &operand{operands_[current.firstOperand + i]};
+    if (operand.node != operands[i].node || operand.oper != operands[i].oper) {
+      return false;
+    }
+  }
+  return true;
+}
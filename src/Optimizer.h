@@ -0,0 +1,113 @@
+#pragma once
+
+// Internal headers
+#include "Expression.h"
+
+// Standard library
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/******************************************************************************
+ * Simplifies the parsed tree of an Expression before it is evaluated.
+ *
+ * The tree is rebuilt bottom-up into a fresh set of Node arrays. Along the way
+ *   - a Node whose operands are all numbers is calculated once and replaced by
+ *     its result, as is a run of numbers leading an operator chain, since
+ *     chains are applied left-to-right, with the same exact integer
+ *     arithmetic as Expression
+ *   - a Node identical to one already built, ie. with the same function,
+ *     operators and operand Nodes, is replaced by that Node
+ * so repeated subexpressions such as the two sin(2.3) in sin(2.3)*x+sin(2.3)*y
+ * become a single shared Node. The result is a directed acyclic graph in which
+ * each distinct subexpression is calculated only once, since Nodes keep their
+ * calculated result.
+ *
+ * Operations are also strength-reduced into cheaper ones with the same value
+ * up to a few roundings, since std::pow and division cost many times a
+ * multiplication:
+ *   - x^n for integers n up to maxMultipliedPower_ in magnitude becomes
+ *     multiplications by repeated squaring, eg. x^4 is s x s for s = x x,
+ *     with 1/ for negative n, while x^0 is 1 and x^1 is x as with std::pow
+ *   - x/c for a number c becomes x 1/c, unless 1/c is infinite or subnormal
+ * Identities such as e^(ln(x)) = x are left alone, as they only hold inside
+ * the functions' domain and range, and the tree says nothing about the values
+ * of its variables. So is x^0.5, since sqrt(x) differs from std::pow for -0
+ * and -inf.
+ *
+ * Evaluators calculating in a type other than double fold only exact integer
+ * subexpressions, which are the same in every type, and calculate the rest of
+ * their constants themselves.
+ *****************************************************************************/
+class Optimizer {
+public:
+  // Public methods
+
+  /// Fold constants, or only exact integer ones, and merge identical
+  /// subexpressions of a parsed Expression
+  static void optimize(Expression &expression, bool integersOnly = false);
+
+private:
+  // Types
+  using Node = Expression::Node;
+  using Operand = Expression::Operand;
+
+  // Private constants
+
+  /// Entry of newIndices_ for original Nodes not visited yet
+  static constexpr size_t unvisited_{static_cast<size_t>(-1)};
+  /// Largest magnitude of integer exponents turned into multiplications,
+  /// whose results are within 4 roundings of the exact power
+  static constexpr std::int64_t maxMultipliedPower_{8};
+
+  // Constructors
+  Optimizer(const Expression &expression, bool integersOnly);
+
+  // Private methods
+
+  /// Build the simplified form of an original Node, returning its new index
+  size_t visit_(size_t node);
+  /// Fold a leading run of numbers among the pending operands of a Node,
+  /// turning the Node into a number if all of its operands are numbers
+  void foldConstants_(Node &node, size_t firstPending);
+  /// Whether a Node is a number
+  static bool isNumber_(const Node &node) {
+    return node.numOperands == 0 && node.variable == Expression::noVariable;
+  }
+  /// Whether a Node is a number which may be folded into others
+  bool isFoldable_(const Node &node) const {
+    return isNumber_(node) && (node.isInteger || !integersOnly_);
+  }
+  /// Rewrite a Node with its pending operands into cheaper operations
+  void reduceStrength_(Node &node, size_t firstPending);
+  /// Turn a Node into a copy of a simplified Node, pending its operands
+  void replaceWith_(Node &node, size_t firstPending, size_t replacement);
+  /// Index of a Node multiplying base by itself into base^exponent, for
+  /// exponent >= 1
+  size_t power_(size_t base, std::int64_t exponent);
+  /// Index of a Node applying a binary Operator to two simplified Nodes
+  size_t combine_(size_t left, Expression::Operator oper, size_t right);
+  /// Index of a Node for a number, exactly an integer if isInteger
+  size_t number_(double value, bool isInteger);
+  /// Add a new Node with the pending operands from firstPending, or find an
+  /// identical one, returning its index
+  size_t intern_(Node node, size_t firstPending);
+  /// Double the size of table_, rehashing every Node into it
+  void growTable_();
+  /// Hash of a Node's function, value and operands
+  size_t hash_(const Node &node, const Operand *operands) const;
+  /// Whether a new Node is identical to a Node with the given operands
+  bool isIdentical_(size_t node, const Node &other,
+                    const Operand *operands) const;
+
+  // Private variables
+  const Expression &expression_;   /// Expression whose tree is simplified
+  bool integersOnly_;              /// Whether only integers are folded
+  std::vector<size_t> newIndices_; /// New index of each visited original Node
+  std::vector<Node> nodes_;        /// Simplified Nodes
+  std::vector<Operand> operands_;  /// Operands of the simplified Nodes
+  std::vector<Operand> pending_;   /// Operands of Nodes being built
+  /// Open-addressing hash table of simplified Node indices plus one, with
+  /// zero marking an empty slot
+  std::vector<size_t> table_;
+};
@@ -0,0 +1,128 @@
+// Internal headers
+#include "OutputBuffer.h"
+
+// Standard library
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+// POSIX
+#include <unistd.h>
+
+// Namespaces
+using namespace std::string_literals;
+
+/// Append a number of any floating-point type, formatted as appendNumber()
+/// does
+template <typename Scalar>
+static void appendScalar(std::string &text, Scalar value, int precision) {
+  // The most a shortest form adds to its digits, or a precision adds to its
+  // digits, is a sign, point and exponent, eg. -2.2250738585072014e-308, or
+  // the leading "0.000" of small numbers in fixed notation
+  size_t start{text.size()};
+  int numDigits{precision < 0 ? std::numeric_limits<Scalar>::max_digits10
+                               : precision};
+  size_t maxSize{static_cast<size_t>(numDigits) + 16};
+  text.resize(start + maxSize);
+  char *first{text.data() + start};
+  std::to_chars_result written{
+      precision < 0
+          ? std::to_chars(first, first + maxSize, value)
+          : std::to_chars(first, first + maxSize, value,
+                          std::chars_format::general, precision)};
+  text.resize(static_cast<size_t>(written.ptr - text.data()));
+}
+
+// ----------------------------------------------------------------------------
+// Constructors
+// ----------------------------------------------------------------------------
+OutputBuffer::OutputBuffer(int fd, size_t capacity)
+    : fd_(fd), stream_(nullptr), capacity_(capacity), text_() {
+  // Room for a full buffer plus the line which overflowed it
+  text_.reserve(capacity + 256);
+}
+
+OutputBuffer::OutputBuffer(std::ostream &stream, size_t capacity)
+    : fd_(-1), stream_(&stream), capacity_(capacity), text_() {
+  text_.reserve(capacity + 256);
+}
+
+OutputBuffer::OutputBuffer(OutputBuffer &&other) noexcept
+    : fd_(std::exchange(other.fd_, -1)),
+      stream_(std::exchange(other.stream_, nullptr)),
+      capacity_(std::exchange(other.capacity_, 0)),
+      text_(std::move(other.text_)) {}
+
+OutputBuffer &OutputBuffer::operator=(OutputBuffer &&other) noexcept {
+  if (this != &other) {
+    try {
+      flush();
+    } catch (const std::exception &) {
+    }
+    fd_ = std::exchange(other.fd_, -1);
+    stream_ = std::exchange(other.stream_, nullptr);
+    capacity_ = std::exchange(other.capacity_, 0);
+    text_ = std::move(other.text_);
+  }
+  return *this;
+}
+
+OutputBuffer::~OutputBuffer() {
+  // Destructors must not throw, and there is nobody left to tell
+  try {
+    flush();
+  } catch (const std::exception &) {
+  }
+}
+
+// ----------------------------------------------------------------------------
+// Public Methods
+// ----------------------------------------------------------------------------
+void OutputBuffer::flush() {
+  if (stream_ != nullptr) {
+    stream_->write(text_.data(), static_cast<std::streamsize>(text_.size()));
+    stream_->flush();
+    text_.clear();
+    return;
+  }
+  if (fd_ < 0)
+    return;
+  std::string_view rest{text_};
+  while (!rest.empty()) {
+    ssize_t numWritten{::write(fd_, rest.data(), rest.size())};
+    if (numWritten < 0) {
+      if (errno == EINTR)
+        continue;
+      int error{errno};
+      text_.clear();
+      throw std::runtime_error("Could not write output: "s +
+                               std::strerror(error));
+    }
+    rest.remove_prefix(static_cast<size_t>(numWritten));
+  }
+  text_.clear();
+}
+
+std::string OutputBuffer::take() {
+  std::string text{std::move(text_)};
+  text_.clear();
+  return text;
+}
+
+void OutputBuffer::appendNumber(std::string &text, float value,
+                                int precision) {
+  appendScalar(text, value, precision);
+}
+
+void OutputBuffer::appendNumber(std::string &text, double value,
+                                int precision) {
+  appendScalar(text, value, precision);
+}
+
+void OutputBuffer::appendNumber(std::string &text, long double value,
+                                int precision) {
+  appendScalar(text, value, precision);
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+// Standard library
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+/******************************************************************************
+ * Buffer of formatted output, written out in large blocks.
+ *
+ * Numbers are formatted with std::to_chars, either with a number of
+ * significant digits, giving the same text as streaming them with
+ * std::setprecision(), or as the shortest text which reads back as the same
+ * float, double or long double. Text accumulates in one reusable string,
+ * which is written to a file descriptor with write(2), bypassing iostreams
+ * altogether, or to a std::ostream, once it grows past its capacity and when
+ * flush() is called. Without a destination, text accumulates until taken with
+ * take().
+ *****************************************************************************/
+class OutputBuffer {
+public:
+  // Public constants
+
+  /// Precision giving the shortest round-trip form of numbers
+  static constexpr int shortest{-1};
+  /// Bytes buffered before being written out
+  static constexpr size_t defaultCapacity{size_t{1} << 16};
+
+  // Constructors
+
+  /// Keep all output in memory
+  OutputBuffer() : fd_(-1), stream_(nullptr), capacity_(0), text_() {}
+  /// Write output to a file descriptor, which is not closed
+  explicit OutputBuffer(int fd, size_t capacity = defaultCapacity);
+  /// Write output to a stream
+  explicit OutputBuffer(std::ostream &stream,
+                        size_t capacity = defaultCapacity);
+  OutputBuffer(OutputBuffer &&other) noexcept;
+  OutputBuffer &operator=(OutputBuffer &&other) noexcept;
+  OutputBuffer(const OutputBuffer &) = delete;
+  OutputBuffer &operator=(const OutputBuffer &) = delete;
+  /// Write out whatever is still buffered, ignoring errors
+  ~OutputBuffer();
+
+  // Public methods
+
+  OutputBuffer &operator<<(std::string_view text) {
+    text_ += text;
+    flushIfFull_();
+    return *this;
+  }
+  OutputBuffer &operator<<(char c) {
+    text_ += c;
+    flushIfFull_();
+    return *this;
+  }
+  /// Append a number with precision significant digits, or in its shortest
+  /// round-trip form if precision is negative
+  template <typename Scalar>
+  OutputBuffer &appendNumber(Scalar value, int precision) {
+    appendNumber(text_, value, precision);
+    flushIfFull_();
+    return *this;
+  }
+  /// Write out everything buffered
+  void flush();
+  /// Text buffered and not yet written out
+  std::string_view view() const { return text_; }
+  /// Remove and return the text buffered
+  std::string take();
+  /// Append a number to a string, formatted as appendNumber() does
+  static void appendNumber(std::string &text, float value, int precision);
+  static void appendNumber(std::string &text, double value, int precision);
+  static void appendNumber(std::string &text, long double value,
+                           int precision);
+
+private:
+  // Private methods
+
+  /// Write out the buffer once it exceeds its capacity
+  void flushIfFull_() {
+    if (capacity_ != 0 && text_.size() >= capacity_)
+      flush();
+  }
+
+  // Private variables
+  int fd_;                /// File descriptor written to, or -1
+  std::ostream *stream_;  /// Stream written to, or nullptr
+  size_t capacity_;       /// Bytes buffered before writing, or 0 for never
+  std::string text_;      /// Text not yet written out
+};
@@ -0,0 +1,191 @@
+// Internal headers
+#include "Profiler.h"
+
+// Standard library
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+#include <new>
+#include <utility>
+
+// ----------------------------------------------------------------------------
+// Static variables
+// ----------------------------------------------------------------------------
+constinit std::atomic<bool> Profiler::isEnabled_{false};
+constinit std::mutex Profiler::mutex_{};
+constinit Profiler::Totals Profiler::finishedTotals_{};
+constinit thread_local size_t Profiler::currentPhase_{numPhases};
+constinit thread_local std::array<Profiler::Allocations, Profiler::numPhases + 1>
+    Profiler::phaseAllocations_{};
+constinit thread_local Profiler::Allocations Profiler::threadAllocations_{};
+
+// ----------------------------------------------------------------------------
+// Replacement allocation functions
+// ----------------------------------------------------------------------------
+#ifdef CALC_ALLOC_STATS
+// The array and nothrow forms of operator new and delete call these
+void *operator new(size_t size) {
+  Profiler::recordAllocation(size);
+  if (void *memory{std::malloc(size == 0 ? 1 : size)})
+    return memory;
+  throw std::bad_alloc();
+}
+
+void *operator new(size_t size, std::align_val_t alignment) {
+  Profiler::recordAllocation(size);
+  size_t align{static_cast<size_t>(alignment)};
+  // aligned_alloc needs a size which is a multiple of the alignment
+  size = (std::max(size, size_t{1}) + align - 1) / align * align;
+  if (void *memory{std::aligned_alloc(align, size)})
+    return memory;
+  throw std::bad_alloc();
+}
+
+void operator delete(void *memory) noexcept { std::free(memory); }
+
+void operator delete(void *memory, size_t) noexcept { std::free(memory); }
+
+void operator delete(void *memory, std::align_val_t) noexcept {
+  std::free(memory);
+}
+
+void operator delete(void *memory, size_t, std::align_val_t) noexcept {
+  std::free(memory);
+}
+#endif
+
+// ----------------------------------------------------------------------------
+// Public Methods
+// ----------------------------------------------------------------------------
+Profiler::Totals &Profiler::Totals::operator+=(const Totals &other) {
+  for (size_t i{0}; i < numPhases; ++i) {
+    phases[i].calls += other.phases[i].calls;
+    phases[i].nanoseconds += other.phases[i].nanoseconds;
+    phases[i].allocations.count += other.phases[i].allocations.count;
+    phases[i].allocations.bytes += other.phases[i].allocations.bytes;
+  }
+  numTrees += other.numTrees;
+  numNodes += other.numNodes;
+  maxNodes = std::max(maxNodes, other.maxNodes);
+  maxDepth = std::max(maxDepth, other.maxDepth);
+  return *this;
+}
+
+Profiler::Timer::~Timer() {
+  if (!isActive_)
+    return;
+  auto elapsed{std::chrono::steady_clock::now() - start_};
+  currentPhase_ = outerPhase_;
+  PhaseTotals &phase{threadTotals_().phases[static_cast<size_t>(phase_)]};
+  ++phase.calls;
+  phase.nanoseconds += static_cast<std::uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+}
+
+void Profiler::recordTree(size_t numNodes, size_t depth) {
+  Totals &totals{threadTotals_()};
+  ++totals.numTrees;
+  totals.numNodes += numNodes;
+  totals.maxNodes = std::max(totals.maxNodes, numNodes);
+  totals.maxDepth = std::max(totals.maxDepth, depth);
+}
+
+void Profiler::recordAllocation(size_t bytes) {
+  Allocations &phase{phaseAllocations_[currentPhase_]};
+  ++phase.count;
+  phase.bytes += bytes;
+  ++threadAllocations_.count;
+  threadAllocations_.bytes += bytes;
+}
+
+Profiler::Allocations Profiler::threadAllocations() {
+  return threadAllocations_;
+}
+
+Profiler::Totals Profiler::totals() {
+  Totals totals{threadTotals_()};
+  addPhaseAllocations_(totals);
+  std::lock_guard lock(mutex_);
+  return totals += finishedTotals_;
+}
+
+void Profiler::reset() {
+  threadTotals_() = Totals();
+  phaseAllocations_ = {};
+  std::lock_guard lock(mutex_);
+  finishedTotals_ = Totals();
+}
+
+void Profiler::print(std::ostream &output) {
+  Totals all{totals()};
+  auto flags{output.flags()};
+  auto precision{output.precision()};
+  output << std::left << std::setw(12) << "phase" << std::right
+         << std::setw(12) << "calls" << std::setw(14) << "total_ms"
+         << std::setw(12) << "mean_ns";
+  if (countsAllocations)
+    output << std::setw(12) << "allocs" << std::setw(14) << "alloc_bytes";
+  output << '\n';
+  output << std::fixed;
+  for (size_t i{0}; i < numPhases; ++i) {
+    const PhaseTotals &phase{all.phases[i]};
+    double mean{phase.calls == 0 ? 0.0
+                                 : static_cast<double>(phase.nanoseconds) /
+                                       static_cast<double>(phase.calls)};
+    output << std::left << std::setw(12) << phaseName(static_cast<Phase>(i))
+           << std::right << std::setw(12) << phase.calls << std::setw(14)
+           << std::setprecision(3)
+           << static_cast<double>(phase.nanoseconds) / 1e6 << std::setw(12)
+           << std::setprecision(1) << mean;
+    if (countsAllocations)
+      output << std::setw(12) << phase.allocations.count << std::setw(14)
+             << phase.allocations.bytes;
+    output << '\n';
+  }
+  output << "trees " << all.numTrees << ", nodes " << all.numNodes
+         << ", max_nodes " << all.maxNodes << ", max_depth " << all.maxDepth
+         << '\n';
+  output.flags(flags);
+  output.precision(precision);
+}
+
+std::string_view Profiler::phaseName(Phase phase) {
+  switch (phase) {
+  case Phase::Validate:
+    return "validate";
+  case Phase::Parse:
+    return "parse";
+  case Phase::Tokenize:
+    return "tokenize";
+  case Phase::BuildTree:
+    return "build_tree";
+  case Phase::Calculate:
+    return "calculate";
+  }
+  return "unknown";
+}
+
+// ----------------------------------------------------------------------------
+// Private Methods
+// ----------------------------------------------------------------------------
+Profiler::ThreadTotals::~ThreadTotals() {
+  addPhaseAllocations_(totals);
+  std::lock_guard lock(mutex_);
+  finishedTotals_ += totals;
+}
+
+Profiler::Totals &Profiler::threadTotals_() {
+  thread_local ThreadTotals threadTotals;
+  return threadTotals.totals;
+}
+
+size_t Profiler::enterPhase_(Phase phase) {
+  return std::exchange(currentPhase_, static_cast<size_t>(phase));
+}
+
+void Profiler::addPhaseAllocations_(Totals &totals) {
+  for (size_t i{0}; i < numPhases; ++i) {
+    totals.phases[i].allocations.count += phaseAllocations_[i].count;
+    totals.phases[i].allocations.bytes += phaseAllocations_[i].bytes;
+  }
+}
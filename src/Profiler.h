@@ -0,0 +1,180 @@
+#pragma once
+
+// Standard library
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string_view>
+
+/// Phases of evaluating an Expression which are counted and timed separately
+enum class Phase : size_t {
+  Validate,  /// Expression::validate()
+  Parse,     /// Expression::parse_(), including the phases it runs
+  Tokenize,  /// Expression::tokenizeExpression_()
+  BuildTree, /// Expression::lastCalculationStep_()
+  Calculate, /// Calculating the parsed tree in Expression::result()
+};
+
+/******************************************************************************
+ * Counts and times each phase of evaluating Expressions, along with the size
+ * and depth of the trees they parse.
+ *
+ * Instrumentation is only compiled in when CALC_STATS is defined, which the
+ * CALC_STATS CMake option does. Otherwise the CALC_PROFILE_PHASE() macro
+ * expands to nothing, and the totals stay zero. When compiled in, nothing is
+ * recorded until set_enabled(true) is called, so the cost of a disabled
+ * profiler is a single relaxed load per phase.
+ *
+ * Each thread records into its own totals, without locking. A thread's totals
+ * are added to the overall totals when it ends, so totals() includes every
+ * finished thread and the calling thread, but not other running threads.
+ *
+ * When CALC_ALLOC_STATS is also defined, by the CMake option of the same name,
+ * the global operator new is replaced to count heap allocations. Allocations
+ * are attributed to the innermost phase being timed, whereas times include
+ * the phases run within a phase. Every allocation a thread makes is counted
+ * by threadAllocations(), whether or not the Profiler is enabled.
+ *****************************************************************************/
+class Profiler {
+public:
+  // Public constants
+
+  /// Whether instrumentation was compiled in
+#ifdef CALC_STATS
+  static constexpr bool isCompiled{true};
+#else
+  static constexpr bool isCompiled{false};
+#endif
+  /// Whether heap allocations are counted
+#ifdef CALC_ALLOC_STATS
+  static constexpr bool countsAllocations{true};
+#else
+  static constexpr bool countsAllocations{false};
+#endif
+  /// Number of values of Phase
+  static constexpr size_t numPhases{static_cast<size_t>(Phase::Calculate) + 1};
+
+  // Structs
+
+  /// Number of heap allocations, and the bytes they requested
+  struct Allocations {
+    std::uint64_t count{0};
+    std::uint64_t bytes{0};
+  };
+  /// Number of times a phase ran, the time spent in it and the allocations
+  /// made by it outside of the phases it ran
+  struct PhaseTotals {
+    std::uint64_t calls{0};
+    std::uint64_t nanoseconds{0};
+    Allocations allocations{};
+  };
+  /// Everything recorded by the Profiler
+  struct Totals {
+    std::array<PhaseTotals, numPhases> phases{}; /// Indexed by Phase
+    std::uint64_t numTrees{0}; /// Number of trees parsed
+    std::uint64_t numNodes{0}; /// Number of Nodes in every tree parsed
+    size_t maxNodes{0};        /// Largest number of Nodes in one tree
+    size_t maxDepth{0};        /// Most Nodes from a root to a leaf in one tree
+
+    /// Totals of a single phase
+    const PhaseTotals &operator[](Phase phase) const {
+      return phases[static_cast<size_t>(phase)];
+    }
+    /// Add the totals recorded elsewhere to these
+    Totals &operator+=(const Totals &other);
+  };
+
+  // Classes
+
+  /// Times a phase from its construction to its destruction
+  class Timer {
+  public:
+    // Constructors
+    explicit Timer(Phase phase)
+        : phase_(phase), outerPhase_(numPhases), isActive_(isEnabled()),
+          start_() {
+      if (isActive_) {
+        outerPhase_ = enterPhase_(phase);
+        start_ = std::chrono::steady_clock::now();
+      }
+    }
+    Timer(const Timer &) = delete;
+    Timer &operator=(const Timer &) = delete;
+    ~Timer();
+
+  private:
+    // Private variables
+    Phase phase_;
+    size_t outerPhase_; /// Phase being timed before this one, if any
+    bool isActive_; /// Whether the Profiler was enabled at construction
+    std::chrono::steady_clock::time_point start_;
+  };
+
+  // Public methods
+
+  /// Start or stop recording
+  static void set_enabled(bool isEnabled) {
+    isEnabled_.store(isEnabled, std::memory_order_relaxed);
+  }
+  /// Whether recording is on
+  static bool isEnabled() {
+    return isCompiled && isEnabled_.load(std::memory_order_relaxed);
+  }
+  /// Record the number of Nodes and the depth of a parsed tree
+  static void recordTree(size_t numNodes, size_t depth);
+  /// Count a heap allocation by the calling thread
+  static void recordAllocation(size_t bytes);
+  /// Every heap allocation made by the calling thread so far
+  static Allocations threadAllocations();
+  /// Totals of every finished thread and the calling thread
+  static Totals totals();
+  /// Clear the totals of every finished thread and the calling thread
+  static void reset();
+  /// Print the totals as a table, one phase per line
+  static void print(std::ostream &output);
+  /// Name of a phase as printed
+  static std::string_view phaseName(Phase phase);
+
+private:
+  // Structs
+
+  /// Totals of one thread, added to the overall totals when the thread ends
+  struct ThreadTotals {
+    Totals totals{};
+    ~ThreadTotals();
+  };
+
+  // Private methods
+
+  /// Totals of the calling thread
+  static Totals &threadTotals_();
+  /// Make a phase the calling thread's current one, returning the previous
+  /// phase, or numPhases if there was none
+  static size_t enterPhase_(Phase phase);
+  /// Add the allocations the calling thread made in each phase to totals
+  static void addPhaseAllocations_(Totals &totals);
+
+  // Private variables
+  static std::atomic<bool> isEnabled_;
+  static std::mutex mutex_;      /// Guards finishedTotals_
+  static Totals finishedTotals_; /// Totals of every finished thread
+  // Allocation counters are kept apart from ThreadTotals, as they must stay
+  // usable from operator new, even while threads start and end
+  /// Phase being timed on each thread, or numPhases outside of any phase
+  static thread_local size_t currentPhase_;
+  /// Allocations of each thread in each phase, then outside of any phase
+  static thread_local std::array<Allocations, numPhases + 1> phaseAllocations_;
+  /// Every allocation of each thread
+  static thread_local Allocations threadAllocations_;
+};
+
+/// Time the rest of the enclosing scope as a Phase, if profiling is compiled in
+#ifdef CALC_STATS
+#define CALC_PROFILE_PHASE(phase) Profiler::Timer profilerTimer_(phase)
+#else
+#define CALC_PROFILE_PHASE(phase)
+#endif
@@ -0,0 +1,182 @@
+// Internal headers
+#include "RangeReducer.h"
+#include "ThreadPool.h"
+
+// Standard library
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cmath>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+// Namespaces
+using namespace std::string_literals;
+
+/// Smaller of two values, or NaN if either is NaN
+static double smaller(double left, double right) {
+  return std::isnan(left) || right < left || std::isnan(right) ? right : left;
+}
+
+/// Larger of two values, or NaN if either is NaN
+static double larger(double left, double right) {
+  return std::isnan(left) || right > left || std::isnan(right) ? right : left;
+}
+
+/// Read a whole string as a double
+static bool readNumber(std::string_view text, double &value) {
+  const char *last{text.data() + text.size()};
+  std::from_chars_result read{std::from_chars(text.data(), last, value)};
+  return read.ec == std::errc() && read.ptr == last;
+}
+
+// ----------------------------------------------------------------------------
+// Public Methods
+// ----------------------------------------------------------------------------
+double RangeReducer::run(const std::string &expression, const Range &range,
+                         Reduction reduction) const {
+  size_t totalPoints{numPoints(range)};
+  CompiledExpression compiled(expression);
+  for (const std::string &variable : compiled.variables()) {
+    if (variable != range.variable)
+      throw std::runtime_error("Variable "s + variable + " has no value.");
+  }
+  size_t numChunks{(totalPoints + chunkSize_ - 1) / chunkSize_};
+  size_t chunksPerRound{std::max<size_t>(numThreads_, 1) *
+                        chunksInFlightPerThread_};
+  ThreadPool pool(numThreads_);
+  std::vector<Partial> partials;
+  Partial result{};
+  // Rounds of chunks bound the partial results kept however long the range
+  for (size_t firstChunk{0}; firstChunk < numChunks;
+       firstChunk += chunksPerRound) {
+    size_t numRoundChunks{std::min(chunksPerRound, numChunks - firstChunk)};
+    partials.assign(numRoundChunks, Partial{});
+    for (size_t i{0}; i < numRoundChunks; ++i) {
+      size_t firstPoint{(firstChunk + i) * chunkSize_};
+      size_t lastPoint{std::min(firstPoint + chunkSize_, totalPoints)};
+      pool.submit([this, &compiled, &range, &partials, i, firstPoint,
+                   lastPoint]() {
+        partials[i] = reduceChunk_(compiled, range, firstPoint, lastPoint);
+      });
+    }
+    pool.wait();
+    for (const Partial &partial : partials)
+      result.merge(partial);
+  }
+  switch (reduction) {
+  case Reduction::Sum:
+    return result.total();
+  case Reduction::Min:
+    return result.min;
+  case Reduction::Max:
+    return result.max;
+  case Reduction::Mean:
+    return result.total() / static_cast<double>(totalPoints);
+  }
+  throw std::runtime_error("Invalid reduction.");
+}
+
+RangeReducer::Range RangeReducer::parseRange(std::string_view text) {
+  Range range{};
+  size_t equals{text.find('=')};
+  size_t firstColon{text.find(':', equals)};
+  size_t secondColon{text.find(':', firstColon + 1)};
+  if (equals == 0 || equals == text.npos || firstColon == text.npos ||
+      secondColon == text.npos ||
+      !readNumber(text.substr(equals + 1, firstColon - equals - 1),
+                  range.start) ||
+      !readNumber(text.substr(firstColon + 1, secondColon - firstColon - 1),
+                  range.stop) ||
+      !readNumber(text.substr(secondColon + 1), range.step))
+    throw std::runtime_error("Range "s + std::string(text) +
+                             " is not of the form <variable>=<start>:<stop>:"
+                             "<step>.");
+  range.variable = text.substr(0, equals);
+  numPoints(range);
+  return range;
+}
+
+RangeReducer::Reduction RangeReducer::parseReduction(std::string_view text) {
+  if (text == "sum")
+    return Reduction::Sum;
+  if (text == "min")
+    return Reduction::Min;
+  if (text == "max")
+    return Reduction::Max;
+  if (text == "mean")
+    return Reduction::Mean;
+  throw std::runtime_error("Reduction "s + std::string(text) +
+                           " is not sum, min, max or mean.");
+}
+
+size_t RangeReducer::numPoints(const Range &range) {
+  if (!std::isfinite(range.start) || !std::isfinite(range.stop) ||
+      !std::isfinite(range.step) || range.step == 0.0)
+    throw std::runtime_error("Range needs finite bounds and a nonzero step.");
+  double numSteps{(range.stop - range.start) / range.step};
+  if (numSteps < 0.0)
+    throw std::runtime_error("Range step leads away from its stop.");
+  // Up to 2^53 points, every point's index is an exact double
+  if (!(numSteps < 0x1p53))
+    throw std::runtime_error("Range has too many points.");
+  // Allow for the rounding of numSteps, so 0:1:0.1 includes 1
+  numSteps *= 1.0 + 8 * std::numeric_limits<double>::epsilon();
+  return static_cast<size_t>(std::floor(numSteps)) + 1;
+}
+
+// ----------------------------------------------------------------------------
+// Private Methods
+// ----------------------------------------------------------------------------
+RangeReducer::Partial
+RangeReducer::reduceChunk_(const CompiledExpression &compiled,
+                           const Range &range, size_t firstPoint,
+                           size_t lastPoint) const {
+  std::array<double, batchSize_> points;
+  std::array<double, batchSize_> values;
+  std::array<std::span<const double>, 1> columns{points};
+  // Without the variable the expression is a constant, taking no columns
+  std::span<const std::span<const double>> bound{
+      columns.data(), compiled.variables().size()};
+  Partial partial{};
+  for (size_t first{firstPoint}; first < lastPoint; first += batchSize_) {
+    size_t size{std::min(batchSize_, lastPoint - first)};
+    // Each point from its index, so rounding errors don't accumulate
+    for (size_t i{0}; i < size; ++i)
+      points[i] = range.start + static_cast<double>(first + i) * range.step;
+    compiled.evaluateBatch(bound, std::span(values).first(size));
+    for (size_t i{0}; i < size; ++i)
+      partial.add(values[i]);
+  }
+  return partial;
+}
+
+void RangeReducer::Partial::add(double value) {
+  addToSum(value);
+  min = smaller(min, value);
+  max = larger(max, value);
+}
+
+void RangeReducer::Partial::merge(const Partial &next) {
+  addToSum(next.sum);
+  compensation += next.compensation;
+  min = smaller(min, next.min);
+  max = larger(max, next.max);
+}
+
+double RangeReducer::Partial::total() const {
+  // Infinite sums leave a NaN compensation
+  return std::isfinite(sum) ? sum + compensation : sum;
+}
+
+void RangeReducer::Partial::addToSum(double value) {
+  double newSum{sum + value};
+  // Neumaier's variant of Kahan summation, which also keeps the low digits of
+  // the sum so far when adding a larger value
+  if (std::abs(sum) >= std::abs(value))
+    compensation += (sum - newSum) + value;
+  else
+    compensation += (value - newSum) + sum;
+  sum = newSum;
+}
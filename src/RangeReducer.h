@@ -0,0 +1,100 @@
+#pragma once
+
+// Internal headers
+#include "CompiledExpression.h"
+
+// Standard library
+#include <cstddef>
+#include <limits>
+#include <string>
+#include <string_view>
+
+/******************************************************************************
+ * Reduces the values of an expression over a range of one of its variables,
+ * such as the sum of f(x) for x = a, a + step, ... up to b, on several
+ * threads.
+ *
+ * The expression is compiled once and evaluated in batches of points, whose
+ * values are folded straight into a running sum, minimum and maximum, so the
+ * values themselves are never stored. The range is split into chunks of a
+ * fixed number of points, evaluated in parallel on a ThreadPool, and the
+ * partial results of the chunks are combined in range order. Since neither
+ * the chunks nor the order they are combined in depend on the number of
+ * threads, neither does the result. Sums are compensated (Kahan-Babuska-
+ * Neumaier), so their error stays within a few roundings however many points
+ * the range has, and a NaN value makes every reduction NaN.
+ *****************************************************************************/
+class RangeReducer {
+public:
+  // Enums
+  enum class Reduction { Sum, Min, Max, Mean };
+
+  // Structs
+
+  /// Values of a variable from start to stop, inclusive, step apart
+  struct Range {
+    std::string variable{};
+    double start{0.0};
+    double stop{0.0};
+    double step{1.0};
+  };
+
+  // Constructors
+  explicit RangeReducer(size_t numThreads, size_t chunkSize = defaultChunkSize)
+      : numThreads_(numThreads), chunkSize_(chunkSize) {}
+
+  // Public constants
+
+  /// Number of points evaluated by each task
+  static constexpr size_t defaultChunkSize{size_t{1} << 16};
+
+  // Public methods
+
+  /// Reduce the values of an expression over a range of one of its variables
+  double run(const std::string &expression, const Range &range,
+             Reduction reduction) const;
+  /// Read a range written as <variable>=<start>:<stop>:<step>
+  static Range parseRange(std::string_view text);
+  /// Read a reduction written as sum, min, max or mean
+  static Reduction parseReduction(std::string_view text);
+  /// Number of points of a range, counting stop if it is a whole number of
+  /// steps from start up to rounding
+  static size_t numPoints(const Range &range);
+
+private:
+  // Structs
+
+  /// Reduction of the values of some consecutive points
+  struct Partial {
+    double sum{0.0};
+    double compensation{0.0}; /// Rounding error lost from sum
+    double min{std::numeric_limits<double>::infinity()};
+    double max{-std::numeric_limits<double>::infinity()};
+
+    /// Fold one more value in
+    void add(double value);
+    /// Fold in the values of points following these ones
+    void merge(const Partial &next);
+    /// Compensated sum of the values
+    double total() const;
+    /// Add a value to the compensated sum
+    void addToSum(double value);
+  };
+
+  // Private constants
+
+  /// Points evaluated together by CompiledExpression::evaluateBatch()
+  static constexpr size_t batchSize_{1024};
+  /// Chunks per thread evaluated before their results are combined
+  static constexpr size_t chunksInFlightPerThread_{4};
+
+  // Private methods
+
+  /// Reduce the points firstPoint to lastPoint - 1 of a range
+  Partial reduceChunk_(const CompiledExpression &compiled, const Range &range,
+                       size_t firstPoint, size_t lastPoint) const;
+
+  // Private variables
+  size_t numThreads_; /// Number of threads evaluating chunks
+  size_t chunkSize_;  /// Number of points in each chunk
+};
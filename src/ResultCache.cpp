@@ -0,0 +1,84 @@
+// Internal headers
+#include "ResultCache.h"
+
+// Standard library
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+
+// ----------------------------------------------------------------------------
+// Constructors
+// ----------------------------------------------------------------------------
+ResultCache::ResultCache(size_t capacity, size_t numShards)
+    : capacity_(capacity), shardCapacity_(0), shards_() {
+  if (capacity == 0)
+    throw std::runtime_error("Result cache capacity must be positive.");
+  // Every shard holds at least one result
+  numShards = std::clamp(numShards, size_t{1}, capacity);
+  shardCapacity_ = (capacity + numShards - 1) / numShards;
+  capacity_ = shardCapacity_ * numShards;
+  shards_ = std::vector<Shard>(numShards);
+}
+
+// ----------------------------------------------------------------------------
+// Public Methods
+// ----------------------------------------------------------------------------
+std::optional<double> ResultCache::find(std::string_view expression) {
+  Shard &shard{shard_(expression)};
+  std::lock_guard lock(shard.mutex);
+  auto match{shard.index.find(expression)};
+  if (match == shard.index.end()) {
+    misses_.fetch_add(1, std::memory_order_relaxed);
+    return std::nullopt;
+  }
+  hits_.fetch_add(1, std::memory_order_relaxed);
+  // Moving the entry to the front keeps iterators and key views valid
+  shard.entries.splice(shard.entries.begin(), shard.entries, match->second);
+  return match->second->result;
+}
+
+void ResultCache::insert(std::string_view expression, double result) {
+  Shard &shard{shard_(expression)};
+  std::lock_guard lock(shard.mutex);
+  auto match{shard.index.find(expression)};
+  if (match != shard.index.end()) {
+    match->second->result = result;
+    shard.entries.splice(shard.entries.begin(), shard.entries, match->second);
+    return;
+  }
+  shard.entries.push_front({.expression = std::string(expression),
+                            .result = result});
+  shard.index.emplace(shard.entries.front().expression,
+                      shard.entries.begin());
+  if (shard.entries.size() > shardCapacity_) {
+    shard.index.erase(shard.entries.back().expression);
+    shard.entries.pop_back();
+    evictions_.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+void ResultCache::clear() {
+  for (Shard &shard : shards_) {
+    std::lock_guard lock(shard.mutex);
+    shard.index.clear();
+    shard.entries.clear();
+  }
+}
+
+ResultCache::Statistics ResultCache::statistics() const {
+  Statistics statistics{.hits = hits_.load(std::memory_order_relaxed),
+                        .misses = misses_.load(std::memory_order_relaxed),
+                        .evictions = evictions_.load(std::memory_order_relaxed)};
+  for (const Shard &shard : shards_) {
+    std::lock_guard lock(shard.mutex);
+    statistics.size += shard.entries.size();
+  }
+  return statistics;
+}
+
+// ----------------------------------------------------------------------------
+// Private Methods
+// ----------------------------------------------------------------------------
+ResultCache::Shard &ResultCache::shard_(std::string_view expression) {
+  return shards_[std::hash<std::string_view>{}(expression) % shards_.size()];
+}
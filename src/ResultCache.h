@@ -0,0 +1,84 @@
+#pragma once
+
+// Standard library
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/******************************************************************************
+ * Bounded least-recently-used cache of expression results.
+ *
+ * Results are stored under the normalized text of their expression, as
+ * produced by Expression::validate(), so that inputs differing only in
+ * whitespace or redundant outer brackets share an entry. Once the cache is
+ * full, storing a new result evicts the least recently used one. Entries are
+ * spread over several independently locked shards, each a strict LRU list, so
+ * that threads looking up different expressions rarely wait on each other.
+ * Hits, misses and evictions are counted for the whole cache.
+ *****************************************************************************/
+class ResultCache {
+public:
+  // Structs
+
+  /// Counters describing how well the cache has performed
+  struct Statistics {
+    std::uint64_t hits{0};
+    std::uint64_t misses{0};
+    std::uint64_t evictions{0};
+    size_t size{0}; /// Number of results currently stored
+  };
+
+  // Constructors
+  explicit ResultCache(size_t capacity, size_t numShards = 16);
+
+  // Public methods
+
+  /// The cached result of an expression, if any, marking it recently used
+  std::optional<double> find(std::string_view expression);
+  /// Store the result of an expression, evicting the least recently used
+  /// result of its shard if the shard is full
+  void insert(std::string_view expression, double result);
+  /// Remove every result, keeping the counters
+  void clear();
+  /// Current values of the counters
+  Statistics statistics() const;
+  /// Maximum number of results stored at once
+  size_t capacity() const { return capacity_; }
+
+private:
+  // Structs
+
+  /// A cached result, together with its key
+  struct Entry {
+    std::string expression;
+    double result;
+  };
+  /// Independently locked part of the cache
+  struct Shard {
+    mutable std::mutex mutex{};
+    /// Entries from most to least recently used
+    std::list<Entry> entries{};
+    /// Position of each entry in entries, keyed by a view of its expression
+    std::unordered_map<std::string_view, std::list<Entry>::iterator> index{};
+  };
+
+  // Private methods
+
+  /// The shard responsible for an expression
+  Shard &shard_(std::string_view expression);
+
+  // Private variables
+  size_t capacity_;      /// Maximum number of results in the whole cache
+  size_t shardCapacity_; /// Maximum number of results in each shard
+  std::vector<Shard> shards_;
+  std::atomic<std::uint64_t> hits_{0};
+  std::atomic<std::uint64_t> misses_{0};
+  std::atomic<std::uint64_t> evictions_{0};
+};
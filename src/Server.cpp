@@ -0,0 +1,366 @@
+// Internal headers
+#include "Server.h"
+#include "StreamEvaluator.h"
+#include "ThreadPool.h"
+
+// Standard library
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <utility>
+
+// POSIX
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Namespaces
+using namespace std::string_literals;
+
+/// epoll_event data of the listening socket and the eventfd, below every
+/// connection id
+static constexpr std::uint64_t listenId{0};
+static constexpr std::uint64_t wakeId{1};
+
+/// Payload size in the header at the start of a buffer of at least
+/// Server::headerSize bytes
+static size_t payloadSize(std::string_view buffer) {
+  size_t size{0};
+  for (size_t i{0}; i < Server::headerSize; ++i)
+    size = size << 8 | static_cast<unsigned char>(buffer[i]);
+  return size;
+}
+
+/// Throw the error of the last failed system call
+[[noreturn]] static void throwSystemError(const std::string &what) {
+  throw std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+// ----------------------------------------------------------------------------
+// Constructors
+// ----------------------------------------------------------------------------
+Server::Server(const std::string &path, size_t numThreads, int precision,
+               std::shared_ptr<ResultCache> cache)
+    : path_(path), precision_(precision), cache_(std::move(cache)),
+      fastMath_(false), scalarType_(ScalarType::Double), listenFd_(-1),
+      epollFd_(-1), wakeFd_(-1), isAcceptPaused_(false), connections_(),
+      nextId_(2), mutex_(), finished_(), pool_() {
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  if (path.empty() || path.size() >= sizeof(address.sun_path))
+    throw std::runtime_error("Invalid socket path "s + path +
+                             ": must have 1 to " +
+                             std::to_string(sizeof(address.sun_path) - 1) +
+                             " characters");
+  std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+  try {
+    listenFd_ = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listenFd_ < 0)
+      throwSystemError("Could not create socket");
+    // A socket file left behind by an earlier server would make bind() fail
+    ::unlink(path.c_str());
+    if (::bind(listenFd_, reinterpret_cast<const sockaddr *>(&address),
+               sizeof(address)) != 0)
+      throwSystemError("Could not bind socket "s + path);
+    if (::listen(listenFd_, SOMAXCONN) != 0)
+      throwSystemError("Could not listen on socket "s + path);
+    epollFd_ = ::epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd_ < 0)
+      throwSystemError("Could not create epoll instance");
+    wakeFd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wakeFd_ < 0)
+      throwSystemError("Could not create eventfd");
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.u64 = listenId;
+    if (::epoll_ctl(epollFd_, EPOLL_CTL_ADD, listenFd_, &event) != 0)
+      throwSystemError("Could not watch socket");
+    event.data.u64 = wakeId;
+    if (::epoll_ctl(epollFd_, EPOLL_CTL_ADD, wakeFd_, &event) != 0)
+      throwSystemError("Could not watch eventfd");
+  } catch (...) {
+    for (int fd : {listenFd_, epollFd_, wakeFd_})
+      if (fd >= 0)
+        ::close(fd);
+    throw;
+  }
+  pool_ = std::make_unique<ThreadPool>(numThreads);
+}
+
+Server::~Server() {
+  // Finish the tasks in flight while everything they use still exists
+  pool_.reset();
+  for (auto &[id, connection] : connections_)
+    ::close(connection.fd);
+  ::close(wakeFd_);
+  ::close(epollFd_);
+  ::close(listenFd_);
+  ::unlink(path_.c_str());
+}
+
+// ----------------------------------------------------------------------------
+// Public Methods
+// ----------------------------------------------------------------------------
+void Server::run() {
+  std::array<epoll_event, 64> events;
+  while (!isStopping_.load(std::memory_order_acquire)) {
+    int numEvents{::epoll_wait(epollFd_, events.data(),
+                               static_cast<int>(events.size()), -1)};
+    if (numEvents < 0) {
+      if (errno == EINTR)
+        continue;
+      throwSystemError("Could not wait for events");
+    }
+    for (const epoll_event &event :
+         std::span(events.data(), static_cast<size_t>(numEvents))) {
+      std::uint64_t id{event.data.u64};
+      if (id == listenId) {
+        accept_();
+        continue;
+      }
+      if (id == wakeId) {
+        collectFinished_();
+        continue;
+      }
+      // Connections closed earlier in this loop may still have events
+      auto found{connections_.find(id)};
+      if (found == connections_.end())
+        continue;
+      Connection &connection{found->second};
+      bool isOpen{true};
+      if (event.events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+        isOpen = read_(id, connection);
+      if (isOpen && (event.events & EPOLLOUT))
+        isOpen = write_(id, connection);
+      if (!isOpen)
+        close_(id);
+    }
+  }
+}
+
+void Server::stop() {
+  isStopping_.store(true, std::memory_order_release);
+  // Only async-signal-safe calls from here on
+  std::uint64_t one{1};
+  [[maybe_unused]] auto written{::write(wakeFd_, &one, sizeof(one))};
+}
+
+void Server::appendFrame(std::string &buffer, std::string_view payload) {
+  std::uint32_t size{static_cast<std::uint32_t>(payload.size())};
+  for (int shift{24}; shift >= 0; shift -= 8)
+    buffer += static_cast<char>((size >> shift) & 0xFF);
+  buffer += payload;
+}
+
+bool Server::takeFrame(std::string_view &buffer, std::string_view &payload) {
+  if (buffer.size() < headerSize)
+    return false;
+  size_t size{payloadSize(buffer)};
+  if (buffer.size() < headerSize + size)
+    return false;
+  payload = buffer.substr(headerSize, size);
+  buffer.remove_prefix(headerSize + size);
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// Private Methods
+// ----------------------------------------------------------------------------
+void Server::accept_() {
+  while (true) {
+    int fd{::accept4(listenFd_, nullptr, nullptr,
+                     SOCK_NONBLOCK | SOCK_CLOEXEC)};
+    if (fd < 0) {
+      // A connection reset before being accepted leaves the others pending
+      if (errno == EINTR || errno == ECONNABORTED)
+        continue;
+      // Out of descriptors, the listening socket would stay readable and
+      // wake the event loop at once, so it is ignored until one is closed
+      if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS ||
+          errno == ENOMEM)
+        watchListener_(false);
+      return;
+    }
+    std::uint64_t id{nextId_++};
+    epoll_event event{};
+    event.events = EPOLLIN | EPOLLRDHUP;
+    event.data.u64 = id;
+    if (::epoll_ctl(epollFd_, EPOLL_CTL_ADD, fd, &event) != 0) {
+      ::close(fd);
+      continue;
+    }
+    Connection &connection{connections_[id]};
+    connection.fd = fd;
+    connection.events = event.events;
+  }
+}
+
+bool Server::read_(std::uint64_t id, Connection &connection) {
+  // Reading at most one largest frame per pass bounds the input buffered, as
+  // what remains is incomplete; epoll reports the rest of the socket again
+  constexpr size_t maxInput{headerSize + maxRequestSize};
+  std::array<char, 1 << 16> chunk;
+  while (!connection.isReadClosed && connection.input.size() < maxInput) {
+    size_t toRead{std::min(chunk.size(), maxInput - connection.input.size())};
+    ssize_t numRead{::read(connection.fd, chunk.data(), toRead)};
+    if (numRead > 0) {
+      connection.input.append(chunk.data(), static_cast<size_t>(numRead));
+    } else if (numRead == 0) {
+      connection.isReadClosed = true;
+    } else if (errno == EINTR) {
+      continue;
+    } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      break;
+    } else {
+      return false;
+    }
+  }
+  std::string_view rest{connection.input};
+  std::string_view request;
+  std::shared_ptr<Batch> batch;
+  while (rest.size() >= headerSize) {
+    if (payloadSize(rest) > maxRequestSize)
+      return false;
+    if (!takeFrame(rest, request))
+      break;
+    if (!batch) {
+      batch = std::make_shared<Batch>();
+      connection.batches.push_back(batch);
+    }
+    batch->requests.emplace_back(request);
+    if (batch->requests.size() == requestsPerTask_) {
+      submit_(id, std::move(batch));
+      batch.reset();
+    }
+  }
+  if (batch)
+    submit_(id, std::move(batch));
+  connection.input.erase(0, connection.input.size() - rest.size());
+  return write_(id, connection);
+}
+
+bool Server::write_(std::uint64_t id, Connection &connection) {
+  while (!connection.batches.empty() &&
+         connection.batches.front()->isDone.load(std::memory_order_acquire)) {
+    Batch &batch{*connection.batches.front()};
+    if (batch.responses.empty())
+      return false;
+    connection.output += batch.responses;
+    connection.batches.pop_front();
+  }
+  size_t numWritten{0};
+  while (numWritten < connection.output.size()) {
+    // MSG_NOSIGNAL turns a vanished client into EPIPE instead of SIGPIPE
+    ssize_t result{::send(connection.fd, connection.output.data() + numWritten,
+                          connection.output.size() - numWritten,
+                          MSG_NOSIGNAL)};
+    if (result >= 0) {
+      numWritten += static_cast<size_t>(result);
+    } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      break;
+    } else if (errno != EINTR) {
+      return false;
+    }
+  }
+  connection.output.erase(0, numWritten);
+  if (connection.isReadClosed && connection.batches.empty() &&
+      connection.output.empty())
+    return false;
+  // Only wake up for input while the client may send more and has not let
+  // too many responses pile up, and for writability while output is waiting.
+  // Finished batches and written output call this again to resume reading.
+  bool isBacklogged{connection.output.size() > maxQueuedOutput_ ||
+                    connection.batches.size() > maxQueuedBatches_};
+  std::uint32_t events{
+      (connection.isReadClosed || isBacklogged ? 0u : EPOLLIN | EPOLLRDHUP) |
+      (connection.output.empty() ? 0u : EPOLLOUT)};
+  if (events != connection.events) {
+    epoll_event event{};
+    event.events = events;
+    event.data.u64 = id;
+    if (::epoll_ctl(epollFd_, EPOLL_CTL_MOD, connection.fd, &event) != 0)
+      return false;
+    connection.events = events;
+  }
+  return true;
+}
+
+void Server::submit_(std::uint64_t id, std::shared_ptr<Batch> batch) {
+  pool_->submit([this, id, batch = std::move(batch)]() {
+    try {
+      evaluate_(*batch);
+    } catch (...) {
+      // Out of memory: the connection is closed once its turn comes
+      batch->responses.clear();
+    }
+    batch->isDone.store(true, std::memory_order_release);
+    {
+      std::lock_guard lock(mutex_);
+      finished_.push_back(id);
+    }
+    std::uint64_t one{1};
+    [[maybe_unused]] auto written{::write(wakeFd_, &one, sizeof(one))};
+  });
+}
+
+void Server::collectFinished_() {
+  std::uint64_t count;
+  [[maybe_unused]] auto numRead{::read(wakeFd_, &count, sizeof(count))};
+  std::vector<std::uint64_t> ids;
+  {
+    std::lock_guard lock(mutex_);
+    ids.swap(finished_);
+  }
+  for (std::uint64_t id : ids) {
+    auto found{connections_.find(id)};
+    if (found != connections_.end() && !write_(id, found->second))
+      close_(id);
+  }
+}
+
+void Server::evaluate_(Batch &batch) const {
+  StreamEvaluator evaluator(OutputBuffer(), precision_, cache_);
+  evaluator.set_fast_math(fastMath_);
+  evaluator.set_scalar_type(scalarType_);
+  std::vector<size_t> ends;
+  ends.reserve(batch.requests.size());
+  for (const std::string &request : batch.requests) {
+    evaluator.evaluateLine(request);
+    ends.push_back(evaluator.output().view().size());
+  }
+  std::string_view text{evaluator.output().view()};
+  std::string responses;
+  responses.reserve(text.size() + headerSize * ends.size());
+  size_t start{0};
+  for (size_t end : ends) {
+    // Each response is its line without the newline
+    appendFrame(responses, text.substr(start, end - 1 - start));
+    start = end;
+  }
+  batch.responses = std::move(responses);
+}
+
+void Server::close_(std::uint64_t id) {
+  auto found{connections_.find(id)};
+  if (found == connections_.end())
+    return;
+  // Batches still being evaluated keep themselves alive and are then ignored
+  ::epoll_ctl(epollFd_, EPOLL_CTL_DEL, found->second.fd, nullptr);
+  ::close(found->second.fd);
+  connections_.erase(found);
+  if (isAcceptPaused_)
+    watchListener_(true);
+}
+
+void Server::watchListener_(bool isWatched) {
+  epoll_event event{};
+  event.events = isWatched ? EPOLLIN : 0u;
+  event.data.u64 = listenId;
+  if (::epoll_ctl(epollFd_, EPOLL_CTL_MOD, listenFd_, &event) == 0)
+    isAcceptPaused_ = !isWatched;
+}
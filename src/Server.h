@@ -0,0 +1,148 @@
+#pragma once
+
+// Internal headers
+#include "CompiledExpression.h"
+
+// Standard library
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+class ResultCache;
+class ThreadPool;
+
+/******************************************************************************
+ * Long-lived server evaluating expressions sent over a Unix domain socket.
+ *
+ * Every request and response is a frame: the length of its payload as a 4-byte
+ * big-endian unsigned integer, followed by that many bytes. A request's
+ * payload is an expression, and its response's payload is what
+ * StreamEvaluator would print for it without the newline: the result at the
+ * given precision, "error: " followed by the reason it could not be
+ * calculated, or nothing for an empty expression. Clients may send any number
+ * of requests without waiting, and responses come back in request order.
+ *
+ * One thread runs an epoll event loop accepting connections, reading requests
+ * and writing responses without blocking. The requests read from a connection
+ * at once are evaluated in batches, each a task on a ThreadPool, so several
+ * connections, and long pipelines of requests, are served concurrently.
+ * Workers hand finished tasks back to the event loop through an eventfd. A
+ * request longer than maxRequestSize closes its connection, and a connection
+ * never buffers more than one frame of that size. A client which sends
+ * faster than it reads its responses is not read from until they drain.
+ *****************************************************************************/
+class Server {
+public:
+  // Public constants
+
+  /// Bytes of the length prefix of every frame
+  static constexpr size_t headerSize{4};
+  /// Largest request payload accepted, in bytes
+  static constexpr size_t maxRequestSize{size_t{1} << 20};
+
+  // Constructors
+
+  /// Listen on a new socket at path, replacing any socket file already there
+  Server(const std::string &path, size_t numThreads, int precision = 6,
+         std::shared_ptr<ResultCache> cache = nullptr);
+  Server(const Server &) = delete;
+  Server &operator=(const Server &) = delete;
+  /// Close every connection and remove the socket file
+  ~Server();
+
+  // Public methods
+
+  /// Serve connections until stop() is called
+  void run();
+  /// Make run() return once it has written the responses already finished.
+  /// Safe to call from any thread, and from a signal handler.
+  void stop();
+  /// Path of the listening socket
+  const std::string &path() const { return path_; }
+  /// Calculate functions as StreamEvaluator::set_fast_math() does
+  void set_fast_math(bool fastMath) { fastMath_ = fastMath; }
+  /// Calculate in a type as StreamEvaluator::set_scalar_type() does
+  void set_scalar_type(ScalarType scalarType) { scalarType_ = scalarType; }
+  /// Append a frame holding payload to buffer
+  static void appendFrame(std::string &buffer, std::string_view payload);
+  /// Move buffer past its first frame and view that frame's payload,
+  /// returning false if buffer doesn't start with a whole frame
+  static bool takeFrame(std::string_view &buffer, std::string_view &payload);
+
+private:
+  // Private constants
+
+  /// Most requests evaluated by one task, so that many requests read from one
+  /// connection at once are still spread over the workers
+  static constexpr size_t requestsPerTask_{256};
+  /// Bytes of responses a connection may have waiting to be written, and
+  /// batches it may have waiting to be evaluated, before it stops being read
+  static constexpr size_t maxQueuedOutput_{4 * maxRequestSize};
+  static constexpr size_t maxQueuedBatches_{64};
+
+  // Structs
+
+  /// Consecutive requests of a connection, evaluated by one task
+  struct Batch {
+    std::vector<std::string> requests{};
+    std::string responses{}; /// Frames of every response, once isDone
+    std::atomic<bool> isDone{false};
+  };
+  /// State of one client connection
+  struct Connection {
+    int fd{-1};
+    std::string input{};  /// Bytes read but not yet forming a whole frame
+    std::string output{}; /// Response frames not yet written
+    std::deque<std::shared_ptr<Batch>> batches{}; /// Unanswered, in order
+    bool isReadClosed{false}; /// Whether the client has finished sending
+    std::uint32_t events{0};  /// Events epoll watches for
+  };
+
+  // Private methods
+
+  /// Accept every pending connection
+  void accept_();
+  /// Start or stop watching the listening socket for connections
+  void watchListener_(bool isWatched);
+  /// Read and submit the requests available on a connection, returning
+  /// false if it should be closed
+  bool read_(std::uint64_t id, Connection &connection);
+  /// Queue the responses of finished batches, in order, and write as much
+  /// output as possible, returning false if the connection should be closed
+  bool write_(std::uint64_t id, Connection &connection);
+  /// Evaluate a batch of a connection on the pool
+  void submit_(std::uint64_t id, std::shared_ptr<Batch> batch);
+  /// Hand the finished batches of connections to the event loop
+  void collectFinished_();
+  /// Evaluate every request of a batch
+  void evaluate_(Batch &batch) const;
+  /// Stop watching a connection and close it
+  void close_(std::uint64_t id);
+
+  // Private variables
+  std::string path_;  /// Socket file, removed on destruction
+  int precision_;     /// Number of significant digits in results
+  std::shared_ptr<ResultCache> cache_; /// Results shared by all workers
+  bool fastMath_;     /// Whether functions use FastMath kernels
+  ScalarType scalarType_; /// Type results are calculated in
+  int listenFd_;      /// Listening socket
+  int epollFd_;       /// Event loop's epoll instance
+  int wakeFd_;        /// eventfd signalled by workers and stop()
+  /// Whether accepting stopped for lack of descriptors, until one is closed
+  bool isAcceptPaused_;
+  std::atomic<bool> isStopping_{false};
+  std::unordered_map<std::uint64_t, Connection> connections_; /// By id
+  std::uint64_t nextId_; /// Id of the next connection accepted
+  std::mutex mutex_;     /// Guards finished_
+  /// Ids of connections with batches finished since last collected
+  std::vector<std::uint64_t> finished_;
+  /// Workers, destroyed first so no task outlives the members above
+  std::unique_ptr<ThreadPool> pool_;
+};
@@ -0,0 +1,72 @@
+// Internal headers
+#include "StreamEvaluator.h"
+
+// Standard library
+#include <exception>
+#include <stdexcept>
+#include <string>
+
+// ----------------------------------------------------------------------------
+// Public Methods
+// ----------------------------------------------------------------------------
+size_t StreamEvaluator::run(std::istream &input) {
+  size_t numErrors{0};
+  std::string line;
+  while (true) {
+    // Only flush when the next read could block, so that results reach a
+    // waiting reader without flushing once per line of a large input
+    if (input.rdbuf()->in_avail() <= 0)
+      output_.flush();
+    if (!std::getline(input, line))
+      break;
+    if (!evaluateLine(line))
+      ++numErrors;
+  }
+  output_.flush();
+  return numErrors;
+}
+
+bool StreamEvaluator::evaluateLine(std::string_view line) {
+  // Accept Windows line endings
+  if (!line.empty() && line.back() == '\r')
+    line.remove_suffix(1);
+  if (line.empty()) {
+    output_ << '\n';
+    return true;
+  }
+  if (scalarType_ == ScalarType::Float)
+    return evaluateLineAs_<float>(line);
+  if (scalarType_ == ScalarType::LongDouble)
+    return evaluateLineAs_<long double>(line);
+  double result;
+  try {
+    expression_.set_expression(std::string(line));
+    result = expression_.result();
+  } catch (const std::exception &e) {
+    output_ << "error: " << e.what() << '\n';
+    return false;
+  }
+  // Failing to write the output is not an error of the expression
+  output_.appendNumber(result, precision_) << '\n';
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// Private Methods
+// ----------------------------------------------------------------------------
+template <typename Scalar>
+bool StreamEvaluator::evaluateLineAs_(std::string_view line) {
+  Scalar result;
+  try {
+    BasicCompiledExpression<Scalar> compiled{std::string(line)};
+    if (!compiled.variables().empty())
+      throw std::runtime_error("Variable " + compiled.variables().front() +
+                               " has no value.");
+    result = compiled.evaluate();
+  } catch (const std::exception &e) {
+    output_ << "error: " << e.what() << '\n';
+    return false;
+  }
+  output_.appendNumber(result, precision_) << '\n';
+  return true;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+// Internal headers
+#include "CompiledExpression.h"
+#include "Expression.h"
+#include "OutputBuffer.h"
+
+// Standard library
+#include <cstddef>
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <string_view>
+#include <utility>
+
+/******************************************************************************
+ * Evaluates a stream of newline-delimited expressions, one result per line.
+ *
+ * Every input line produces exactly one output line: the result at the given
+ * precision, an empty line for an empty input line, or "error: " followed by
+ * the reason the expression could not be calculated. A bad line therefore
+ * never ends the stream, and results stay aligned with their inputs. Results
+ * are formatted into an OutputBuffer, which is written out in large blocks
+ * while more input is already available, and flushed before waiting on
+ * further input, so a single long-lived process can serve a pipeline without
+ * paying for a flush per line. A precision of OutputBuffer::shortest prints
+ * the shortest form of each result which reads back exactly. With a
+ * ResultCache, repeated expressions are only calculated once. Expressions are
+ * calculated as doubles unless another ScalarType is set, in which case each
+ * is compiled into a BasicCompiledExpression of that type.
+ *****************************************************************************/
+class StreamEvaluator {
+public:
+  // Constructors
+  explicit StreamEvaluator(OutputBuffer output, int precision = 6,
+                           std::shared_ptr<ResultCache> cache = nullptr)
+      : output_(std::move(output)), precision_(precision),
+        scalarType_(ScalarType::Double), expression_() {
+    expression_.set_cache(std::move(cache));
+  }
+  explicit StreamEvaluator(std::ostream &output, int precision = 6,
+                           std::shared_ptr<ResultCache> cache = nullptr)
+      : StreamEvaluator(OutputBuffer(output), precision, std::move(cache)) {}
+
+  // Public methods
+
+  /// Evaluate every line until the end of the input, returning the number of
+  /// lines whose expression could not be calculated
+  size_t run(std::istream &input);
+  /// Evaluate one expression and write its result or error as a line,
+  /// returning whether it was calculated
+  bool evaluateLine(std::string_view line);
+  /// Buffer the results are written to
+  OutputBuffer &output() { return output_; }
+  /// Calculate functions with the cheapest FastMath kernels keeping the
+  /// precision of the results, or with the std:: functions
+  void set_fast_math(bool fastMath) {
+    expression_.set_fast_math(fastMath ? precision_ : FastMath::fullPrecision);
+  }
+  /// Calculate in a floating-point type other than double
+  void set_scalar_type(ScalarType scalarType) { scalarType_ = scalarType; }
+
+private:
+  // Private methods
+
+  /// Evaluate one expression in a Scalar type and write its result or error
+  /// as a line, returning whether it was calculated
+  template <typename Scalar> bool evaluateLineAs_(std::string_view line);
+
+  // Private variables
+  OutputBuffer output_;    /// Destination of one result line per input line
+  int precision_;          /// Number of significant digits in results
+  ScalarType scalarType_;  /// Type results are calculated in
+  Expression expression_;  /// Reused for every line to keep its buffers
+};
@@ -0,0 +1,107 @@
+// Internal headers
+#include "ThreadPool.h"
+
+// Standard library
+#include <utility>
+
+// ----------------------------------------------------------------------------
+// Constructors
+// ----------------------------------------------------------------------------
+ThreadPool::ThreadPool(size_t numThreads)
+    : queues_(numThreads == 0 ? 1 : numThreads), threads_(), mutex_(),
+      taskAvailable_(), allFinished_(), error_() {
+  threads_.reserve(queues_.size());
+  for (size_t i{0}; i < queues_.size(); ++i)
+    threads_.emplace_back(&ThreadPool::work_, this, i);
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard lock(mutex_);
+    isStopping_ = true;
+  }
+  taskAvailable_.notify_all();
+  for (std::thread &thread : threads_)
+    thread.join();
+}
+
+// ----------------------------------------------------------------------------
+// Public Methods
+// ----------------------------------------------------------------------------
+void ThreadPool::submit(std::function<void()> task) {
+  size_t index;
+  {
+    std::lock_guard lock(mutex_);
+    index = nextQueue_;
+    nextQueue_ = (nextQueue_ + 1) % queues_.size();
+    ++numUnfinished_;
+  }
+  {
+    std::lock_guard lock(queues_[index].mutex);
+    queues_[index].tasks.push_back(std::move(task));
+  }
+  // A task only counts as queued once it can be found in a queue
+  {
+    std::lock_guard lock(mutex_);
+    ++numQueued_;
+  }
+  taskAvailable_.notify_one();
+}
+
+void ThreadPool::wait() {
+  std::unique_lock lock(mutex_);
+  allFinished_.wait(lock, [this]() { return numUnfinished_ == 0; });
+  if (error_)
+    std::rethrow_exception(std::exchange(error_, nullptr));
+}
+
+// ----------------------------------------------------------------------------
+// Private Methods
+// ----------------------------------------------------------------------------
+void ThreadPool::work_(size_t index) {
+  while (true) {
+    {
+      std::unique_lock lock(mutex_);
+      taskAvailable_.wait(lock,
+                          [this]() { return numQueued_ > 0 || isStopping_; });
+      if (numQueued_ == 0)
+        return;
+      // Claim one of the queued tasks, which takeTask_() is then sure to find
+      --numQueued_;
+    }
+    std::function<void()> task{takeTask_(index)};
+    try {
+      task();
+    } catch (...) {
+      std::lock_guard lock(mutex_);
+      if (!error_)
+        error_ = std::current_exception();
+    }
+    std::lock_guard lock(mutex_);
+    if (--numUnfinished_ == 0)
+      allFinished_.notify_all();
+  }
+}
+
+std::function<void()> ThreadPool::takeTask_(size_t index) {
+  while (true) {
+    {
+      Queue &own{queues_[index]};
+      std::lock_guard lock(own.mutex);
+      if (!own.tasks.empty()) {
+        std::function<void()> task{std::move(own.tasks.front())};
+        own.tasks.pop_front();
+        return task;
+      }
+    }
+    for (size_t offset{1}; offset < queues_.size(); ++offset) {
+      Queue &victim{queues_[(index + offset) % queues_.size()]};
+      std::lock_guard lock(victim.mutex);
+      if (!victim.tasks.empty()) {
+        std::function<void()> task{std::move(victim.tasks.back())};
+        victim.tasks.pop_back();
+        return task;
+      }
+    }
+  }
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+// Standard library
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/******************************************************************************
+ * Fixed set of threads running submitted tasks, with work stealing.
+ *
+ * Every thread owns a queue of tasks, and submitted tasks are dealt out to the
+ * queues in turn. A thread runs the tasks of its own queue in the order they
+ * were submitted, and once its queue is empty it steals the most recently
+ * submitted task from another thread's queue. Threads finishing their share of
+ * the work early therefore keep busy until every queue is empty, while each
+ * queue's lock is normally only taken by its owner.
+ *****************************************************************************/
+class ThreadPool {
+public:
+  // Constructors
+  explicit ThreadPool(size_t numThreads);
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+  /// Finish every submitted task, then stop the threads
+  ~ThreadPool();
+
+  // Public methods
+
+  /// Queue a task to be run on one of the threads
+  void submit(std::function<void()> task);
+  /// Wait until every submitted task has finished, rethrowing the first
+  /// exception thrown by a task, if any
+  void wait();
+  /// Number of threads running tasks
+  size_t size() const { return threads_.size(); }
+
+private:
+  // Structs
+
+  /// Tasks waiting to be run, owned by one thread
+  struct Queue {
+    std::mutex mutex{};
+    std::deque<std::function<void()>> tasks{};
+  };
+
+  // Private methods
+
+  /// Run tasks on thread number index until the pool is destroyed
+  void work_(size_t index);
+  /// Take a task from the thread's own queue, or else steal one
+  std::function<void()> takeTask_(size_t index);
+
+  // Private variables
+  std::vector<Queue> queues_;        /// One queue per thread
+  std::vector<std::thread> threads_; /// Threads running tasks
+  std::mutex mutex_;                 /// Guards the counters below
+  std::condition_variable taskAvailable_; /// Signalled when tasks are queued
+  std::condition_variable allFinished_;   /// Signalled when no tasks remain
+  size_t numQueued_{0};      /// Tasks in the queues not yet taken by a thread
+  size_t numUnfinished_{0};  /// Tasks submitted but not yet finished
+  size_t nextQueue_{0};      /// Queue receiving the next submitted task
+  bool isStopping_{false};   /// Whether threads should exit once idle
+  std::exception_ptr error_; /// First exception thrown by a task
+};
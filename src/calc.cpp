@@ -0,0 +1,127 @@
+// Internal headers
+#include "calc.h"
+#include "JitExpression.h"
+
+// Standard library
+#include <algorithm>
+#include <array>
+#include <exception>
+#include <new>
+#include <span>
+#include <string_view>
+#include <vector>
+
+/// A compiled expression, behind the opaque pointer of the C interface
+struct calc_expression {
+  JitExpression jit;
+};
+
+/// Description of the last failure on this thread. A fixed buffer, so that
+/// recording a failure can't fail itself, eg. when memory ran out.
+static thread_local std::array<char, 512> lastError{};
+
+/// Record a failure for calc_last_error(), truncating long descriptions
+static calc_status fail(calc_status status, std::string_view what) noexcept {
+  size_t size{std::min(what.size(), lastError.size() - 1)};
+  std::copy_n(what.data(), size, lastError.data());
+  lastError[size] = '\0';
+  return status;
+}
+
+/// Run body, turning any exception it throws into a failed status
+template <typename Body> static calc_status guard(Body &&body) noexcept {
+  try {
+    calc_status status{body()};
+    if (status == CALC_OK)
+      lastError[0] = '\0';
+    return status;
+  } catch (const std::bad_alloc &) {
+    return fail(CALC_ERROR_OUT_OF_MEMORY, "Out of memory.");
+  } catch (const std::exception &e) {
+    return fail(CALC_ERROR_EXPRESSION, e.what());
+  } catch (...) {
+    return fail(CALC_ERROR_INTERNAL, "Unknown error.");
+  }
+}
+
+/// Fail unless at least one value is given for each variable
+static calc_status checkBindings(const calc_expression *compiled,
+                                 size_t numBindings) noexcept {
+  size_t numVariables{compiled->jit.variables().size()};
+  if (numBindings >= numVariables)
+    return CALC_OK;
+  return fail(CALC_ERROR_INVALID_ARGUMENT,
+              "Expression has more variables than values given.");
+}
+
+// ----------------------------------------------------------------------------
+// C interface
+// ----------------------------------------------------------------------------
+int calc_abi_version(void) noexcept { return CALC_ABI_VERSION; }
+
+calc_status calc_compile(const char *expression,
+                         calc_expression **compiled) noexcept {
+  if (compiled == nullptr)
+    return fail(CALC_ERROR_INVALID_ARGUMENT, "No result pointer given.");
+  *compiled = nullptr;
+  if (expression == nullptr)
+    return fail(CALC_ERROR_INVALID_ARGUMENT, "No expression given.");
+  return guard([&]() {
+    *compiled = new calc_expression{JitExpression(expression)};
+    return CALC_OK;
+  });
+}
+
+void calc_free(calc_expression *compiled) noexcept { delete compiled; }
+
+size_t calc_variable_count(const calc_expression *compiled) noexcept {
+  return compiled == nullptr ? 0 : compiled->jit.variables().size();
+}
+
+const char *calc_variable_name(const calc_expression *compiled,
+                               size_t index) noexcept {
+  if (compiled == nullptr || index >= compiled->jit.variables().size())
+    return nullptr;
+  return compiled->jit.variables()[index].c_str();
+}
+
+calc_status calc_evaluate(const calc_expression *compiled,
+                          const double *bindings, size_t num_bindings,
+                          double *result) noexcept {
+  if (compiled == nullptr || result == nullptr ||
+      (bindings == nullptr && num_bindings > 0))
+    return fail(CALC_ERROR_INVALID_ARGUMENT, "Null pointer given.");
+  if (calc_status status{checkBindings(compiled, num_bindings)};
+      status != CALC_OK)
+    return status;
+  return guard([&]() {
+    *result = compiled->jit.evaluate({bindings, num_bindings});
+    return CALC_OK;
+  });
+}
+
+calc_status calc_evaluate_batch(const calc_expression *compiled,
+                                const double *const *columns,
+                                size_t num_columns, size_t num_rows,
+                                double *results) noexcept {
+  if (compiled == nullptr || (results == nullptr && num_rows > 0) ||
+      (columns == nullptr && num_columns > 0))
+    return fail(CALC_ERROR_INVALID_ARGUMENT, "Null pointer given.");
+  if (calc_status status{checkBindings(compiled, num_columns)};
+      status != CALC_OK)
+    return status;
+  for (size_t i{0}; i < num_columns; ++i) {
+    if (columns[i] == nullptr && num_rows > 0)
+      return fail(CALC_ERROR_INVALID_ARGUMENT, "Null column given.");
+  }
+  return guard([&]() {
+    std::vector<std::span<const double>> spans;
+    spans.reserve(num_columns);
+    for (size_t i{0}; i < num_columns; ++i)
+      spans.emplace_back(columns[i], num_rows);
+    compiled->jit.compiled().evaluateBatch(spans, {results, num_rows});
+    return CALC_OK;
+  });
+}
+
+const char *calc_last_error(void) noexcept { return lastError.data(); }
@@ -0,0 +1,94 @@
+#ifndef CALC_H
+#define CALC_H
+
+/******************************************************************************
+ * C interface of libcalc, for embedding the calculator in other programs and
+ * languages without starting a calc process per expression.
+ *
+ * An expression is compiled once into an opaque calc_expression, evaluated
+ * any number of times with values for its variables, one row at a time or a
+ * whole table of rows at once, and released with calc_free(). Expressions are
+ * compiled to native code where JitExpression supports it, and to bytecode
+ * otherwise, with identical results.
+ *
+ * No C++ exception ever crosses this interface. Every function reporting
+ * failure returns a calc_status, and calc_last_error() describes the last
+ * failure on the calling thread. A compiled expression isn't modified by
+ * evaluating it, so threads may evaluate the same one concurrently.
+ *
+ * Only the functions declared here are exported from libcalc.so, and
+ * CALC_ABI_VERSION changes whenever one of them changes incompatibly.
+ *****************************************************************************/
+
+#include <stddef.h>
+
+#if defined(__GNUC__)
+#define CALC_API __attribute__((visibility("default")))
+#else
+#define CALC_API
+#endif
+
+#ifdef __cplusplus
+#define CALC_NOEXCEPT noexcept
+extern "C" {
+#else
+#define CALC_NOEXCEPT
+#endif
+
+/// Version of the interface declared here
+#define CALC_ABI_VERSION 1
+
+/// Outcome of a call
+typedef enum calc_status {
+  CALC_OK = 0,                     /// The call succeeded
+  CALC_ERROR_INVALID_ARGUMENT = 1, /// A pointer was null or a size too small
+  CALC_ERROR_EXPRESSION = 2,       /// The expression couldn't be calculated
+  CALC_ERROR_OUT_OF_MEMORY = 3,    /// An allocation failed
+  CALC_ERROR_INTERNAL = 4,         /// Any other failure
+} calc_status;
+
+/// A compiled expression
+typedef struct calc_expression calc_expression;
+
+/// CALC_ABI_VERSION of the loaded library
+CALC_API int calc_abi_version(void) CALC_NOEXCEPT;
+
+/// Compile a null-terminated expression into *compiled, which is set to null
+/// on failure
+CALC_API calc_status calc_compile(const char *expression,
+                                  calc_expression **compiled) CALC_NOEXCEPT;
+
+/// Release a compiled expression; does nothing for null
+CALC_API void calc_free(calc_expression *compiled) CALC_NOEXCEPT;
+
+/// Number of variables of a compiled expression, or 0 for null
+CALC_API size_t
+calc_variable_count(const calc_expression *compiled) CALC_NOEXCEPT;
+
+/// Null-terminated name of the variable bound at index, or null if index is
+/// out of range. Valid until the expression is freed.
+CALC_API const char *calc_variable_name(const calc_expression *compiled,
+                                        size_t index) CALC_NOEXCEPT;
+
+/// Evaluate with num_bindings values, one per variable in calc_variable_name()
+/// order, into *result
+CALC_API calc_status calc_evaluate(const calc_expression *compiled,
+                                   const double *bindings, size_t num_bindings,
+                                   double *result) CALC_NOEXCEPT;
+
+/// Evaluate num_rows rows, given as num_columns columns of num_rows values,
+/// one column per variable, into results[0] to results[num_rows - 1]
+CALC_API calc_status calc_evaluate_batch(const calc_expression *compiled,
+                                         const double *const *columns,
+                                         size_t num_columns, size_t num_rows,
+                                         double *results) CALC_NOEXCEPT;
+
+/// Null-terminated description of the last failure on this thread, or an
+/// empty string if the last call returning a calc_status succeeded
+CALC_API const char *calc_last_error(void) CALC_NOEXCEPT;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CALC_H
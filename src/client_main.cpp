@@ -0,0 +1,57 @@
+#include <exception>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Client.h"
+
+static constexpr std::string_view helpStr{"\
+calc_client: Calculate expressions on a running calc --serve server.\n\
+\n\
+Usage: calc_client <socket_path> [<expression_args>]\n\
+\n\
+With expression arguments, their concatenation is sent as one expression and\n\
+its result printed. Otherwise newline-delimited expressions are read from\n\
+stdin and one response is printed per line, like calc --batch.\
+"};
+
+/// Lines sent to the server before waiting for their responses
+static constexpr size_t linesPerBatch{4096};
+
+int main(int argc, char *argv[]) {
+  if (argc < 2 || std::string_view(argv[1]) == "-h" ||
+      std::string_view(argv[1]) == "--help") {
+    std::cout << helpStr << std::endl;
+    return argc < 2 ? 1 : 0;
+  }
+  try {
+    Client client(argv[1]);
+    if (argc > 2) {
+      std::string expression;
+      for (int i{2}; i < argc; ++i)
+        expression += argv[i];
+      std::string response{client.evaluate(expression)};
+      std::cout << response << std::endl;
+      return response.starts_with("error: ") ? 1 : 0;
+    }
+    std::ios::sync_with_stdio(false);
+    std::vector<std::string> lines;
+    lines.reserve(linesPerBatch);
+    std::string line;
+    bool isMoreInput{true};
+    while (isMoreInput) {
+      lines.clear();
+      while (lines.size() < linesPerBatch &&
+             (isMoreInput = static_cast<bool>(std::getline(std::cin, line))))
+        lines.push_back(line);
+      for (const std::string &response : client.evaluate(lines))
+        std::cout << response << '\n';
+      std::cout.flush();
+    }
+  } catch (const std::exception &e) {
+    std::cerr << "Error: " << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
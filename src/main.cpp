@@ -1,27 +1,85 @@
-#include <iomanip>
+#include <csignal>
 #include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+
+#include <unistd.h>
 
 #include "ArgParser.h"
+#include "CompiledExpression.h"
 #include "Expression.h"
+#include "FileEvaluator.h"
+#include "OutputBuffer.h"
+#include "Profiler.h"
+#include "RangeReducer.h"
+#include "ResultCache.h"
+#include "Server.h"
+#include "StreamEvaluator.h"
 
 static constexpr std::string_view helpStr{"\
 calc: Calculate a mathematical expression.\n\
 \n\
-Usage: calc [-h|--help] [-p|--precision <num_digits>] <expression_args>\n\
+Usage: calc [-h|--help] [-p|--precision <num_digits>] [--fast-math]\n\
+         [--type <type>] [--stats] <expression_args>\n\
+       calc [-p|--precision <num_digits>] [-c|--cache <num_results>]\n\
+         [--type <type>] -b|--batch\n\
+       calc [-p|--precision <num_digits>] [-c|--cache <num_results>]\n\
+         [--type <type>] [-t|--threads <num_threads>] -f|--file <path>\n\
+       calc [-p|--precision <num_digits>] [-c|--cache <num_results>]\n\
+         [--type <type>] [-t|--threads <num_threads>] --serve <socket_path>\n\
+       calc [-p|--precision <num_digits>] [-t|--threads <num_threads>]\n\
+         --range <variable>=<start>:<stop>:<step> [--reduce <reduction>]\n\
+         <expression_args>\n\
 \n\
 Options:\n\
-  -p|--precision <num_digits>: Set number of digits to display in final\n\
-    result to <num_digits> except trailing zeros. Defaults to 6\n\
+  -p|--precision <num_digits>|shortest: Set number of digits to display in\n\
+    final result to <num_digits> except trailing zeros. Defaults to 6.\n\
+    'shortest' displays the fewest digits which read back as the exact\n\
+    result\n\
+  --fast-math: Calculate functions with cheaper approximations which keep\n\
+    the precision's digits plus one, instead of to the last bit. Used for\n\
+    the expression arguments, -v|--verbose, -b|--batch, -f|--file and\n\
+    --serve; not with --type or --range, which reject it, nor inside\n\
+    integrate() and root(). Does nothing with 'shortest'\n\
+  --type float|double|long-double: Calculate in this floating-point type.\n\
+    Defaults to double, which is the only type -v|--verbose, --fast-math\n\
+    and -c|--cache work with\n\
   -v|--verbose: Print each step in calculation of the expression\n\
+  -b|--batch: Read newline-delimited expressions from stdin and print one\n\
+    result per line. A line which can't be calculated prints\n\
+    'error: <reason>' instead, and the remaining lines are still evaluated\n\
+  -f|--file <path>: Like -b|--batch, but read expressions from a file and\n\
+    evaluate them on several threads. Results are printed in input order\n\
+  --serve <socket_path>: Listen on a Unix domain socket at <socket_path>\n\
+    until interrupted, calculating each expression clients send. Requests\n\
+    and responses are a 4-byte big-endian length followed by that many\n\
+    bytes, and responses are what -b|--batch prints, without the newline.\n\
+    calc_client sends expressions to a server\n\
+  --range <variable>=<start>:<stop>:<step>: Evaluate the expression for\n\
+    each value of <variable> from <start> to <stop>, <step> apart, on\n\
+    several threads, and print the reduction of the results. Sums are\n\
+    compensated, and the result doesn't depend on the number of threads\n\
+  --reduce sum|min|max|mean: How --range reduces the results. Defaults to\n\
+    sum\n\
+  -t|--threads <num_threads>: Number of threads for -f|--file, --serve or\n\
+    --range. Defaults to the number of CPU cores\n\
+  -c|--cache <num_results>: With -b|--batch, -f|--file or --serve, remember\n\
+    the results of up to <num_results> distinct expressions so repeated\n\
+    expressions are only calculated once\n\
+  --stats: After evaluating, print to stderr how many times each phase of\n\
+    evaluation ran and how long it took, and the size of the parsed trees\n\
   -h|--help: Display this help string\n\
 Arguments:\n\
   <expression_args>: Any number of arguments which, when concatenated,\n\
     produce a mathematical expression to be evaluated.\n\
 \n\
-    Whitespace is ignored, and wrapping the expression in quotes is \n\
-    unnecessary if one avoids characters like '*' which may lead the terminal\n\
-    to attempt glob expansion or '('/')' which may lead to command\n\
-    substitution in some shells.\n\
+    Whitespace is ignored, except that it separates names, and two numbers\n\
+    separated only by whitespace, such as \"1 000\", are an error rather\n\
+    than one number. Wrapping the expression in quotes is unnecessary if\n\
+    one avoids characters like '*' which may lead the terminal to attempt\n\
+    glob expansion or '('/')' which may lead to command substitution in\n\
+    some shells.\n\
 \n\
     Supports parentheses and several mathematical functions and operators,\n\
     including the binary operators:\n\
@@ -30,14 +88,123 @@ Arguments:\n\
       sqrt(), sin(), cos(), tan(), sinh(), cosh(), tanh(),\n\
       e^() || exp() (exponent of Euler's number),\n\
       ln() (natural logarithm), log() (base 10 logarithm)\n\
+    and the operations, whose <expression> has no variables but <variable>\n\
+    and whose bounds have none:\n\
+      integrate(<expression>, <variable>, <from>, <to>) (definite integral\n\
+        of <expression> over <variable> from <from> to <to>),\n\
+      root(<expression>, <variable>, <lower>, <upper>) (a value of\n\
+        <variable> between <lower> and <upper> at which <expression> is\n\
+        zero, given values of opposite signs at the bounds)\n\
+\n\
+    Any other name, such as y or rate, is parsed as a variable, and only\n\
+    --range gives a variable values: otherwise calculating it reports\n\
+    'Variable y has no value'. An x after an operand is still read as\n\
+    multiplication, so 2 x 3 is 6 and 2 xy is 2 times y, while an x where\n\
+    an operand is expected starts a name.\n\
 \n\
 Examples:\n\
 > calc 1 + 2 x 3\n\
 7\n\
+> calc \"integrate(t^2, t, 0, 3) + root(t^2 - 2, t, 0, 2)\"\n\
+10.4142\n\
 > calc -p 8 \"ln(3) + 3^2*sin(2.3)*cos(1.2)^2\"\n\
-1.9798332\
+1.9798332\n\
+> calc --range rate=1:3:1 2 x rate\n\
+12\
 "};
 
+/// Server run by --serve, stopped by SIGINT and SIGTERM
+static Server *runningServer{nullptr};
+
+static void stopServer(int) {
+  if (runningServer != nullptr)
+    runningServer->stop();
+}
+
+/// Calculate the expression of the arguments in a Scalar type and print it
+template <typename Scalar>
+static void printResult(const ArgParser &parsedArgs) {
+  BasicCompiledExpression<Scalar> compiled(parsedArgs.argString());
+  if (!compiled.variables().empty())
+    throw std::runtime_error("Variable " + compiled.variables().front() +
+                             " has no value.");
+  OutputBuffer(STDOUT_FILENO).appendNumber(compiled.evaluate(),
+                                           parsedArgs.precision())
+      << '\n';
+}
+
+/// Evaluate the expressions given by the parsed arguments, printing results
+static void evaluate(const ArgParser &parsedArgs) {
+  std::shared_ptr<ResultCache> cache;
+  if (parsedArgs.cacheSize() > 0)
+    cache = std::make_shared<ResultCache>(
+        static_cast<size_t>(parsedArgs.cacheSize()));
+  if (parsedArgs.batch) {
+    // Untie the C and C++ streams so stdin and stdout are fully buffered
+    std::ios::sync_with_stdio(false);
+    std::cin.tie(nullptr);
+    StreamEvaluator evaluator(OutputBuffer(STDOUT_FILENO),
+                              parsedArgs.precision(), cache);
+    evaluator.set_fast_math(parsedArgs.fastMath);
+    evaluator.set_scalar_type(parsedArgs.scalarType());
+    evaluator.run(std::cin);
+    return;
+  }
+  size_t numThreads{parsedArgs.threads() > 0
+                        ? static_cast<size_t>(parsedArgs.threads())
+                        : std::thread::hardware_concurrency()};
+  if (!parsedArgs.servePath().empty()) {
+    Server server(parsedArgs.servePath(), numThreads, parsedArgs.precision(),
+                  cache);
+    server.set_fast_math(parsedArgs.fastMath);
+    server.set_scalar_type(parsedArgs.scalarType());
+    runningServer = &server;
+    std::signal(SIGINT, stopServer);
+    std::signal(SIGTERM, stopServer);
+    server.run();
+    std::signal(SIGINT, SIG_DFL);
+    std::signal(SIGTERM, SIG_DFL);
+    runningServer = nullptr;
+    return;
+  }
+  if (!parsedArgs.filePath().empty()) {
+    std::ios::sync_with_stdio(false);
+    FileEvaluator evaluator(std::cout, numThreads, parsedArgs.precision());
+    evaluator.set_cache(cache);
+    evaluator.set_fast_math(parsedArgs.fastMath);
+    evaluator.set_scalar_type(parsedArgs.scalarType());
+    evaluator.run(parsedArgs.filePath());
+    return;
+  }
+  if (parsedArgs.range()) {
+    RangeReducer reducer(numThreads);
+    double result{reducer.run(parsedArgs.argString(), *parsedArgs.range(),
+                              parsedArgs.reduction())};
+    OutputBuffer(STDOUT_FILENO).appendNumber(result, parsedArgs.precision())
+        << '\n';
+    return;
+  }
+  if (parsedArgs.scalarType() == ScalarType::Float) {
+    printResult<float>(parsedArgs);
+    return;
+  }
+  if (parsedArgs.scalarType() == ScalarType::LongDouble) {
+    printResult<long double>(parsedArgs);
+    return;
+  }
+  Expression expression(parsedArgs.argString());
+  if (parsedArgs.fastMath)
+    expression.set_fast_math(parsedArgs.precision());
+  if (parsedArgs.verbose) {
+    expression.precision = parsedArgs.precision();
+    expression.printCalculation();
+    return;
+  }
+  double result{expression.result()};
+  OutputBuffer(STDOUT_FILENO).appendNumber(result, parsedArgs.precision())
+      << '\n';
+}
+
 // Arguments to main are required for this to work as a console command
 // taking a variable number of arguments.
 int main(int argc, char *argv[]) {
@@ -45,13 +212,14 @@ int main(int argc, char *argv[]) {
   parsedArgs.parse(argc, argv);
   if (parsedArgs.shouldExit())
     return 0;
-  Expression expression(parsedArgs.argString());
-  if (parsedArgs.verbose) {
-    expression.precision = parsedArgs.precision();
-    expression.printCalculation();
-    return 0;
+  if (parsedArgs.stats && !Profiler::isCompiled)
+    std::cerr << "Warning: --stats needs calc built with CALC_STATS=ON"
+              << std::endl;
+  Profiler::set_enabled(parsedArgs.stats);
+  evaluate(parsedArgs);
+  if (parsedArgs.stats) {
+    std::cout.flush();
+    Profiler::print(std::cerr);
   }
-  std::cout << std::setprecision(parsedArgs.precision()) << expression.result()
-            << std::endl;
   return 0;
 }
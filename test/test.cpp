@@ -1,12 +1,42 @@
+#include <algorithm>
+#include <atomic>
+#include <bit>
 #include <catch2/catch_test_macros.hpp>
 #include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <memory>
+#include <random>
+#include <span>
 #include <sstream>
+#include <stdexcept>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
 #include "ArgParser.h"
+#include "Calculus.h"
+#include "Client.h"
+#include "CompiledExpression.h"
+#include "ConstantParser.h"
 #include "Expression.h"
+#include "FastMath.h"
+#include "FileEvaluator.h"
+#include "JitExpression.h"
+#include "Lexer.h"
+#include "OutputBuffer.h"
+#include "Profiler.h"
+#include "RangeReducer.h"
+#include "ResultCache.h"
+#include "Server.h"
+#include "StreamEvaluator.h"
+#include "ThreadPool.h"
+#include "calc.h"
 
 #define TOLERANCE 1e-7
 
@@ -42,11 +72,18 @@ const std::vector<std::pair<std::string, double>> basicExprResults = {
 const std::vector<std::pair<std::string, double>> complexExprResults = {
     {{"((((1+1))))", 2.0},
      {"2^(2)*cos(0.0)", 4.0},
-     {"cos(cos(3.14159/2))", 1.0}}};
+     {"cos(cos(3.14159/2))", 1.0},
+     {"2(3)", 6.0},
+     {"(1+2)(3+4)", 21.0},
+     {"2sin(0)+1", 1.0},
+     {"e^(1)", 2.718281828},
+     {" ( - 3 ) * 2 ", -6.0}}};
 
 const std::vector<std::string> invalidExpressions = {
     "(1+2",   "1+2)", "cos(0.0", "5-*4",    "(((1+1)+2)",
-    "(5-2/)", "-",    "/1",      "1+(^2-1)"};
+    "(5-2/)", "-",    "/1",      "1+(^2-1)", "()", "1.5.3", "sin",
+    "2*-3",   "3x",   "1+foo(2)", "1;2", "x(1+x)", "1 2", "1 000",
+    "12 3.5"};
 
 TEST_CASE("Expression: Result correctness") {
   SECTION("Basic Expressions") {
@@ -73,6 +110,125 @@ TEST_CASE("Expression: Result correctness") {
   }
 }
 
+TEST_CASE("Expression: Parsing long expressions") {
+  SECTION("Long flat chain") {
+    // 1+2x3-4/5+6x7-8/9... with BEDMAS applied by hand
+    std::string input{"1"};
+    double expected{1.0};
+    for (int i{0}; i < 5000; ++i) {
+      double a{static_cast<double>(i % 7 + 2)};
+      double b{static_cast<double>(i % 5 + 1)};
+      bool add{i % 2 == 0};
+      input += (add ? "+" : "-") + std::to_string(i % 7 + 2) +
+               (i % 3 == 0 ? "/" : "x") + std::to_string(i % 5 + 1);
+      double term{i % 3 == 0 ? a / b : a * b};
+      expected += add ? term : -term;
+    }
+    double result;
+    REQUIRE_NOTHROW(result = Expression(input).result());
+    INFO("Calculated " << result << " for long chain but expected "
+                       << expected);
+    CHECK(nearEqual(result, expected));
+  }
+  SECTION("Deep nesting") {
+    std::string input{std::string(500, '(') + "1" + std::string(500, ')') +
+                      "+" + std::string(500, '(') + "2" +
+                      std::string(500, ')')};
+    double result;
+    REQUIRE_NOTHROW(result = Expression(input).result());
+    CHECK(nearEqual(result, 3.0));
+  }
+}
+
+TEST_CASE("Expression: Copying parsed expressions") {
+  Expression original("2*(3+4) - sqrt(16)");
+  REQUIRE(original.isAtomic() == false);
+  Expression copy{original};
+  INFO("Copy of a parsed expression calculated the wrong result");
+  CHECK(nearEqual(copy.result(), 10.0));
+  INFO("Calculating a copy changed the original expression");
+  CHECK(nearEqual(original.result(), 10.0));
+  Expression number(4.5);
+  CHECK(number.isAtomic());
+  CHECK(nearEqual(number.result(), 4.5));
+  CHECK(number.expression() == "4.5");
+}
+
+TEST_CASE("Expression: Calculation steps") {
+  std::ostringstream capturedOutput;
+  auto oldCoutBuf = std::cout.rdbuf(capturedOutput.rdbuf());
+  Expression expression("2*(3+4*5) - sqrt(4)");
+  expression.printCalculation();
+  std::cout.rdbuf(oldCoutBuf);
+  INFO("Unexpected calculation steps:\n" << capturedOutput.str());
+  CHECK(capturedOutput.str() == "2*(3+4*5)-sqrt(4)\n"
+                                "2x(3+20)-2\n"
+                                "2x23-2\n"
+                                "46-2\n"
+                                "Result: 44\n");
+}
+
+TEST_CASE("Expression: Variables") {
+  Expression expression("x^2 + 2 x x - rate");
+  REQUIRE(expression.variables() == std::vector<std::string>{"x", "rate"});
+  REQUIRE(expression.isAtomic() == false);
+  INFO("Calculated an expression with unbound variables");
+  REQUIRE_THROWS(expression.result());
+  REQUIRE_THROWS(expression.set_variable("y", 1.0));
+  expression.set_variable("x", 3.0);
+  expression.set_variable("rate", 1.0);
+  CHECK(nearEqual(expression.result(), 14.0));
+  expression.set_variable("x", -1.0);
+  INFO("Rebinding a variable did not recalculate the result");
+  CHECK(nearEqual(expression.result(), -2.0));
+  INFO("Bindings were lost when setting a new expression");
+  expression.set_expression("rate*(x + t0)");
+  expression.set_variable("t0", 4.0);
+  CHECK(nearEqual(expression.result(), 3.0));
+  INFO("Multiplication by x was read as a variable");
+  CHECK(nearEqual(Expression("2x3").result(), 6.0));
+  Expression euler("e ^ 2");
+  euler.set_variable("e", 3.0);
+  CHECK(nearEqual(euler.result(), 9.0));
+}
+
+TEST_CASE("Expression: Recalculating after a variable changes") {
+  // Shared subexpressions give Nodes several parents once optimized
+  std::string formula{"sin(a)*b + sin(a)*c - (a + b)^2 / (c + 2) + sqrt(b*b)"};
+  for (size_t i{0}; i < 20; ++i)
+    formula = "(" + formula + ") * 0.5 + cos(a + " + std::to_string(i) + ")";
+  const std::vector<std::string> names{"a", "b", "c"};
+  std::vector<double> values{0.5, 1.5, 2.5};
+  Expression incremental(formula);
+  for (size_t i{0}; i < names.size(); ++i)
+    incremental.set_variable(names[i], values[i]);
+  for (size_t step{0}; step < 200; ++step) {
+    size_t changed{step * 7 % names.size()};
+    // Every third step rebinds the value a variable already has
+    if (step % 3 != 0)
+      values[changed] += 0.25 * static_cast<double>(step % 5) - 0.5;
+    incremental.set_variable(names[changed], values[changed]);
+    Expression fresh(formula);
+    for (size_t i{0}; i < names.size(); ++i)
+      fresh.set_variable(names[i], values[i]);
+    double expected{fresh.result()};
+    double result{incremental.result()};
+    INFO("Stale result after changing " << names[changed] << " at step "
+                                        << step);
+    REQUIRE(std::bit_cast<std::uint64_t>(result) ==
+            std::bit_cast<std::uint64_t>(expected));
+  }
+  SECTION("Rebinding before the first result") {
+    Expression expression("x*y + x");
+    expression.set_variable("x", 2.0);
+    expression.set_variable("y", 3.0);
+    expression.set_variable("x", 4.0);
+    CHECK(expression.result() == 16.0);
+    expression.set_variable("y", 0.5);
+    CHECK(expression.result() == 6.0);
+  }
+}
+
 TEST_CASE("Expression: Input Validation") {
   // TODO
   for (std::string input : invalidExpressions) {
@@ -84,6 +240,1222 @@ TEST_CASE("Expression: Input Validation") {
   REQUIRE(1 + 1 == 2);
 }
 
+TEST_CASE("Expression: Exact integer arithmetic") {
+  auto exact{[](const std::string &formula) {
+    return Expression(formula).result();
+  }};
+  SECTION("Integers beyond 2^53 stay exact") {
+    CHECK(exact("9007199254740993 - 9007199254740992") == 1.0);
+    CHECK(exact("2^62 + 1 - 2^62") == 1.0);
+    CHECK(exact("(2^53 + 1) % 2") == 1.0);
+    CHECK(exact("3^39 - 3^39 / 3 x 3") == 0.0);
+    CHECK(exact("9223372036854775807 - 9223372036854775806") == 1.0);
+  }
+  SECTION("Exponentiation by squaring") {
+    CHECK(exact("3^39") == 4052555153018976267.0);
+    CHECK(exact("(0-2)^63") == -9223372036854775808.0);
+    CHECK(exact("0^0") == 1.0);
+    CHECK(exact("1^1000000") == 1.0);
+    CHECK(exact("(0-1)^1000001") == -1.0);
+    CHECK(exact("2^(0-2)") == 0.25);
+  }
+  SECTION("Overflow falls back to the nearest double") {
+    CHECK(exact("3^40") == std::pow(3.0, 40.0));
+    CHECK(exact("9223372036854775807 + 1") == 9223372036854775808.0);
+    CHECK(exact("2^62 x 4 - 2^63") == 9223372036854775808.0);
+    CHECK(exact("(0 - 9223372036854775807 - 1) / (0-1)") ==
+          9223372036854775808.0);
+    CHECK(exact("99999999999999999999 - 1") == 1e20);
+  }
+  SECTION("Division and modulo") {
+    CHECK(exact("12 / 4") == 3.0);
+    CHECK(exact("7 / 2") == 3.5);
+    CHECK(exact("1 / 0") == std::numeric_limits<double>::infinity());
+    CHECK(exact("7 % 3") == 1.0);
+    CHECK(exact("(0-7) % 3") == std::fmod(-7.0, 3.0));
+    CHECK(std::isnan(exact("7 % 0")));
+  }
+  SECTION("Integers mixed with decimals and functions are doubles") {
+    CHECK(exact("9007199254740993.0 - 9007199254740992") == 0.0);
+    CHECK(exact("sqrt(4)^60 - 2^60") == 0.0);
+  }
+  SECTION("Compiled and compile-time results match") {
+    for (const std::string formula :
+         {"9007199254740993 - 9007199254740992", "2^62 + 1 - 2^62", "3^40",
+          "(0 - 9223372036854775807 - 1) / (0-1)", "7 % 3 + 12 / 4"}) {
+      INFO("Results differ for " << formula);
+      CHECK(CompiledExpression(formula).evaluate() == exact(formula));
+      CHECK(ConstantParser(formula).calculate() == exact(formula));
+    }
+    static_assert(calc::eval<"2^62 + 1 - 2^62">() == 1.0);
+  }
+}
+
+TEST_CASE("CompiledExpression: Result correctness") {
+  std::vector<std::pair<std::string, double>> exprResults{basicExprResults};
+  exprResults.insert(exprResults.end(), complexExprResults.begin(),
+                     complexExprResults.end());
+  for (auto pair : exprResults) {
+    INFO("Error encountered while compiling expression " << pair.first);
+    Expression expression(pair.first);
+    CompiledExpression compiled;
+    REQUIRE_NOTHROW(compiled = CompiledExpression(expression));
+    double result{compiled.evaluate()};
+    INFO("Evaluated " << result << " for compiled expression " << pair.first
+                      << " but expected " << pair.second);
+    CHECK(nearEqual(result, pair.second));
+    INFO("Re-evaluating compiled expression " << pair.first
+                                              << " changed its result");
+    CHECK(compiled.evaluate() == result);
+  }
+}
+
+std::vector<CompiledExpression::OpCode>
+instructionCodes(const CompiledExpression &compiled) {
+  std::vector<CompiledExpression::OpCode> codes;
+  for (const auto &instruction : compiled.instructions())
+    codes.push_back(instruction.code);
+  return codes;
+}
+
+TEST_CASE("CompiledExpression: Instruction stream") {
+  Expression expression("2 x y + 4");
+  CompiledExpression compiled(expression);
+  using OpCode = CompiledExpression::OpCode;
+  INFO("Expected postfix program 2 y x 4 + for expression 2 x y + 4");
+  REQUIRE(instructionCodes(compiled) ==
+          std::vector<OpCode>{OpCode::PushConstant, OpCode::PushVariable,
+                              OpCode::BinaryOperation, OpCode::PushConstant,
+                              OpCode::BinaryOperation});
+  REQUIRE(compiled.maxStackDepth() == 2);
+}
+
+TEST_CASE("Optimizer: Constant folding") {
+  using OpCode = CompiledExpression::OpCode;
+  SECTION("Constant expressions fold to a single number") {
+    CompiledExpression compiled("2 x 3 + sqrt(16)^(1+1)");
+    REQUIRE(instructionCodes(compiled) ==
+            std::vector<OpCode>{OpCode::PushConstant});
+    CHECK(nearEqual(compiled.evaluate(), 22.0));
+  }
+  SECTION("Leading numbers of an operator chain fold together") {
+    CompiledExpression compiled("1 + 2*3 - y + 4");
+    INFO("Expected program 7 y - 4 +");
+    REQUIRE(instructionCodes(compiled) ==
+            std::vector<OpCode>{OpCode::PushConstant, OpCode::PushVariable,
+                                OpCode::BinaryOperation, OpCode::PushConstant,
+                                OpCode::BinaryOperation});
+    std::vector<double> bindings{5.0};
+    CHECK(nearEqual(compiled.evaluate(bindings), 6.0));
+  }
+  SECTION("Numbers after a variable keep their left-to-right order") {
+    Expression expression("y - 1 - 2");
+    expression.set_variable("y", 10.0);
+    CHECK(nearEqual(expression.result(), 7.0));
+  }
+}
+
+TEST_CASE("Optimizer: Common subexpressions") {
+  Expression expression("sin(y)*2 + (y+1)^2 / sin(y) - (y+1)^2");
+  CompiledExpression compiled(expression);
+  INFO("Expected sin(y), (y+1)^2 and the y+1 squared in it to be calculated "
+       "once each");
+  REQUIRE(compiled.numTemporaries() == 3);
+  for (double y : {-1.5, 0.5, 2.0}) {
+    std::vector<double> bindings{y};
+    double expected{std::sin(y) * 2 + (y + 1) * (y + 1) / std::sin(y) -
+                    (y + 1) * (y + 1)};
+    INFO("Wrong result for y = " << y);
+    CHECK(nearEqual(compiled.evaluate(bindings), expected));
+    expression.set_variable("y", y);
+    CHECK(nearEqual(expression.result(), expected));
+    std::vector<double> results(3);
+    std::vector<double> column(3, y);
+    std::vector<std::span<const double>> columns{column};
+    compiled.evaluateBatch(columns, results);
+    CHECK(results[2] == compiled.evaluate(bindings));
+  }
+}
+
+/// Whether a compiled program applies an Operator anywhere
+template <typename Scalar>
+bool appliesOperator(const BasicCompiledExpression<Scalar> &compiled,
+                     Expression::Operator oper) {
+  for (const auto &instruction : compiled.instructions()) {
+    bool isOperation{
+        instruction.code ==
+            BasicCompiledExpression<Scalar>::OpCode::UnaryOperation ||
+        instruction.code ==
+            BasicCompiledExpression<Scalar>::OpCode::BinaryOperation};
+    if (isOperation && instruction.oper == oper)
+      return true;
+  }
+  return false;
+}
+
+TEST_CASE("Optimizer: Strength reduction") {
+  using Operator = Expression::Operator;
+  using OpCode = CompiledExpression::OpCode;
+  const std::vector<double> values{-2.5, -1.0, -0.3, 0.0, 0.7, 1.0, 3.0, 1e5};
+  // Checks an expression of y against the original operations for each value
+  auto checkValues{[&values](const std::string &expression, auto expected) {
+    CompiledExpression compiled(expression);
+    Expression tree(expression);
+    for (double y : values) {
+      INFO("Calculated " << expression << " for y = " << y);
+      std::vector<double> bindings{y};
+      CHECK(nearEqual(compiled.evaluate(bindings), expected(y), 1e-14));
+      tree.set_variable("y", y);
+      CHECK(nearEqual(tree.result(), expected(y), 1e-14));
+    }
+  }};
+  SECTION("Small integer powers become multiplications") {
+    for (double exponent : {-8.0, -3.0, -1.0, 0.0, 1.0, 2.0, 3.0, 5.0, 8.0}) {
+      std::ostringstream expression;
+      expression << "(y + 0.5)^" << (exponent < 0 ? "(" : "") << exponent
+                 << (exponent < 0 ? ")" : "");
+      INFO("Compiled " << expression.str());
+      CHECK(!appliesOperator(CompiledExpression(expression.str()),
+                             Operator::Pow));
+      checkValues(expression.str(), [exponent](double y) {
+        return std::pow(y + 0.5, exponent);
+      });
+    }
+    INFO("Powers are found by repeated squaring");
+    std::vector<OpCode> eighth{instructionCodes(CompiledExpression("y^8"))};
+    CHECK(std::count(eighth.begin(), eighth.end(), OpCode::BinaryOperation) ==
+          3);
+    CHECK(CompiledExpression("y^0").evaluate(
+              std::vector<double>{std::nan("")}) == 1.0);
+    INFO("Variables folded away must still have values");
+    Expression constant("y^0");
+    CHECK_THROWS(constant.result());
+    constant.set_variable("y", std::nan(""));
+    CHECK(constant.result() == 1.0);
+    CHECK(appliesOperator(CompiledExpression("y^9"), Operator::Pow));
+    CHECK(appliesOperator(CompiledExpression("y^2.5"), Operator::Pow));
+  }
+  SECTION("Square roots are left to std::pow") {
+    // sqrt() would give -0 for -0 and NaN for -inf
+    CHECK(appliesOperator(CompiledExpression("(y + 3)^0.5"), Operator::Pow));
+    checkValues("(y + 3)^0.5", [](double y) { return std::pow(y + 3, 0.5); });
+  }
+  SECTION("Division by a number becomes multiplication") {
+    CHECK(!appliesOperator(CompiledExpression("y/3 - y/0.1"),
+                           Operator::Divide));
+    checkValues("y/3 - y/0.1", [](double y) { return y / 3 - y / 0.1; });
+    INFO("Powers of two have exact reciprocals");
+    CHECK(CompiledExpression("y/4").evaluate(std::vector<double>{0.3}) ==
+          0.3 / 4);
+    INFO("Numbers without a normal reciprocal are still divided by");
+    CHECK(appliesOperator(CompiledExpression("y/0"), Operator::Divide));
+    CHECK(appliesOperator(CompiledExpression("y/10^308"), Operator::Divide));
+    INFO("Other types calculate the reciprocals of their constants");
+    CHECK(appliesOperator(BasicCompiledExpression<float>("y/3"),
+                          Operator::Divide));
+  }
+  SECTION("Arguments outside the domain or overflowing") {
+    // Each rewritten expression must give what its constant form gives
+    const std::vector<std::pair<std::string, std::string>> cases{
+        {"sqrt(y)^2", "-4"},      {"e^(ln(y))", "-1"},
+        {"ln(e^(y))", "800"},     {"e^(ln(y))", "0"},
+        {"y^0.5", "-4"},          {"y^3", "10^200"},
+        {"y^(-2)", "10^(-200)"},  {"y^8 / 3", "-10^50"},
+        {"ln(y)^2", "-1"},        {"(y^2)^0.5", "-3"},
+        {"y^0.5", "-10^400"},     {"y^0.5", "-0.0"}};
+    for (const auto &[expression, argument] : cases) {
+      double y{Expression(argument).result()};
+      std::string substituted{expression};
+      substituted.replace(substituted.find('y'), 1, "(" + argument + ")");
+      double expected{Expression(substituted).result()};
+      std::vector<double> bindings{y};
+      double compiled{CompiledExpression(expression).evaluate(bindings)};
+      Expression tree(expression);
+      tree.set_variable("y", y);
+      INFO("Calculated " << expression << " for y = " << y << " as "
+                         << compiled << " instead of " << expected);
+      if (std::isnan(expected)) {
+        CHECK(std::isnan(compiled));
+        CHECK(std::isnan(tree.result()));
+      } else {
+        CHECK((compiled == expected || nearEqual(compiled, expected, 1e-14)));
+        CHECK((tree.result() == expected ||
+               nearEqual(tree.result(), expected, 1e-14)));
+        // Zeros compare equal whatever their signs
+        CHECK(std::signbit(compiled) == std::signbit(expected));
+        CHECK(std::signbit(tree.result()) == std::signbit(expected));
+      }
+    }
+    INFO("Identities only holding inside a domain are kept as written");
+    CHECK(appliesOperator(CompiledExpression("e^(ln(y))"), Operator::Ln));
+    CHECK(appliesOperator(CompiledExpression("ln(e^(y))"), Operator::Exp));
+  }
+  SECTION("Many powers in one expression") {
+    std::string expression{"0"};
+    for (int i{1}; i <= 40; ++i)
+      expression += " + (y + " + std::to_string(i) + ")^7";
+    checkValues(expression, [](double y) {
+      double sum{0.0};
+      for (int i{1}; i <= 40; ++i)
+        sum += std::pow(y + i, 7);
+      return sum;
+    });
+  }
+}
+
+TEST_CASE("CompiledExpression: Variable bindings") {
+  CompiledExpression compiled("x^2 + 2 x x - rate");
+  REQUIRE(compiled.variables() == std::vector<std::string>{"x", "rate"});
+  for (double x : {-2.0, 0.0, 0.5, 3.0}) {
+    std::vector<double> bindings{x, 1.5};
+    INFO("Wrong result for x = " << x);
+    CHECK(nearEqual(compiled.evaluate(bindings), x * x + 2 * x - 1.5));
+  }
+  INFO("Evaluated without a value for every variable");
+  REQUIRE_THROWS(compiled.evaluate(std::vector<double>{1.0}));
+}
+
+TEST_CASE("CompiledExpression: Batch evaluation") {
+  const std::vector<std::string> formulas{
+      "x^2 + 2 x x - rate", "sin(x)cos(rate) / (1 + e^(x))",
+      "sqrt(x*x + rate rate) % 3", "ln(4 + x) - log(3)*tanh(rate)", "2^10"};
+  for (size_t numRows : {size_t{0}, size_t{1}, size_t{255}, size_t{1000}}) {
+    std::vector<double> xs(numRows);
+    std::vector<double> rates(numRows);
+    for (size_t i{0}; i < numRows; ++i) {
+      xs[i] = static_cast<double>(i) * 0.01 - 3.0;
+      rates[i] = static_cast<double>(i % 7) + 0.5;
+    }
+    for (const std::string &formula : formulas) {
+      CompiledExpression compiled(formula);
+      std::vector<std::span<const double>> columns{xs, rates};
+      std::vector<double> results(numRows);
+      compiled.evaluateBatch(columns, results);
+      for (size_t i{0}; i < numRows; ++i) {
+        std::vector<double> bindings{xs[i], rates[i]};
+        INFO("Batch result differs from evaluate() for " << formula
+                                                         << " at row " << i);
+        REQUIRE(results[i] == compiled.evaluate(bindings));
+      }
+    }
+  }
+  CompiledExpression compiled("x + y");
+  std::vector<double> shortColumn(3);
+  std::vector<double> results(4);
+  std::vector<std::span<const double>> columns{shortColumn, shortColumn};
+  REQUIRE_THROWS(compiled.evaluateBatch(columns, results));
+  REQUIRE_THROWS(compiled.evaluateBatch({}, results));
+}
+
+TEST_CASE("CompiledExpression: Scalar types") {
+  SECTION("Calculating in float") {
+    BasicCompiledExpression<float> compiled("sin(x)*2.5 + x/3 - 0.1");
+    for (float x : {-2.0f, 0.5f, 3.0f}) {
+      std::vector<float> bindings{x};
+      INFO("Wrong float result for x = " << x);
+      CHECK(compiled.evaluate(bindings) ==
+            std::sin(x) * 2.5f + x / 3.0f - 0.1f);
+    }
+    CHECK(BasicCompiledExpression<float>("0.1 + 0.2").evaluate() ==
+          0.1f + 0.2f);
+    CHECK(BasicCompiledExpression<float>("1/3").evaluate() == 1.0f / 3.0f);
+    INFO("Integer subexpressions are still exact");
+    CHECK(BasicCompiledExpression<float>("2^62 + 1 - 2^62").evaluate() == 1.0f);
+  }
+  SECTION("Calculating in long double") {
+    CHECK(BasicCompiledExpression<long double>("0.1 + 0.2").evaluate() ==
+          0.1L + 0.2L);
+    CHECK(BasicCompiledExpression<long double>("ln(3) + 3^2").evaluate() ==
+          std::log(3.0L) + 9.0L);
+    long double third{BasicCompiledExpression<long double>("1/3").evaluate()};
+    CHECK(third == 1.0L / 3.0L);
+    if constexpr (std::numeric_limits<long double>::digits >
+                  std::numeric_limits<double>::digits) {
+      INFO("Constants were calculated as doubles");
+      CHECK(third != static_cast<long double>(1.0 / 3.0));
+    }
+  }
+  SECTION("Constants are folded in the program's type") {
+    BasicCompiledExpression<float> compiled("sin(2.3)*x - 2*3");
+    using OpCode = BasicCompiledExpression<float>::OpCode;
+    CHECK(compiled.constants() == std::vector<float>{std::sin(2.3f), 6.0f});
+    std::vector<OpCode> codes;
+    for (const auto &instruction : compiled.instructions())
+      codes.push_back(instruction.code);
+    CHECK(codes == std::vector<OpCode>{OpCode::PushConstant,
+                                       OpCode::PushVariable,
+                                       OpCode::BinaryOperation,
+                                       OpCode::PushConstant,
+                                       OpCode::BinaryOperation});
+  }
+  SECTION("Batch evaluation in float") {
+    const std::vector<std::string> formulas{"x^2 + 2 x x - rate",
+                                            "sin(x)cos(rate) / (1 + e^(x))",
+                                            "sqrt(x*x + rate rate) % 3"};
+    const size_t numRows{1000};
+    std::vector<float> xs(numRows);
+    std::vector<float> rates(numRows);
+    for (size_t i{0}; i < numRows; ++i) {
+      xs[i] = static_cast<float>(i) * 0.01f - 3.0f;
+      rates[i] = static_cast<float>(i % 7) + 0.5f;
+    }
+    for (const std::string &formula : formulas) {
+      BasicCompiledExpression<float> compiled(formula);
+      std::vector<std::span<const float>> columns{xs, rates};
+      std::vector<float> results(numRows);
+      compiled.evaluateBatch(columns, results);
+      for (size_t i{0}; i < numRows; ++i) {
+        std::vector<float> bindings{xs[i], rates[i]};
+        INFO("Batch result differs from evaluate() for " << formula
+                                                         << " at row " << i);
+        REQUIRE(results[i] == compiled.evaluate(bindings));
+      }
+    }
+  }
+}
+
+TEST_CASE("C interface: Compiling and evaluating") {
+  REQUIRE(calc_abi_version() == CALC_ABI_VERSION);
+  calc_expression *compiled{nullptr};
+  REQUIRE(calc_compile("x^2 + 2 x x - rate", &compiled) == CALC_OK);
+  REQUIRE(calc_variable_count(compiled) == 2);
+  CHECK(std::string(calc_variable_name(compiled, 0)) == "x");
+  CHECK(std::string(calc_variable_name(compiled, 1)) == "rate");
+  CHECK(calc_variable_name(compiled, 2) == nullptr);
+  SECTION("Evaluating one row") {
+    const double bindings[]{3.0, 1.5};
+    double result{0.0};
+    REQUIRE(calc_evaluate(compiled, bindings, 2, &result) == CALC_OK);
+    CHECK(result == 13.5);
+    CHECK(std::string(calc_last_error()).empty());
+  }
+  SECTION("Evaluating a batch") {
+    const std::vector<double> xs{-1.0, 0.0, 2.0};
+    const std::vector<double> rates{1.0, 2.0, 3.0};
+    const double *columns[]{xs.data(), rates.data()};
+    std::vector<double> results(3);
+    REQUIRE(calc_evaluate_batch(compiled, columns, 2, 3, results.data()) ==
+            CALC_OK);
+    CHECK(results == std::vector<double>{-2.0, -2.0, 5.0});
+  }
+  SECTION("Failures are returned, not thrown") {
+    const double bindings[]{3.0};
+    double result{0.0};
+    CHECK(calc_evaluate(compiled, bindings, 1, &result) ==
+          CALC_ERROR_INVALID_ARGUMENT);
+    CHECK(!std::string(calc_last_error()).empty());
+    CHECK(calc_evaluate(nullptr, bindings, 1, &result) ==
+          CALC_ERROR_INVALID_ARGUMENT);
+    const double *columns[]{bindings, nullptr};
+    CHECK(calc_evaluate_batch(compiled, columns, 2, 1, &result) ==
+          CALC_ERROR_INVALID_ARGUMENT);
+    calc_expression *invalid{compiled};
+    CHECK(calc_compile("2*(3", &invalid) == CALC_ERROR_EXPRESSION);
+    CHECK(invalid == nullptr);
+    CHECK(std::string(calc_last_error()) ==
+          "Expression 2*(3 is invalid: unmatched parentheses");
+    CHECK(calc_compile(nullptr, &invalid) == CALC_ERROR_INVALID_ARGUMENT);
+  }
+  calc_free(compiled);
+  calc_free(nullptr);
+}
+
+TEST_CASE("JitExpression: Native code matches the interpreter") {
+  std::string deep{"x"};
+  for (size_t i{0}; i < 80; ++i)
+    deep = "x - (" + deep + " / rate)";
+  const std::vector<std::string> formulas{
+      "x^2 + 2 x x - rate",
+      "sin(x)cos(rate) / (1 + e^(x))",
+      "sqrt(x*x + rate rate) % 3",
+      "ln(4 + x) - log(3)*tanh(rate)",
+      "sin(x)*2 + 3/sin(x) - (x + rate)^2*(x + rate)",
+      "2^10",
+      deep};
+  for (const std::string &formula : formulas) {
+    JitExpression jit(formula);
+    if (JitExpression::isSupported)
+      REQUIRE(jit.isNative());
+    for (size_t i{0}; i < 200; ++i) {
+      std::vector<double> bindings{static_cast<double>(i) * 0.05 - 5.0,
+                                   static_cast<double>(i % 7) + 0.5};
+      double expected{jit.compiled().evaluate(bindings)};
+      double result{jit.evaluate(bindings)};
+      INFO("JIT result differs from the interpreter for " << formula
+                                                          << " at row " << i);
+      REQUIRE(std::bit_cast<std::uint64_t>(result) ==
+              std::bit_cast<std::uint64_t>(expected));
+      if (jit.isNative())
+        REQUIRE(std::bit_cast<std::uint64_t>(jit.function()(bindings.data())) ==
+                std::bit_cast<std::uint64_t>(expected));
+    }
+  }
+  SECTION("Moving keeps the generated code") {
+    JitExpression first("1 + y*2");
+    JitExpression second(std::move(first));
+    std::vector<double> bindings{4.0};
+    REQUIRE(second.evaluate(bindings) == 9.0);
+    first = std::move(second);
+    REQUIRE(first.evaluate(bindings) == 9.0);
+    REQUIRE_THROWS(first.evaluate({}));
+  }
+}
+
+// Evaluated while compiling, so a regression fails the build
+static_assert(calc::eval<"ln(3) + 3^2">() == std::log(3.0) + 9.0);
+static_assert(calc::eval<"2^3^2">() == 64.0);
+static_assert(calc::eval<" ( - 3 ) * 2 ">() == -6.0);
+static_assert(calc::eval<"(1+2)(3+4) x 2">() == 42.0);
+static_assert(calc::eval<"0.1">() == 0.1);
+
+TEST_CASE("ConstantParser: Compile-time evaluation") {
+  SECTION("Same results as Expression") {
+    std::vector<std::string> formulas{
+        "2^3^2",         "-2^2",          "7 % 3 / 2",
+        "e^(1) - exp(1)", "sqrt(2)sqrt(2)", "log(1000) + tanh(0.5)",
+        "0.30000000000000004", "123456789012345678901234567890",
+        "1.7976931348623157", "sin(1)cos(2) / tan(3) - sinh(1) cosh(1)"};
+    for (const auto &[formula, value] : basicExprResults)
+      formulas.push_back(formula);
+    for (const auto &[formula, value] : complexExprResults)
+      formulas.push_back(formula);
+    for (const std::string &formula : formulas) {
+      double expected{Expression(formula).result()};
+      double result{ConstantParser(formula).calculate()};
+      INFO("ConstantParser differs from Expression for " << formula);
+      REQUIRE(std::bit_cast<std::uint64_t>(result) ==
+              std::bit_cast<std::uint64_t>(expected));
+    }
+  }
+  SECTION("Rejecting what Expression rejects") {
+    for (const std::string &formula : invalidExpressions) {
+      INFO("Invalid input " << formula << " erroneously calculated.");
+      REQUIRE_THROWS(ConstantParser(formula).calculate());
+    }
+  }
+  SECTION("Rejecting variables") {
+    REQUIRE_THROWS(ConstantParser("2 rate").calculate());
+    REQUIRE_THROWS(ConstantParser("e^2").calculate());
+  }
+  SECTION("Calculus operations are only calculated at runtime") {
+    REQUIRE(nearEqual(Expression("integrate(t, t, 0, 1)").result(), 0.5));
+    REQUIRE_THROWS(ConstantParser("integrate(t, t, 0, 1)").calculate());
+    REQUIRE_THROWS(ConstantParser("1 + root(t - 1, t, 0, 2)").calculate());
+  }
+}
+
+TEST_CASE("Lexer: Tokenization") {
+  using TokenType = Lexer::TokenType;
+  using Operator = Expression::Operator;
+  Lexer lexer("-sin(2.5)x 3");
+  std::vector<Lexer::Token> tokens;
+  for (Lexer::Token token{lexer.next()}; token.type != TokenType::End;
+       token = lexer.next())
+    tokens.push_back(token);
+  REQUIRE(tokens.size() == 7);
+  CHECK(tokens[0].type == TokenType::BinaryOperator);
+  CHECK(tokens[0].oper == Operator::Minus);
+  CHECK(tokens[1].type == TokenType::Function);
+  CHECK(tokens[1].oper == Operator::Sin);
+  CHECK(tokens[1].text == "sin");
+  CHECK(tokens[2].type == TokenType::LeftBracket);
+  CHECK(tokens[3].type == TokenType::Number);
+  CHECK(tokens[3].value == 2.5);
+  CHECK(tokens[4].type == TokenType::RightBracket);
+  CHECK(tokens[5].type == TokenType::BinaryOperator);
+  CHECK(tokens[5].oper == Operator::Times);
+  CHECK(tokens[6].type == TokenType::Number);
+  CHECK(tokens[6].value == 3.0);
+  CHECK(tokens[6].isInteger);
+  CHECK(tokens[6].integer == 3);
+  CHECK(!tokens[3].isInteger);
+  CHECK(lexer.position() == 12);
+  SECTION("Function names containing 'x'") {
+    Lexer exponent("2xexp(1)");
+    CHECK(exponent.next().type == TokenType::Number);
+    CHECK(exponent.next().oper == Operator::Times);
+    Lexer::Token function{exponent.next()};
+    CHECK(function.type == TokenType::Function);
+    CHECK(function.oper == Operator::Exp);
+  }
+  SECTION("Integer literals beyond int64 are only doubles") {
+    Lexer large("9223372036854775807 * 9223372036854775808");
+    Lexer::Token largest{large.next()};
+    CHECK(largest.isInteger);
+    CHECK(largest.integer == std::numeric_limits<std::int64_t>::max());
+    CHECK(large.next().oper == Operator::Times);
+    CHECK(!large.next().isInteger);
+  }
+  SECTION("Numbers separated only by whitespace are invalid") {
+    Lexer spaced("1 000");
+    CHECK(spaced.next().integer == 1);
+    CHECK_THROWS(spaced.next());
+    // A name ending in a digit is still multiplied by a following number
+    Lexer named("t2 3");
+    CHECK(named.next().type == TokenType::Variable);
+    CHECK(named.next().type == TokenType::Number);
+  }
+  SECTION("Calls of operations are single tokens") {
+    Lexer call("2integrate(x*(1+x), x, 0, 1)x3");
+    CHECK(call.next().type == TokenType::Number);
+    Lexer::Token operation{call.next()};
+    CHECK(operation.type == TokenType::Operation);
+    CHECK(operation.text == "integrate(x*(1+x), x, 0, 1)");
+    CHECK(call.next().oper == Operator::Times);
+    CHECK(call.next().type == TokenType::Number);
+    CHECK(call.next().type == TokenType::End);
+    CHECK_THROWS(Lexer("root(x, x, 0, 1").next());
+    CHECK_THROWS(Lexer("root + 1").next());
+  }
+}
+
+TEST_CASE("Calculus: Integrals and roots") {
+  SECTION("Integrals") {
+    const std::vector<std::pair<std::string, double>> integrals{
+        {"integrate(x^2, x, 0, 3)", 9.0},
+        {"integrate(sin(t), t, 0, 3.141592653589793)", 2.0},
+        {"integrate(x, x, 1, 0)", -0.5},
+        {"integrate(x, x, 2, 2)", 0.0},
+        {"integrate(1, x, -1, 4)", 5.0},
+        {"integrate(e^(-x^2), x, -10, 10)^2", 3.141592653589793},
+        {"integrate(sin(100*x)^2, x, 0, 10)", 5.0 - std::sin(2000.0) / 400},
+        // Integrable singularities at the bounds
+        {"integrate(1/sqrt(x), x, 0, 1)", 2.0},
+        {"integrate(ln(x), x, 0, 1)", -1.0}};
+    for (const auto &[expression, integral] : integrals) {
+      INFO("Integrated " << expression);
+      CHECK(nearEqual(Expression(expression).result(), integral, 1e-11));
+    }
+    INFO("Integrals diverging at a bound are infinite");
+    CHECK(std::isinf(Expression("integrate(1/x, x, 0, 1)").result()));
+  }
+  SECTION("Roots") {
+    const std::vector<std::pair<std::string, double>> roots{
+        {"root(x^2 - 2, x, 0, 2)", std::sqrt(2.0)},
+        {"root(x^2 - 2, x, -2, 0)", -std::sqrt(2.0)},
+        {"root(cos(x) - x, x, 0, 1)", 0.7390851332151607},
+        {"root(e^(x) - 10, x, 0, 10)", std::log(10.0)},
+        {"root(x - 1, x, 1, 5)", 1.0},
+        {"root(tanh(x), x, -1, 1000)", 0.0}};
+    for (const auto &[expression, root] : roots) {
+      INFO("Found root of " << expression);
+      CHECK(nearEqual(Expression(expression).result(), root, 1e-14));
+    }
+    CHECK_THROWS(Expression("root(x^2 + 1, x, -1, 1)").result());
+  }
+  SECTION("Operations inside expressions") {
+    Expression expression("2integrate(x, x, 0, 1) + y root(z - 3, z, 0, 5)");
+    REQUIRE(expression.variables() == std::vector<std::string>{"y"});
+    expression.set_variable("y", 2.0);
+    CHECK(nearEqual(expression.result(), 7.0, 1e-14));
+    CHECK(nearEqual(Expression("integrate(x root(t^2 - 4, t, 0, 5), x, 0, "
+                               "integrate(1, t, 0, 3))")
+                        .result(),
+                    9.0, 1e-14));
+    CHECK(nearEqual(CompiledExpression("integrate(x^3, x, 0, 2) y").evaluate(
+                        std::vector<double>{0.5}),
+                    2.0, 1e-14));
+  }
+  SECTION("Invalid calls") {
+    for (std::string invalid :
+         {"integrate(x, x, 0)", "integrate(x, x, 0, 1, 2)",
+          "integrate(x, 2, 0, 1)", "integrate(x, sin, 0, 1)",
+          "integrate(x y, x, 0, 1)", "integrate(x, x, 0, y)",
+          "integrate(x, x, 0, 1/0)", "root(x, x y, 0, 1)",
+          "integrate(x+, x, 0, 1)", "1, 2"}) {
+      INFO("Calculated invalid expression " << invalid);
+      CHECK_THROWS(Expression(invalid).result());
+    }
+  }
+}
+
+TEST_CASE("StreamEvaluator: Line-by-line evaluation") {
+  std::istringstream input("1 + 2\n2*(3\n\nsqrt(16)\r\nx+1\n1/3");
+  std::ostringstream output;
+  StreamEvaluator evaluator(output, 3);
+  INFO("Expected two of the lines to fail");
+  REQUIRE(evaluator.run(input) == 2);
+  INFO("Unexpected batch output:\n" << output.str());
+  CHECK(output.str() == "3\n"
+                        "error: Expression 2*(3 is invalid: unmatched "
+                        "parentheses\n"
+                        "\n"
+                        "4\n"
+                        "error: Variable x has no value.\n"
+                        "0.333\n");
+}
+
+/// Error of a value in units in the last place of a reference value, which
+/// is infinite if only one of them is NaN or infinite
+double ulpError(double value, double reference) {
+  if (std::isnan(reference) || std::isnan(value))
+    return std::isnan(reference) && std::isnan(value)
+               ? 0.0
+               : std::numeric_limits<double>::infinity();
+  if (std::isinf(reference) || std::isinf(value))
+    return value == reference ? 0.0 : std::numeric_limits<double>::infinity();
+  double magnitude{std::abs(reference)};
+  double ulp{std::nextafter(magnitude, std::numeric_limits<double>::infinity()) -
+             magnitude};
+  return std::abs(value - reference) / ulp;
+}
+
+TEST_CASE("FastMath: Kernels within their error bounds") {
+  using Operator = Expression::Operator;
+  struct Domain {
+    Operator oper;
+    double (*reference)(double);
+    std::vector<std::pair<double, double>> ranges; /// Sampled uniformly
+  };
+  // Wide ranges reach every reduction, and narrow ones the series alone
+  std::vector<Domain> domains{
+      {Operator::Exp, [](double x) { return std::exp(x); },
+       {{-745.0, 745.0}, {-1.0, 1.0}, {-1e-8, 1e-8}}},
+      {Operator::Sqrt, [](double x) { return std::sqrt(x); },
+       {{0.0, 1e10}, {0.0, 2.0}}},
+      {Operator::Ln, [](double x) { return std::log(x); },
+       {{0.0, 1e300}, {0.5, 2.0}}},
+      {Operator::Log, [](double x) { return std::log10(x); },
+       {{0.0, 1e300}, {0.5, 2.0}, {0.999, 1.001}}},
+      {Operator::Sin, [](double x) { return std::sin(x); },
+       {{-1e6, 1e6}, {-10.0, 10.0}, {-1e-8, 1e-8}}},
+      {Operator::Cos, [](double x) { return std::cos(x); },
+       {{-1e6, 1e6}, {-10.0, 10.0}, {-1e-8, 1e-8}}},
+      {Operator::Tan, [](double x) { return std::tan(x); },
+       {{-1e6, 1e6}, {-10.0, 10.0}, {-1e-8, 1e-8}}},
+      {Operator::Sinh, [](double x) { return std::sinh(x); },
+       {{-720.0, 720.0}, {-2.0, 2.0}, {-1e-8, 1e-8}}},
+      {Operator::Cosh, [](double x) { return std::cosh(x); },
+       {{-720.0, 720.0}, {-2.0, 2.0}, {-1e-8, 1e-8}}},
+      {Operator::Tanh, [](double x) { return std::tanh(x); },
+       {{-30.0, 30.0}, {-2.0, 2.0}, {-1e-8, 1e-8}}}};
+  const std::vector<double> specialValues{
+      0.0, -0.0, 1.0, -1.0, std::numeric_limits<double>::infinity(),
+      -std::numeric_limits<double>::infinity(),
+      std::numeric_limits<double>::quiet_NaN(),
+      std::numeric_limits<double>::denorm_min(),
+      std::numeric_limits<double>::min(), std::numeric_limits<double>::max(),
+      1e300, -1e300};
+  for (const Domain &domain : domains) {
+    std::vector<double> arguments{specialValues};
+    std::mt19937_64 random(42);
+    for (auto [low, high] : domain.ranges) {
+      std::uniform_real_distribution<double> uniform(low, high);
+      for (int i{0}; i < 20000; ++i)
+        arguments.push_back(uniform(random));
+    }
+    // The doubles next to multiples of pi/2 need the most accurate reduction
+    for (int k{-2000}; k <= 2000; ++k) {
+      double multiple{k * 1.5707963267948966};
+      arguments.push_back(multiple);
+      arguments.push_back(std::nextafter(multiple, 0.0));
+    }
+    std::span<const FastMath::Kernel> kernels{FastMath::kernels(domain.oper)};
+    REQUIRE(!kernels.empty());
+    for (const FastMath::Kernel &kernel : kernels) {
+      double maxError{0.0};
+      double worstArgument{0.0};
+      for (double x : arguments) {
+        double error{ulpError(kernel.function(x), domain.reference(x))};
+        if (!(error <= maxError)) {
+          maxError = error;
+          worstArgument = x;
+        }
+      }
+      INFO("Kernel " << kernel.name << " is off by " << maxError
+                     << " ULPs at " << std::setprecision(17) << worstArgument
+                     << ", beyond its bound of " << kernel.maxUlps);
+      CHECK(maxError <= kernel.maxUlps);
+    }
+    INFO("Kernels of each function must be ordered by accuracy");
+    for (size_t i{1}; i < kernels.size(); ++i)
+      CHECK(kernels[i].maxUlps < kernels[i - 1].maxUlps);
+  }
+}
+
+TEST_CASE("FastMath: Selecting kernels by precision") {
+  using Operator = Expression::Operator;
+  SECTION("Fewer digits select cheaper kernels") {
+    CHECK(FastMath::select(Operator::Sin, 3).name == "sin/1");
+    CHECK(FastMath::select(Operator::Sin, 6).name == "sin/2");
+    CHECK(FastMath::select(Operator::Sin, 12).name == "sin/3");
+    CHECK(FastMath::select(Operator::Sin, 14).name == "std::sin");
+    CHECK(FastMath::select(Operator::Sin, FastMath::fullPrecision).name ==
+          "std::sin");
+    CHECK(FastMath::select(Operator::Sqrt, 1).name == "std::sqrt");
+  }
+  SECTION("Selected kernels keep a spare digit") {
+    for (int precision{0}; precision <= 17; ++precision) {
+      for (Operator oper : {Operator::Exp, Operator::Ln, Operator::Log,
+                            Operator::Sin, Operator::Cosh, Operator::Tanh}) {
+        const FastMath::Kernel &kernel{FastMath::select(oper, precision)};
+        bool isStd{kernel.name.starts_with("std::")};
+        INFO("Kernel " << kernel.name << " selected for " << precision
+                       << " digits");
+        CHECK((isStd || FastMath::isAccurateTo(kernel.maxUlps, precision)));
+        CHECK(FastMath::functions(precision)[static_cast<size_t>(oper)] ==
+              kernel.function);
+      }
+    }
+    CHECK(FastMath::isAccurateTo(2e7, 7));
+    CHECK(!FastMath::isAccurateTo(2e7, 8));
+    CHECK(!FastMath::isAccurateTo(0.5, FastMath::fullPrecision));
+  }
+  SECTION("Expressions calculating with fast kernels") {
+    Expression expression("sin(1) + tanh(0.5) x e^(2) - cosh(x)");
+    expression.set_variable("x", 0.25);
+    double exact{expression.result()};
+    expression.set_fast_math(5);
+    double fast{expression.result()};
+    CHECK(fast != exact);
+    CHECK(std::abs(fast - exact) <= 5e-7 * std::abs(exact));
+    expression.set_fast_math(FastMath::fullPrecision);
+    CHECK(expression.result() == exact);
+  }
+}
+
+TEST_CASE("StreamEvaluator: Calculating in other types") {
+  std::istringstream input("0.1 + 0.2\n2*(3\n1/3");
+  std::ostringstream output;
+  {
+    StreamEvaluator evaluator(output, OutputBuffer::shortest);
+    evaluator.set_scalar_type(ScalarType::Float);
+    REQUIRE(evaluator.run(input) == 1);
+  }
+  INFO("Unexpected batch output:\n" << output.str());
+  CHECK(output.str() == "0.3\n"
+                        "error: Expression 2*(3 is invalid: unmatched "
+                        "parentheses\n"
+                        "0.33333334\n");
+}
+
+TEST_CASE("RangeReducer: Reducing over a range") {
+  using Reduction = RangeReducer::Reduction;
+  SECTION("Reading ranges") {
+    RangeReducer::Range range{RangeReducer::parseRange("rate=-1:2.5:0.5")};
+    CHECK(range.variable == "rate");
+    CHECK(range.start == -1.0);
+    CHECK(range.stop == 2.5);
+    CHECK(range.step == 0.5);
+    CHECK(RangeReducer::numPoints(range) == 8);
+    INFO("The stop is a whole number of steps away up to rounding");
+    CHECK(RangeReducer::numPoints(RangeReducer::parseRange("x=0:1:0.1")) == 11);
+    CHECK(RangeReducer::numPoints(RangeReducer::parseRange("x=1:0:-0.25")) ==
+          5);
+    for (std::string_view invalid :
+         {"x=0:1", "=0:1:1", "x0:1:1", "x=0:1:0", "x=0:1:-1", "x=a:1:1",
+          "x=0:1:1:1", "x=0:inf:1"}) {
+      INFO("Read invalid range " << invalid);
+      CHECK_THROWS(RangeReducer::parseRange(invalid));
+    }
+    CHECK(RangeReducer::parseReduction("mean") == Reduction::Mean);
+    CHECK_THROWS(RangeReducer::parseReduction("median"));
+  }
+  SECTION("Reductions") {
+    RangeReducer reducer(2, 7);
+    RangeReducer::Range range{RangeReducer::parseRange("x=1:100:1")};
+    CHECK(reducer.run("x", range, Reduction::Sum) == 5050.0);
+    CHECK(reducer.run("x", range, Reduction::Mean) == 50.5);
+    CHECK(reducer.run("(x - 40)^2", range, Reduction::Min) == 0.0);
+    CHECK(reducer.run("(x - 40)^2", range, Reduction::Max) == 3600.0);
+    INFO("Expressions without the variable are constant");
+    CHECK(reducer.run("2^3", range, Reduction::Sum) == 800.0);
+    CHECK_THROWS(reducer.run("x + y", range, Reduction::Sum));
+    INFO("NaN values make every reduction NaN");
+    RangeReducer::Range negative{RangeReducer::parseRange("x=1:-1:-1")};
+    CHECK(std::isnan(reducer.run("sqrt(x)", negative, Reduction::Min)));
+    CHECK(std::isnan(reducer.run("sqrt(x)", negative, Reduction::Max)));
+    CHECK(std::isnan(reducer.run("sqrt(x)", negative, Reduction::Sum)));
+  }
+  SECTION("Sums are compensated and independent of the number of threads") {
+    RangeReducer::Range range{RangeReducer::parseRange("x=1:100000:1")};
+    // Harmonic number H(100000), correctly rounded
+    const double harmonic{12.090146129863427};
+    double sum{RangeReducer(1, 1000).run("1/x", range, Reduction::Sum)};
+    CHECK(std::abs(sum - harmonic) <= harmonic * 1e-16);
+    for (size_t numThreads : {2, 3, 8}) {
+      INFO("Sum differs on " << numThreads << " threads");
+      CHECK(std::bit_cast<std::uint64_t>(RangeReducer(numThreads, 1000).run(
+                "1/x", range, Reduction::Sum)) ==
+            std::bit_cast<std::uint64_t>(sum));
+    }
+  }
+}
+
+TEST_CASE("OutputBuffer: Formatting and writing numbers") {
+  const std::vector<double> values{
+      0.0,     -0.0,   1.0,    -2.5,     1.0 / 3.0,       123456789.0,
+      1e-5,    1e-300, 4.9e-324, 1.7976931348623157e308, 0.1 + 0.2,
+      1e16,    -1e100, std::nan(""), -std::numeric_limits<double>::infinity()};
+  SECTION("Precisions match iostreams") {
+    for (int precision : {0, 1, 3, 6, 15, 17, 40}) {
+      for (double value : values) {
+        std::ostringstream stream;
+        stream << std::setprecision(precision) << value;
+        std::string text;
+        OutputBuffer::appendNumber(text, value, precision);
+        INFO("Formatted " << value << " at precision " << precision);
+        CHECK(text == stream.str());
+      }
+    }
+  }
+  SECTION("Shortest form reads back exactly") {
+    for (double value : values) {
+      std::string text;
+      OutputBuffer::appendNumber(text, value, OutputBuffer::shortest);
+      if (std::isnan(value)) {
+        CHECK(text == "nan");
+        continue;
+      }
+      INFO("Shortest form " << text << " did not round-trip");
+      double readBack{std::strtod(text.c_str(), nullptr)};
+      CHECK(std::bit_cast<std::uint64_t>(readBack) ==
+            std::bit_cast<std::uint64_t>(value));
+    }
+    std::string text;
+    OutputBuffer::appendNumber(text, 0.1 + 0.2, OutputBuffer::shortest);
+    CHECK(text == "0.30000000000000004");
+  }
+  SECTION("Other floating-point types") {
+    for (int precision : {0, 3, 6, 20}) {
+      std::ostringstream stream;
+      stream << std::setprecision(precision) << 1.0f / 3.0f << ' ' << 1e-300L;
+      std::string text;
+      OutputBuffer::appendNumber(text, 1.0f / 3.0f, precision);
+      text += ' ';
+      OutputBuffer::appendNumber(text, 1e-300L, precision);
+      INFO("Formatted at precision " << precision);
+      CHECK(text == stream.str());
+    }
+    std::string text;
+    OutputBuffer::appendNumber(text, 0.1f, OutputBuffer::shortest);
+    CHECK(text == "0.1");
+    text.clear();
+    OutputBuffer::appendNumber(text, 1.0L / 3.0L, OutputBuffer::shortest);
+    INFO("Shortest form " << text << " did not round-trip");
+    CHECK(std::strtold(text.c_str(), nullptr) == 1.0L / 3.0L);
+  }
+  SECTION("Writing out in blocks") {
+    std::ostringstream stream;
+    {
+      OutputBuffer output(stream, 64);
+      for (size_t i{0}; i < 10; ++i)
+        output.appendNumber(static_cast<double>(i) / 4.0, 3) << ' ';
+      INFO("Wrote out before the buffer was full");
+      CHECK(stream.str().empty());
+      for (size_t i{0}; i < 100; ++i)
+        output << "filler ";
+      CHECK(!stream.str().empty());
+      CHECK(output.view().size() < 64);
+    }
+    INFO("Destruction did not write out the rest");
+    std::string numbers{"0 0.25 0.5 0.75 1 1.25 1.5 1.75 2 2.25 "};
+    CHECK(stream.str().starts_with(numbers));
+    CHECK(stream.str().size() == numbers.size() + 700);
+    OutputBuffer memory;
+    memory << "kept" << '\n';
+    memory.flush();
+    CHECK(memory.take() == "kept\n");
+    CHECK(memory.view().empty());
+  }
+}
+
+TEST_CASE("ResultCache: Least recently used eviction") {
+  ResultCache cache(2, 1);
+  REQUIRE(cache.capacity() == 2);
+  cache.insert("1+1", 2.0);
+  cache.insert("2*3", 6.0);
+  REQUIRE(cache.find("1+1") == 2.0);
+  // 2*3 is now the least recently used result
+  cache.insert("sqrt(16)", 4.0);
+  INFO("Evicted the wrong result");
+  CHECK(cache.find("2*3") == std::nullopt);
+  CHECK(cache.find("1+1") == 2.0);
+  CHECK(cache.find("sqrt(16)") == 4.0);
+  ResultCache::Statistics statistics{cache.statistics()};
+  CHECK(statistics.hits == 3);
+  CHECK(statistics.misses == 1);
+  CHECK(statistics.evictions == 1);
+  CHECK(statistics.size == 2);
+  REQUIRE_THROWS(ResultCache(0));
+}
+
+TEST_CASE("ResultCache: Caching Expression results") {
+  auto cache{std::make_shared<ResultCache>(100)};
+  Expression first("2 * (3 + 4)");
+  first.set_cache(cache);
+  REQUIRE(nearEqual(first.result(), 14.0));
+  INFO("Expressions with the same trimmed form did not share a result");
+  Expression second("((2*(3+4)))");
+  second.set_cache(cache);
+  REQUIRE(nearEqual(second.result(), 14.0));
+  CHECK(cache->statistics().hits == 1);
+  CHECK(cache->statistics().misses == 1);
+  INFO("Cached a result which depends on variable values");
+  Expression variable("2y + 1");
+  variable.set_cache(cache);
+  variable.set_variable("y", 1.0);
+  CHECK(nearEqual(variable.result(), 3.0));
+  CHECK(cache->statistics().size == 1);
+  SECTION("Concurrent lookups through FileEvaluator") {
+    std::filesystem::path path{std::filesystem::temp_directory_path() /
+                               "calc_test_cache.txt"};
+    {
+      std::ofstream file(path);
+      for (size_t i{0}; i < 2000; ++i)
+        file << i % 10 << " + 2*(3+4)\n";
+    }
+    FileEvaluator evaluator(std::cout, 4, 6, 100);
+    evaluator.set_cache(cache);
+    std::ostringstream output;
+    auto oldCoutBuf = std::cout.rdbuf(output.rdbuf());
+    size_t numErrors{evaluator.run(path.string())};
+    std::cout.rdbuf(oldCoutBuf);
+    std::filesystem::remove(path);
+    REQUIRE(numErrors == 0);
+    ResultCache::Statistics statistics{cache->statistics()};
+    INFO("Each distinct expression should be calculated about once");
+    CHECK(statistics.size == 11);
+    CHECK(statistics.hits + statistics.misses == 2002);
+  }
+}
+
+TEST_CASE("Profiler: Counting phases and trees") {
+  if (!Profiler::isCompiled)
+    SKIP("Built without CALC_STATS");
+  Profiler::reset();
+  INFO("Recorded while disabled");
+  Expression("1 + 1").result();
+  CHECK(Profiler::totals()[Phase::Parse].calls == 0);
+
+  Profiler::set_enabled(true);
+  Expression expression("1 + 2*(3 + 4)");
+  double result{expression.result()};
+  Profiler::set_enabled(false);
+  REQUIRE(nearEqual(result, 15.0));
+  Profiler::Totals totals{Profiler::totals()};
+  for (Phase phase : {Phase::Validate, Phase::Parse, Phase::Tokenize,
+                      Phase::BuildTree, Phase::Calculate}) {
+    CAPTURE(Profiler::phaseName(phase));
+    CHECK(totals[phase].calls == 1);
+  }
+  INFO("Parsing should take at least as long as the phases it runs");
+  CHECK(totals[Phase::Parse].nanoseconds >=
+        totals[Phase::Tokenize].nanoseconds +
+            totals[Phase::BuildTree].nanoseconds);
+  CHECK(totals.numTrees == 1);
+  CHECK(totals.numNodes == 7);
+  CHECK(totals.maxNodes == 7);
+  CHECK(totals.maxDepth == 4);
+
+  std::ostringstream table;
+  Profiler::print(table);
+  CHECK(table.str().find("build_tree") != std::string::npos);
+  Profiler::reset();
+  CHECK(Profiler::totals().numTrees == 0);
+}
+
+TEST_CASE("Profiler: Re-evaluating without allocating") {
+  if (!Profiler::countsAllocations)
+    SKIP("Built without CALC_ALLOC_STATS");
+  Profiler::Allocations before{Profiler::threadAllocations()};
+  Expression("1 + 2*3").result();
+  INFO("Allocations were not counted");
+  REQUIRE(Profiler::threadAllocations().count > before.count);
+
+  Expression expression("2*x^2 + sin(x)*3 - 3/sin(x) + (x + 1)");
+  // Deep enough that the stack does not fit in the inline array
+  std::string deepText{"x"};
+  for (size_t i{0}; i < 80; ++i)
+    deepText = "x - (" + deepText + ")";
+  CompiledExpression deep(deepText);
+  CompiledExpression compiled("2*x^2 + sin(x)*3 - 3/sin(x) + (x + 1)");
+  std::vector<double> column(1000, 0.25);
+  std::vector<double> results(column.size());
+  std::vector<std::span<const double>> columns{column};
+  // The first evaluation may allocate, eg. while optimizing the tree
+  double value{0.5};
+  expression.set_variable("x", value);
+  double sum{expression.result() + deep.evaluate(std::span(&value, 1))};
+  compiled.evaluateBatch(columns, results);
+  deep.evaluateBatch(columns, results);
+  sum += static_cast<double>(expression.expression().size());
+
+  before = Profiler::threadAllocations();
+  for (size_t i{0}; i < 100; ++i) {
+    value += 0.01;
+    expression.set_variable("x", value);
+    sum += expression.result();
+    sum += compiled.evaluate(std::span(&value, 1));
+    sum += deep.evaluate(std::span(&value, 1));
+    compiled.evaluateBatch(columns, results);
+    deep.evaluateBatch(columns, results);
+    sum += static_cast<double>(expression.expression().size());
+  }
+  Profiler::Allocations after{Profiler::threadAllocations()};
+  REQUIRE(std::isfinite(sum));
+  INFO("Re-evaluating allocated " << after.count - before.count << " times");
+  CHECK(after.count == before.count);
+  CHECK(after.bytes == before.bytes);
+
+  SECTION("Allocations are attributed to phases") {
+    if (!Profiler::isCompiled)
+      SKIP("Built without CALC_STATS");
+    Profiler::reset();
+    Profiler::set_enabled(true);
+    Expression("1 + 2*(3 + 4)").result();
+    Profiler::set_enabled(false);
+    Profiler::Totals totals{Profiler::totals()};
+    INFO("Tokenizing and building the tree each fill a vector");
+    CHECK(totals[Phase::Tokenize].allocations.count > 0);
+    CHECK(totals[Phase::BuildTree].allocations.count > 0);
+    CHECK(totals[Phase::Calculate].allocations.count == 0);
+    Profiler::reset();
+  }
+}
+
+TEST_CASE("ThreadPool: Running tasks") {
+  ThreadPool pool(4);
+  REQUIRE(pool.size() == 4);
+  std::atomic<size_t> sum{0};
+  for (size_t i{1}; i <= 1000; ++i)
+    pool.submit([&sum, i]() { sum += i; });
+  pool.wait();
+  INFO("Not every submitted task ran exactly once");
+  REQUIRE(sum == 500500);
+  pool.submit([]() { throw std::runtime_error("task failed"); });
+  INFO("Exception thrown by a task was not passed on by wait()");
+  REQUIRE_THROWS(pool.wait());
+  REQUIRE_NOTHROW(pool.wait());
+}
+
+TEST_CASE("Server: Serving requests over a socket") {
+  std::string path{(std::filesystem::temp_directory_path() /
+                    "calc_test_server.sock")
+                       .string()};
+  Server server(path, 4, 8);
+  std::thread loop([&server]() { server.run(); });
+  SECTION("Framing") {
+    std::string buffer;
+    Server::appendFrame(buffer, "1+2");
+    Server::appendFrame(buffer, "");
+    REQUIRE(buffer == std::string("\0\0\0\x03" "1+2\0\0\0\0", 11));
+    std::string_view rest{buffer.data(), 6};
+    std::string_view payload;
+    REQUIRE_FALSE(Server::takeFrame(rest, payload));
+    rest = buffer;
+    REQUIRE(Server::takeFrame(rest, payload));
+    REQUIRE(payload == "1+2");
+    REQUIRE(Server::takeFrame(rest, payload));
+    REQUIRE(payload.empty());
+    REQUIRE(rest.empty());
+  }
+  SECTION("Responses match batch output") {
+    Client client(path);
+    REQUIRE(client.evaluate("ln(3) + 3^2") == "10.098612");
+    REQUIRE(client.evaluate("") == "");
+    REQUIRE(client.evaluate("1+(2").starts_with("error: "));
+    // The connection stays usable after an error
+    REQUIRE(client.evaluate("2 x 3") == "6");
+  }
+  SECTION("Pipelined requests from concurrent clients") {
+    std::vector<std::string> expressions;
+    std::ostringstream expected;
+    StreamEvaluator evaluator(expected, 8);
+    for (size_t i{0}; i < 3000; ++i) {
+      expressions.push_back(std::to_string(i) + " / 7 + sin(" +
+                            std::to_string(i % 13) + ")");
+      if (i % 500 == 0)
+        expressions.back() += "+";
+      evaluator.evaluateLine(expressions.back());
+    }
+    evaluator.output().flush();
+    std::vector<std::vector<std::string>> responses(4);
+    std::vector<std::thread> clients;
+    for (std::vector<std::string> &clientResponses : responses)
+      clients.emplace_back([&path, &expressions, &clientResponses]() {
+        Client client(path);
+        clientResponses = client.evaluate(expressions);
+      });
+    for (std::thread &client : clients)
+      client.join();
+    for (const std::vector<std::string> &clientResponses : responses) {
+      std::string joined;
+      for (const std::string &response : clientResponses)
+        joined += response + '\n';
+      INFO("Responses differ from, or are ordered unlike, batch output");
+      REQUIRE(joined == expected.str());
+    }
+  }
+  SECTION("Oversized requests close the connection") {
+    Client client(path);
+    REQUIRE_THROWS(
+        client.evaluate(std::string(Server::maxRequestSize + 1, '1')));
+    Client other(path);
+    REQUIRE(other.evaluate("1+1") == "2");
+  }
+  SECTION("Pipelined requests of the largest size") {
+    // Several times the input a connection buffers at once
+    std::vector<std::string> expressions(
+        8, std::string(Server::maxRequestSize - 1, ' ') + '1');
+    expressions[3].back() = '(';
+    Client client(path);
+    std::vector<std::string> responses{client.evaluate(expressions)};
+    REQUIRE(responses.size() == expressions.size());
+    for (size_t i{0}; i < responses.size(); ++i)
+      REQUIRE((i == 3 ? responses[i].starts_with("error: ")
+                      : responses[i] == "1"));
+  }
+  SECTION("Responses beyond what the server queues") {
+    // Errors repeat their expression, so these responses add up to several
+    // times the output the server queues before it stops reading
+    std::vector<std::string> expressions(
+        16, "1+(" + std::string(Server::maxRequestSize - 3, ' '));
+    Client client(path);
+    std::vector<std::string> responses{client.evaluate(expressions)};
+    REQUIRE(responses.size() == expressions.size());
+    for (const std::string &response : responses)
+      REQUIRE(response.size() > Server::maxRequestSize);
+    REQUIRE(client.evaluate("1+1") == "2");
+  }
+  server.stop();
+  loop.join();
+}
+
+TEST_CASE("FileEvaluator: Chunking and ordering") {
+  std::string text;
+  for (size_t i{0}; i < 5000; ++i)
+    text += std::to_string(i) + (i % 7 == 0 ? "+(" : "*2") + '\n';
+  text += "1+1";
+  SECTION("Chunks cover the text and end on line boundaries") {
+    for (size_t chunkSize : {size_t{0}, size_t{1}, size_t{100}, size_t{1} << 20}) {
+      std::vector<std::string_view> chunks{
+          FileEvaluator::splitChunks(text, chunkSize)};
+      std::string joined;
+      for (size_t i{0}; i < chunks.size(); ++i) {
+        INFO("Chunk " << i << " of size " << chunkSize << " splits a line");
+        REQUIRE((chunks[i].back() == '\n' || i + 1 == chunks.size()));
+        joined += chunks[i];
+      }
+      REQUIRE(joined == text);
+    }
+  }
+  SECTION("Results match single-threaded evaluation in input order") {
+    std::filesystem::path path{std::filesystem::temp_directory_path() /
+                               "calc_test_expressions.txt"};
+    std::ofstream(path) << text;
+    std::ostringstream expected;
+    std::istringstream input(text);
+    size_t expectedErrors{StreamEvaluator(expected, 4).run(input)};
+    std::ostringstream output;
+    size_t numErrors{FileEvaluator(output, 4, 4, 1000).run(path.string())};
+    std::filesystem::remove(path);
+    REQUIRE(numErrors == expectedErrors);
+    REQUIRE(output.str() == expected.str());
+  }
+  REQUIRE_THROWS(FileEvaluator(std::cout, 2).run("/nonexistent/calc.txt"));
+}
+
 TEST_CASE("calc: Option Parsing") {
   // Common setup for all subtests
   std::string helpStr{"TEST HELP STRING"};
@@ -214,6 +1586,24 @@ TEST_CASE("calc: Option Parsing") {
       INFO("Passed --help but help string wasn't printed");
       REQUIRE(capturedOutput.str() == helpStr + '\n');
     }
+
+    SECTION("Passing -p shortest") {
+      const char *argv[] = {programName, (char *)"-p", (char *)"shortest",
+                            (char *)"1/3"};
+      ArgParser parser(helpStr);
+      parser.parse(4, argv);
+      REQUIRE(parser.shouldExit() == false);
+      REQUIRE(parser.precision() == OutputBuffer::shortest);
+      REQUIRE(parser.argString() == "1/3");
+    }
+
+    SECTION("Passing a negative precision") {
+      const char *argv[] = {programName, (char *)"-p", (char *)"-2",
+                            (char *)"1/3"};
+      ArgParser parser(helpStr);
+      parser.parse(4, argv);
+      REQUIRE(parser.shouldExit() == true);
+    }
   }
 
   SECTION("Passing verbose argument") {
@@ -243,6 +1633,123 @@ TEST_CASE("calc: Option Parsing") {
       }
     }
   }
+
+  SECTION("Passing batch argument") {
+    SECTION("Passing --batch alone") {
+      const char *argv[] = {programName, (char *)"--batch"};
+      ArgParser parser(helpStr);
+      parser.parse(2, argv);
+      INFO("Parser received --batch but flagged shouldExit() == true");
+      REQUIRE(parser.shouldExit() == false);
+      REQUIRE(parser.batch == true);
+    }
+
+    SECTION("Passing -b with an expression") {
+      const char *argv[] = {programName, (char *)"-b", (char *)"1+2"};
+      ArgParser parser(helpStr);
+      parser.parse(3, argv);
+      INFO("Parser received -b <expression> but flagged shouldExit() == false");
+      REQUIRE(parser.shouldExit() == true);
+    }
+  }
+
+  SECTION("Passing serve argument") {
+    SECTION("Passing --serve with a path") {
+      const char *argv[] = {programName, (char *)"--serve",
+                            (char *)"/tmp/calc.sock"};
+      ArgParser parser(helpStr);
+      parser.parse(3, argv);
+      REQUIRE(parser.shouldExit() == false);
+      REQUIRE(parser.servePath() == "/tmp/calc.sock");
+    }
+
+    SECTION("Passing --serve with --batch") {
+      const char *argv[] = {programName, (char *)"--serve",
+                            (char *)"/tmp/calc.sock", (char *)"-b"};
+      ArgParser parser(helpStr);
+      parser.parse(4, argv);
+      REQUIRE(parser.shouldExit() == true);
+    }
+  }
+
+  SECTION("Passing --stats with an expression") {
+    const char *argv[] = {programName, (char *)"--stats", (char *)"1+2"};
+    ArgParser parser(helpStr);
+    parser.parse(3, argv);
+    REQUIRE(parser.shouldExit() == false);
+    REQUIRE(parser.stats == true);
+    REQUIRE(parser.argString() == "1+2");
+  }
+
+  SECTION("Passing --type") {
+    SECTION("Passing --type long-double with an expression") {
+      const char *argv[] = {programName, (char *)"--type",
+                            (char *)"long-double", (char *)"1/3"};
+      ArgParser parser(helpStr);
+      parser.parse(4, argv);
+      REQUIRE(parser.shouldExit() == false);
+      REQUIRE(parser.scalarType() == ScalarType::LongDouble);
+      REQUIRE(parser.argString() == "1/3");
+    }
+
+    SECTION("Passing --type with an unknown type") {
+      const char *argv[] = {programName, (char *)"--type", (char *)"half",
+                            (char *)"1/3"};
+      ArgParser parser(helpStr);
+      parser.parse(4, argv);
+      REQUIRE(parser.shouldExit() == true);
+    }
+
+    SECTION("Passing --type float with --cache") {
+      const char *argv[] = {programName, (char *)"--type", (char *)"float",
+                            (char *)"-c", (char *)"10", (char *)"-b"};
+      ArgParser parser(helpStr);
+      parser.parse(6, argv);
+      REQUIRE(parser.shouldExit() == true);
+    }
+  }
+
+  SECTION("Passing --range") {
+    SECTION("Passing --range and --reduce with an expression") {
+      const char *argv[] = {programName, (char *)"--range",
+                            (char *)"x=0:1:0.5", (char *)"--reduce",
+                            (char *)"max", (char *)"x^2"};
+      ArgParser parser(helpStr);
+      parser.parse(6, argv);
+      REQUIRE(parser.shouldExit() == false);
+      REQUIRE(parser.range().has_value());
+      REQUIRE(parser.range()->variable == "x");
+      REQUIRE(parser.reduction() == RangeReducer::Reduction::Max);
+      REQUIRE(parser.argString() == "x^2");
+    }
+
+    SECTION("Passing --reduce without --range") {
+      const char *argv[] = {programName, (char *)"--reduce", (char *)"sum",
+                            (char *)"x^2"};
+      ArgParser parser(helpStr);
+      parser.parse(4, argv);
+      REQUIRE(parser.shouldExit() == true);
+    }
+
+    SECTION("Passing --range with --batch") {
+      const char *argv[] = {programName, (char *)"--range",
+                            (char *)"x=0:1:0.5", (char *)"-b"};
+      ArgParser parser(helpStr);
+      parser.parse(4, argv);
+      REQUIRE(parser.shouldExit() == true);
+    }
+  }
+
+  SECTION("Passing --fast-math with an expression") {
+    const char *argv[] = {programName, (char *)"--fast-math", (char *)"-p",
+                          (char *)"4", (char *)"sin(1)"};
+    ArgParser parser(helpStr);
+    parser.parse(5, argv);
+    REQUIRE(parser.shouldExit() == false);
+    REQUIRE(parser.fastMath == true);
+    REQUIRE(parser.precision() == 4);
+    REQUIRE(parser.argString() == "sin(1)");
+  }
   // Undo redirection of stdout buf
   std::cout.rdbuf(oldCoutBuf);
 }